@@ -0,0 +1,413 @@
+#ifndef __BENCH_H__
+#define __BENCH_H__
+/*
+
+    Benchmark harness shared by the programs in bench/
+    ==================================================
+
+    bench_measure() times one operation:
+
+      1. warm-up for BENCH_WARMUP_SECONDS, which also estimates the cost of
+         one call and so how many calls make up a sample of about
+         BENCH_SAMPLE_SECONDS
+      2. samples until the standard error of the mean is below BENCH_TARGET_RSE
+         of the mean (at least BENCH_MIN_SAMPLES of them), or until
+         BENCH_MAX_SAMPLES / BENCH_MAX_SECONDS run out -- then the result is
+         flagged as not stable
+
+    Mean, median and standard deviation are over the per-sample ns/op.
+    Results are printed as a table and can be written as JSON for comparing
+    runs, see bench_json_write().
+
+    Built with -DBENCH_PERF (Linux only), bench_measure() also reads hardware
+    counters with perf_event_open: cycles, instructions, branch misses, L1d,
+    LLC and dTLB read misses per call. They are counted in a separate pass
+    of BENCH_PERF_SAMPLES samples after the timed ones, so the syscalls stay
+    out of the timing. Counters the kernel refuses (perf_event_paranoid,
+    containers, no PMU in a VM) are reported as "-" / null, and if none can
+    be opened a single note is printed and the bench runs on timing only.
+
+*/
+
+#include <stdio.h>
+#include <time.h>
+#include "bn.h"
+
+#if defined(BENCH_PERF) && defined(__linux__)
+  #include <string.h>
+  #include <unistd.h>
+  #include <sys/ioctl.h>
+  #include <sys/syscall.h>
+  #include <linux/perf_event.h>
+#endif
+
+
+#ifndef BENCH_WARMUP_SECONDS
+  #define BENCH_WARMUP_SECONDS  0.02
+#endif
+#ifndef BENCH_SAMPLE_SECONDS
+  #define BENCH_SAMPLE_SECONDS  0.002
+#endif
+#ifndef BENCH_MIN_SAMPLES
+  #define BENCH_MIN_SAMPLES     10
+#endif
+#ifndef BENCH_MAX_SAMPLES
+  #define BENCH_MAX_SAMPLES     500
+#endif
+#ifndef BENCH_MAX_SECONDS
+  #define BENCH_MAX_SECONDS     1.0
+#endif
+#ifndef BENCH_TARGET_RSE
+  #define BENCH_TARGET_RSE      0.01
+#endif
+#ifndef BENCH_PERF_SAMPLES
+  #define BENCH_PERF_SAMPLES    10
+#endif
+
+
+/* Hardware counters, per call; < 0 when the counter could not be read */
+enum
+{
+  BENCH_CYCLES,
+  BENCH_INSTRUCTIONS,
+  BENCH_BRANCH_MISSES,
+  BENCH_L1D_MISSES,
+  BENCH_LLC_MISSES,
+  BENCH_DTLB_MISSES,
+  BENCH_NCOUNTERS
+};
+
+static const char* const bench_counter_names[BENCH_NCOUNTERS] =
+{
+  "cycles", "instructions", "branch_misses", "l1d_misses", "llc_misses", "dtlb_misses"
+};
+
+
+typedef struct bench_result
+{
+  const char* name;      /* operation */
+  int bits;              /* operand size */
+  double ns_per_op;      /* mean over the samples */
+  double median_ns;      /* median of the samples, what perfcheck compares */
+  double stddev_ns;      /* standard deviation of the per-sample means */
+  double rse;            /* standard error of the mean / mean */
+  double ops_per_sec;
+  int samples;
+  long iterations;       /* calls per sample */
+  int stable;            /* 1 if rse reached BENCH_TARGET_RSE */
+  double counters[BENCH_NCOUNTERS]; /* per call, only counted with BENCH_PERF */
+} bench_result;
+
+
+static double bench_now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+/* Newton's method, so the benches need no -lm */
+static double bench_sqrt(double x)
+{
+  double r = (x > 1.0) ? x : 1.0;
+  int i;
+  if (x <= 0.0)
+  {
+    return 0.0;
+  }
+  for (i = 0; i < 64; ++i)
+  {
+    r = 0.5 * (r + (x / r));
+  }
+  return r;
+}
+
+
+/* Sorts x in place, n is at most BENCH_MAX_SAMPLES */
+static double bench_median(double* x, int n)
+{
+  int i, j;
+  for (i = 1; i < n; ++i)
+  {
+    double v = x[i];
+    for (j = i; (j > 0) && (x[j - 1] > v); --j)
+    {
+      x[j] = x[j - 1];
+    }
+    x[j] = v;
+  }
+  return (n & 1) ? x[n / 2] : (0.5 * (x[(n / 2) - 1] + x[n / 2]));
+}
+
+
+#if defined(BENCH_PERF) && defined(__linux__)
+
+static int bench_perf_fd[BENCH_NCOUNTERS];
+static int bench_perf_state = 0; /* 0 not opened yet, 1 some counters open, -1 none */
+
+
+#define BENCH_HW_CACHE(cache) \
+  ((cache) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+/* Opens every counter that the kernel allows, each on its own: a group would fail as a whole */
+static void bench_perf_open(void)
+{
+  static const unsigned types[BENCH_NCOUNTERS] =
+  {
+    PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HW_CACHE, PERF_TYPE_HW_CACHE
+  };
+  static const unsigned long long configs[BENCH_NCOUNTERS] =
+  {
+    PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_BRANCH_MISSES,
+    BENCH_HW_CACHE(PERF_COUNT_HW_CACHE_L1D), BENCH_HW_CACHE(PERF_COUNT_HW_CACHE_LL), BENCH_HW_CACHE(PERF_COUNT_HW_CACHE_DTLB)
+  };
+  struct perf_event_attr attr;
+  int i;
+
+  bench_perf_state = -1;
+  for (i = 0; i < BENCH_NCOUNTERS; ++i)
+  {
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = types[i];
+    attr.config = configs[i];
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    /* More counters than the PMU has get multiplexed, the times let us scale */
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    bench_perf_fd[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    if (bench_perf_fd[i] >= 0)
+    {
+      bench_perf_state = 1;
+    }
+  }
+  if (bench_perf_state < 0)
+  {
+    fprintf(stderr, "  note: no hardware counters available (perf_event_paranoid, container or VM), timing only\n");
+  }
+}
+
+
+/* Counts ncalls calls of fn, stores the counts per call in counters */
+static void bench_perf_count(void (*fn)(void* arg), void* arg, long ncalls, double* counters)
+{
+  long i;
+
+  if (bench_perf_state == 0)
+  {
+    bench_perf_open();
+  }
+  for (i = 0; i < BENCH_NCOUNTERS; ++i)
+  {
+    counters[i] = -1.0;
+    if (bench_perf_fd[i] >= 0)
+    {
+      ioctl(bench_perf_fd[i], PERF_EVENT_IOC_RESET, 0);
+      ioctl(bench_perf_fd[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+  if (bench_perf_state < 0)
+  {
+    return;
+  }
+
+  for (i = 0; i < ncalls; ++i)
+  {
+    fn(arg);
+  }
+
+  for (i = 0; i < BENCH_NCOUNTERS; ++i)
+  {
+    unsigned long long v[3]; /* value, time enabled, time running */
+    if (bench_perf_fd[i] < 0)
+    {
+      continue;
+    }
+    ioctl(bench_perf_fd[i], PERF_EVENT_IOC_DISABLE, 0);
+    if ((read(bench_perf_fd[i], v, sizeof(v)) == (ssize_t)sizeof(v)) && (v[2] > 0))
+    {
+      counters[i] = ((double)v[0] * ((double)v[1] / (double)v[2])) / ncalls;
+    }
+  }
+}
+
+#else
+
+static void bench_perf_count(void (*fn)(void* arg), void* arg, long ncalls, double* counters)
+{
+  int i;
+  (void)fn;
+  (void)arg;
+  (void)ncalls;
+  for (i = 0; i < BENCH_NCOUNTERS; ++i)
+  {
+    counters[i] = -1.0;
+  }
+}
+
+#endif /* BENCH_PERF */
+
+
+static bench_result bench_measure(const char* name, int bits, void (*fn)(void* arg), void* arg)
+{
+  bench_result r;
+  long warmup = 0;
+  double start = bench_now();
+  double elapsed;
+
+  do
+  {
+    fn(arg);
+    warmup += 1;
+    elapsed = bench_now() - start;
+  }
+  while (elapsed < BENCH_WARMUP_SECONDS);
+
+  r.name = name;
+  r.bits = bits;
+  r.iterations = (long)((BENCH_SAMPLE_SECONDS * warmup) / elapsed);
+  if (r.iterations < 1)
+  {
+    r.iterations = 1;
+  }
+
+  /* Welford's running mean and variance of the per-sample ns/op */
+  double samples[BENCH_MAX_SAMPLES];
+  double mean = 0.0;
+  double m2 = 0.0;
+  int n = 0;
+  int stable = 0;
+  start = bench_now();
+
+  while ((n < BENCH_MAX_SAMPLES) && !stable)
+  {
+    long i;
+    double t0 = bench_now();
+    for (i = 0; i < r.iterations; ++i)
+    {
+      fn(arg);
+    }
+    double x = ((bench_now() - t0) * 1e9) / r.iterations;
+
+    samples[n] = x;
+    n += 1;
+    double delta = x - mean;
+    mean += delta / n;
+    m2 += delta * (x - mean);
+
+    if (n >= BENCH_MIN_SAMPLES)
+    {
+      double rse = bench_sqrt(m2 / (n - 1)) / bench_sqrt(n) / mean;
+      stable = (rse <= BENCH_TARGET_RSE);
+      if ((bench_now() - start) > BENCH_MAX_SECONDS)
+      {
+        break;
+      }
+    }
+  }
+
+  r.samples = n;
+  r.ns_per_op = mean;
+  r.median_ns = bench_median(samples, n);
+  r.stddev_ns = (n > 1) ? bench_sqrt(m2 / (n - 1)) : 0.0;
+  r.rse = (n > 1) ? (r.stddev_ns / bench_sqrt(n) / mean) : 0.0;
+  r.ops_per_sec = 1e9 / mean;
+  r.stable = stable;
+
+  bench_perf_count(fn, arg, r.iterations * BENCH_PERF_SAMPLES, r.counters);
+
+  return r;
+}
+
+
+static void bench_print_header(FILE* out)
+{
+  fprintf(out, "  %-16s %5s %14s %14s %12s %7s %14s %8s", "operation", "bits", "ns/op", "median", "stddev", "rse", "ops/sec", "samples");
+#ifdef BENCH_PERF
+  fprintf(out, " %11s %11s %5s %9s %9s %9s %9s", "cycles", "instrs", "IPC", "br-miss", "L1d-miss", "LLC-miss", "dTLB-miss");
+#endif
+  fprintf(out, "\n");
+}
+
+
+/* Counter column, "-" if it could not be read */
+static void bench_print_counter(FILE* out, int width, double v)
+{
+  if (v < 0.0)
+  {
+    fprintf(out, " %*s", width, "-");
+  }
+  else
+  {
+    fprintf(out, " %*.*f", width, ((v < 10.0) ? 2 : 0), v);
+  }
+}
+
+
+static void bench_print(FILE* out, const bench_result* r)
+{
+  fprintf(out, "  %-16s %5d %14.1f %14.1f %12.1f %6.2f%% %14.0f %7d%s",
+          r->name, r->bits, r->ns_per_op, r->median_ns, r->stddev_ns, 100.0 * r->rse, r->ops_per_sec, r->samples, (r->stable ? " " : "*"));
+#ifdef BENCH_PERF
+  const double* c = r->counters;
+  bench_print_counter(out, 10, c[BENCH_CYCLES]);
+  bench_print_counter(out, 11, c[BENCH_INSTRUCTIONS]);
+  bench_print_counter(out, 5, ((c[BENCH_CYCLES] > 0.0) && (c[BENCH_INSTRUCTIONS] >= 0.0)) ? (c[BENCH_INSTRUCTIONS] / c[BENCH_CYCLES]) : -1.0);
+  bench_print_counter(out, 9, c[BENCH_BRANCH_MISSES]);
+  bench_print_counter(out, 9, c[BENCH_L1D_MISSES]);
+  bench_print_counter(out, 9, c[BENCH_LLC_MISSES]);
+  bench_print_counter(out, 9, c[BENCH_DTLB_MISSES]);
+#endif
+  fprintf(out, "\n");
+}
+
+
+/* One JSON object describing the build and all results of a run */
+static void bench_json_write(FILE* out, const char* suite, const bench_result* results, int nresults)
+{
+#if defined(WASM_SBX)
+  const char* sandbox = "WASM_SBX";
+#elif defined(HEAP_SBX)
+  const char* sandbox = "HEAP_SBX";
+#elif defined(NOOP_SBX)
+  const char* sandbox = "NOOP_SBX";
+#else
+  const char* sandbox = "none";
+#endif
+  int i;
+
+  fprintf(out, "{ \"suite\": \"%s\", \"word_size\": %d, \"bn_array_size\": %d, \"sandbox\": \"%s\", \"results\": [",
+          suite, WORD_SIZE, BN_ARRAY_SIZE, sandbox);
+  for (i = 0; i < nresults; ++i)
+  {
+    const bench_result* r = &results[i];
+    fprintf(out, "%s\n  { \"op\": \"%s\", \"bits\": %d, \"ns_per_op\": %.3f, \"median_ns\": %.3f, \"stddev_ns\": %.3f, \"rse\": %.5f, "
+                 "\"ops_per_sec\": %.1f, \"samples\": %d, \"iterations\": %ld, \"stable\": %s",
+            ((i == 0) ? "" : ","), r->name, r->bits, r->ns_per_op, r->median_ns, r->stddev_ns, r->rse,
+            r->ops_per_sec, r->samples, r->iterations, (r->stable ? "true" : "false"));
+#ifdef BENCH_PERF
+    int j;
+    fprintf(out, ", \"counters\": {");
+    for (j = 0; j < BENCH_NCOUNTERS; ++j)
+    {
+      fprintf(out, "%s \"%s\": ", ((j == 0) ? "" : ","), bench_counter_names[j]);
+      if (r->counters[j] < 0.0)
+      {
+        fprintf(out, "null");
+      }
+      else
+      {
+        fprintf(out, "%.3f", r->counters[j]);
+      }
+    }
+    fprintf(out, " }");
+#endif
+    fprintf(out, " }");
+  }
+  fprintf(out, "\n] }\n");
+}
+
+
+#endif /* #ifndef __BENCH_H__ */
@@ -0,0 +1,162 @@
+/*
+
+    Benchmark: two-allocation vs. single-block bignum layout
+    =========================================================
+
+    A working set of NNUMBERS bignums -- a few MB, well beyond L2 -- is built
+    twice: once the way the tests used to do it (__bn_malloc__ a header, then
+    bignum_init mallocs the limbs) and once with bignum_new(). While building,
+    short-lived allocations of random size are made and half of them are kept,
+    the way a service's heap gets fragmented, so limb arrays land away from
+    their headers.
+
+    Reported per layout:
+      - allocator calls per bignum, counted while building the working set
+      - ns per bignum_add over the working set in random order: each operand
+        is a cold header plus its limbs, so this is dominated by cache misses
+
+    For hardware counts run e.g. `perf stat -e cache-misses ./build/bench_layout_w4`.
+    Build and run for every supported WORD_SIZE with `make bench`.
+
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <time.h>
+#include "bn.h"
+
+
+/* Number of bignums in the working set */
+#define NNUMBERS (1 << 16)
+
+/* Passes over the working set per measurement */
+#define NPASSES 8
+
+
+static double now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+static long nallocs = 0;
+
+
+static _TPtr<_T_bn> new_two_block(void)
+{
+  _TPtr<_T_bn> n = (_TPtr<_T_bn>)__bn_malloc__(sizeof(_T_bn));
+  t_memset(n, 0, sizeof(_T_bn));
+  nallocs += 1;
+  bignum_init(n);
+  nallocs += (n->array != NULL);
+  return n;
+}
+
+
+static _TPtr<_T_bn> new_single_block(void)
+{
+  nallocs += 1;
+  return bignum_new();
+}
+
+
+/* Builds the working set with ctor, interleaved with heap churn */
+static void build(_TPtr<_T_bn>* numbers, void** junk, _TPtr<_T_bn> (*ctor)(void))
+{
+  int i;
+  for (i = 0; i < NNUMBERS; ++i)
+  {
+    junk[i] = malloc(16 + (rand() % 512));
+    numbers[i] = ctor();
+    numbers[i]->array[0] = (DTYPE)(i + 1);
+    bignum_normalize(numbers[i]);
+    if (rand() & 1)
+    {
+      free(junk[i]);
+      junk[i] = NULL;
+    }
+  }
+}
+
+
+static void release(_TPtr<_T_bn>* numbers, void** junk)
+{
+  int i;
+  for (i = 0; i < NNUMBERS; ++i)
+  {
+    bignum_free(numbers[i]);
+    free(junk[i]);
+  }
+}
+
+
+/* ns per bignum_add with both operands picked in a random order */
+static double ns_per_add(_TPtr<_T_bn>* numbers, const int* order, _TPtr<_T_bn> acc)
+{
+  int pass, i;
+  double start = now();
+  for (pass = 0; pass < NPASSES; ++pass)
+  {
+    for (i = 0; i < NNUMBERS; ++i)
+    {
+      bignum_add(numbers[order[i]], numbers[order[NNUMBERS - 1 - i]], acc);
+    }
+  }
+  return ((now() - start) * 1e9) / ((double)NPASSES * NNUMBERS);
+}
+
+
+int main()
+{
+  _TPtr<_T_bn>* numbers = (_TPtr<_T_bn>*)malloc(NNUMBERS * sizeof(*numbers));
+  void** junk = (void**)malloc(NNUMBERS * sizeof(*junk));
+  int* order = (int*)malloc(NNUMBERS * sizeof(*order));
+  _TPtr<_T_bn> acc = bignum_new();
+  int i;
+
+  srand(42);
+
+  /* Random permutation, shared by both layouts */
+  for (i = 0; i < NNUMBERS; ++i)
+  {
+    order[i] = i;
+  }
+  for (i = NNUMBERS - 1; i > 0; --i)
+  {
+    int j = rand() % (i + 1);
+    int t = order[i];
+    order[i] = order[j];
+    order[j] = t;
+  }
+
+  printf("\nBignum layout benchmark, WORD_SIZE = %d, BN_ARRAY_SIZE = %d, %d numbers\n\n", WORD_SIZE, BN_ARRAY_SIZE, NNUMBERS);
+  printf("  %-28s  %12s  %10s\n", "layout", "allocs/num", "add ns");
+
+  nallocs = 0;
+  build(numbers, junk, new_two_block);
+  double allocs_two = (double)nallocs / NNUMBERS;
+  double t_two = ns_per_add(numbers, order, acc);
+  release(numbers, junk);
+  printf("  %-28s  %12.2f  %10.1f\n", "__bn_malloc__ + bignum_init", allocs_two, t_two);
+
+  nallocs = 0;
+  build(numbers, junk, new_single_block);
+  double allocs_one = (double)nallocs / NNUMBERS;
+  double t_one = ns_per_add(numbers, order, acc);
+  release(numbers, junk);
+  printf("  %-28s  %12.2f  %10.1f\n", "bignum_new", allocs_one, t_one);
+
+  printf("\n  speedup %.2fx, %.0f%% fewer allocations\n\n", t_two / t_one, 100.0 * (1.0 - (allocs_one / allocs_two)));
+
+  bignum_free(acc);
+  free(numbers);
+  free(junk);
+  free(order);
+
+  return 0;
+}
+
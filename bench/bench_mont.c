@@ -0,0 +1,155 @@
+/*
+
+    Benchmark: cost of one modular multiplication
+    ==============================================
+
+    Compares bignum_mont_mul (operands already in Montgomery form) against
+    bignum_mul followed by bignum_mod. The latter is only correct while the
+    product fits in a bignum, so it is timed for moduli up to half the width.
+
+    Build and run for every supported WORD_SIZE with `make bench`.
+
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <time.h>
+#include "bn.h"
+
+
+/* Minimum wall-clock time spent per measurement, in seconds */
+#define MIN_SECONDS 0.25
+
+
+static double now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+static _TPtr<_T_bn> new_bignum(void)
+{
+  _TPtr<_T_bn> n = (_TPtr<_T_bn>)__bn_malloc__(sizeof(_T_bn));
+  t_memset(n, 0, sizeof(_T_bn));
+  bignum_init(n);
+  return n;
+}
+
+
+static void free_bignum(_TPtr<_T_bn> n)
+{
+  __bn_free__(n->array);
+  __bn_free__(n);
+}
+
+
+/* Random number of exactly nbits bits */
+static void random_bignum(_TPtr<_T_bn> n, int nbits)
+{
+  const int nwords = nbits / (8 * WORD_SIZE);
+  int i;
+  bignum_init(n);
+  for (i = 0; i < nwords; ++i)
+  {
+    n->array[i] = (DTYPE)(((DTYPE_TMP)rand() << 16) ^ (DTYPE_TMP)rand());
+  }
+  n->array[nwords - 1] |= (DTYPE)DTYPE_MSB;
+  bignum_normalize(n);
+}
+
+
+int main()
+{
+  static const int modulus_bits[] = { 128, 256, 512, 1024 };
+  const int nsizes = sizeof(modulus_bits) / sizeof(*modulus_bits);
+
+  _TPtr<_T_bn> a = new_bignum();
+  _TPtr<_T_bn> b = new_bignum();
+  _TPtr<_T_bn> n = new_bignum();
+  _TPtr<_T_bn> am = new_bignum();
+  _TPtr<_T_bn> bm = new_bignum();
+  _TPtr<_T_bn> c = new_bignum();
+  _TPtr<_T_bn> tmp = new_bignum();
+  bn_mont_ctx ctx;
+
+  srand(42);
+
+  printf("\nModular multiplication benchmark, WORD_SIZE = %d, BN_ARRAY_SIZE = %d\n\n", WORD_SIZE, BN_ARRAY_SIZE);
+  printf("  %6s  %14s  %14s  %8s\n", "bits", "mul+mod ns", "mont_mul ns", "speedup");
+
+  int i;
+  for (i = 0; i < nsizes; ++i)
+  {
+    const int nbits = modulus_bits[i];
+    if (nbits > BN_ARRAY_SIZE * 8 * WORD_SIZE)
+    {
+      continue;
+    }
+
+    random_bignum(n, nbits);
+    n->array[0] |= 1;
+    random_bignum(a, nbits);
+    random_bignum(b, nbits);
+    bignum_mod(a, n, a);
+    bignum_mod(b, n, b);
+
+    bignum_mont_init(&ctx, n);
+    bignum_to_mont(&ctx, a, am);
+    bignum_to_mont(&ctx, b, bm);
+
+    long iterations = 0;
+    double start = now();
+    double t_mont;
+    do
+    {
+      bignum_mont_mul(&ctx, am, bm, c);
+      iterations += 1;
+      t_mont = now() - start;
+    }
+    while (t_mont < MIN_SECONDS);
+    t_mont = (t_mont * 1e9) / iterations;
+
+    if (2 * nbits <= BN_ARRAY_SIZE * 8 * WORD_SIZE)
+    {
+      iterations = 0;
+      start = now();
+      double t_ref;
+      do
+      {
+        bignum_mul(a, b, tmp);
+        bignum_mod(tmp, n, c);
+        iterations += 1;
+        t_ref = now() - start;
+      }
+      while (t_ref < MIN_SECONDS);
+      t_ref = (t_ref * 1e9) / iterations;
+
+      /* Both must agree once c is taken out of Montgomery form */
+      bignum_mont_mul(&ctx, am, bm, tmp);
+      bignum_from_mont(&ctx, tmp, tmp);
+      assert(bignum_cmp(c, tmp) == EQUAL);
+
+      printf("  %6d  %14.1f  %14.1f  %7.1fx\n", nbits, t_ref, t_mont, t_ref / t_mont);
+    }
+    else
+    {
+      printf("  %6d  %14s  %14.1f  %8s\n", nbits, "-", t_mont, "-");
+    }
+  }
+  printf("\n");
+
+  free_bignum(a);
+  free_bignum(b);
+  free_bignum(n);
+  free_bignum(am);
+  free_bignum(bm);
+  free_bignum(c);
+  free_bignum(tmp);
+
+  return 0;
+}
+
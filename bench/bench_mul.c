@@ -0,0 +1,155 @@
+/*
+
+    Benchmark: row-wise vs. column-wise (Comba) multiplication
+    ===========================================================
+
+    mul_rowwise() below is the kernel bignum_mul used to have: for every limb
+    product it builds a temporary bignum, shifts it into place and adds it to
+    a row accumulator, with two scratch bignums taken from the heap per call.
+
+    bignum_mul() now sums each output column in a three-word accumulator and
+    writes the result limbs straight into c.
+
+    Both kernels are run on the same operands and the results are compared.
+    Build and run for every supported WORD_SIZE with `make bench`.
+
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <time.h>
+#include "bn.h"
+
+
+/* Minimum wall-clock time spent per measurement, in seconds */
+#define MIN_SECONDS 0.25
+
+
+static double now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+static _TPtr<_T_bn> new_bignum(void)
+{
+  _TPtr<_T_bn> n = (_TPtr<_T_bn>)__bn_malloc__(sizeof(_T_bn));
+  t_memset(n, 0, sizeof(_T_bn));
+  bignum_init(n);
+  return n;
+}
+
+
+static void free_bignum(_TPtr<_T_bn> n)
+{
+  __bn_free__(n->array);
+  __bn_free__(n);
+}
+
+
+/* Fill the lowest nwords limbs of n with random bits, zero the rest. */
+static void random_bignum(_TPtr<_T_bn> n, int nwords)
+{
+  int i;
+  bignum_init(n);
+  for (i = 0; i < nwords; ++i)
+  {
+    n->array[i] = (DTYPE)(((DTYPE_TMP)rand() << 16) ^ (DTYPE_TMP)rand());
+  }
+  bignum_normalize(n);
+}
+
+
+/* The previous bignum_mul kernel, kept as reference. */
+static void mul_rowwise(_TPtr<_T_bn> a, _TPtr<_T_bn> b, _TPtr<_T_bn> c)
+{
+  _TPtr<_T_bn> row = new_bignum();
+  _TPtr<_T_bn> tmp = new_bignum();
+  int i, j;
+
+  bignum_init(c);
+
+  for (i = 0; i < BN_ARRAY_SIZE; ++i)
+  {
+    bignum_init(row);
+
+    for (j = 0; j < BN_ARRAY_SIZE; ++j)
+    {
+      if (i + j < BN_ARRAY_SIZE)
+      {
+        bignum_init(tmp);
+        DTYPE_TMP intermediate = ((DTYPE_TMP)a->array[i] * (DTYPE_TMP)b->array[j]);
+        bignum_from_int(tmp, intermediate);
+        bignum_lshift(tmp, tmp, (i + j) * (8 * WORD_SIZE));
+        bignum_add(tmp, row, row);
+      }
+    }
+    bignum_add(c, row, c);
+  }
+  free_bignum(row);
+  free_bignum(tmp);
+}
+
+
+static double ns_per_op(void (*kernel)(_TPtr<_T_bn>, _TPtr<_T_bn>, _TPtr<_T_bn>), _TPtr<_T_bn> a, _TPtr<_T_bn> b, _TPtr<_T_bn> c)
+{
+  long iterations = 0;
+  double start = now();
+  double elapsed;
+  do
+  {
+    kernel(a, b, c);
+    iterations += 1;
+    elapsed = now() - start;
+  }
+  while (elapsed < MIN_SECONDS);
+
+  return (elapsed * 1e9) / iterations;
+}
+
+
+int main()
+{
+  /* Operand sizes as a fraction of the full BN_ARRAY_SIZE width */
+  static const int divisors[] = { 8, 2, 1 };
+  const int ndivisors = sizeof(divisors) / sizeof(*divisors);
+
+  _TPtr<_T_bn> a = new_bignum();
+  _TPtr<_T_bn> b = new_bignum();
+  _TPtr<_T_bn> c_row = new_bignum();
+  _TPtr<_T_bn> c_col = new_bignum();
+
+  srand(42);
+
+  printf("\nbignum_mul benchmark, WORD_SIZE = %d, BN_ARRAY_SIZE = %d\n\n", WORD_SIZE, BN_ARRAY_SIZE);
+  printf("  %6s  %14s  %14s  %8s\n", "bits", "row-wise ns", "column ns", "speedup");
+
+  int i;
+  for (i = 0; i < ndivisors; ++i)
+  {
+    int nwords = BN_ARRAY_SIZE / divisors[i];
+    random_bignum(a, nwords);
+    random_bignum(b, nwords);
+
+    double t_row = ns_per_op(mul_rowwise, a, b, c_row);
+    double t_col = ns_per_op(bignum_mul, a, b, c_col);
+
+    /* Both kernels must agree on the truncated product */
+    assert(bignum_cmp(c_row, c_col) == EQUAL);
+
+    printf("  %6d  %14.1f  %14.1f  %7.1fx\n", nwords * 8 * WORD_SIZE, t_row, t_col, t_row / t_col);
+  }
+  printf("\n");
+
+  free_bignum(a);
+  free_bignum(b);
+  free_bignum(c_row);
+  free_bignum(c_col);
+
+  return 0;
+}
+
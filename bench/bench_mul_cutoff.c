@@ -0,0 +1,154 @@
+/*
+
+    Benchmark: multiplication cutoffs
+    =================================
+
+    Times bignum_mul_limbs on two random operands of equal length, from 128
+    bits up to BENCH_MUL_MAX_BITS, for the KARATSUBA_CUTOFF, TOOM3_CUTOFF and
+    NTT_CUTOFF this file and bn.c were built with. bignum_mul_limbs goes
+    through the same tiers as bignum_mul, but on plain limb arrays, so the
+    operands are not limited to BN_ARRAY_SIZE. One line per size: operand
+    bits, ns per product -- or "-" once a product takes over BENCH_MUL_SLOW_NS,
+    as the sizes after it would only take longer. Built with -DBENCH_MUL_SQR it
+    times squares, a * a, instead. Built with -DBENCH_MUL_HIGH it times
+    bignum_mul_high(a, b, c, n) for n-limb operands -- the top half of their
+    product, as Barrett reduction takes it -- for the SHORTMUL_CUTOFF built in;
+    BN_ARRAY_SIZE is then set to BENCH_MUL_MAX_BITS.
+
+    The Makefile builds it several times over and prints the runs side by side:
+
+      make bench-karatsuba    up to 4096 bits, a range of KARATSUBA_CUTOFF values
+                              (Toom-3 and NTT off); the largest never uses Karatsuba
+      make bench-toom3        up to 32768 bits, a range of TOOM3_CUTOFF values
+      make bench-ntt          up to 2^20 bits, a range of NTT_CUTOFF values
+      make bench-crossover    up to 2^19 bits: schoolbook only, up to Karatsuba,
+                              up to Toom-3 and up to the NTT, with the fastest
+                              tier per size
+      make bench-sqr          up to 32768 bits, a * b against a * a
+      make bench-shortmul     up to 16384 bits, a range of SHORTMUL_CUTOFF values
+
+    The cutoff with the lowest times is the one to put into bn.c.
+
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "bn.h"
+#include "bench.h"
+
+
+#ifndef BENCH_MUL_MAX_BITS
+  #define BENCH_MUL_MAX_BITS 32768
+#endif
+#if defined(BENCH_MUL_HIGH) && (BN_ARRAY_SIZE != (BENCH_MUL_MAX_BITS / (8 * WORD_SIZE)))
+  #error build with -DBN_ARRAY_SIZE="(BENCH_MUL_MAX_BITS / (8 * WORD_SIZE))" for BENCH_MUL_HIGH
+#endif
+#ifndef BENCH_MUL_SLOW_NS
+  #define BENCH_MUL_SLOW_NS 5e7
+#endif
+
+
+static DTYPE *a, *b, *c;
+static int nlimbs;
+static bn_ws ws;
+#ifdef BENCH_MUL_HIGH
+static _TPtr<_T_bn> x;
+static _TPtr<_T_bn> y;
+static _TPtr<_T_bn> z;
+#endif
+
+
+static DTYPE* new_limbs(size_t n)
+{
+  DTYPE* p = (DTYPE*)malloc((n > 0) ? (n * sizeof(DTYPE)) : 1);
+  if (p == NULL)
+  {
+    fprintf(stderr, "out of memory\n");
+    exit(1);
+  }
+  return p;
+}
+
+
+static void random_limbs(DTYPE* n, int nwords)
+{
+  int i;
+  for (i = 0; i < nwords; ++i)
+  {
+    n[i] = (DTYPE)(((DTYPE_TMP)rand() << 16) ^ (DTYPE_TMP)rand());
+  }
+}
+
+
+static void run_mul(void* arg)
+{
+  (void)arg;
+#if defined(BENCH_MUL_HIGH)
+  bignum_mul_high(x, y, z, nlimbs);
+#elif defined(BENCH_MUL_SQR)
+  bignum_mul_limbs(c, a, nlimbs, a, nlimbs, &ws);
+#else
+  bignum_mul_limbs(c, a, nlimbs, b, nlimbs, &ws);
+#endif
+}
+
+
+int main()
+{
+  const int maxlimbs = BENCH_MUL_MAX_BITS / (8 * WORD_SIZE);
+  double ns = 0;
+  int nbits;
+#ifdef BENCH_MUL_HIGH
+  int i;
+#endif
+
+  a = new_limbs(maxlimbs);
+  b = new_limbs(maxlimbs);
+  c = new_limbs(2 * maxlimbs);
+  ws.size = bignum_mul_limbs_ws_size(maxlimbs, maxlimbs);
+  ws.limbs = new_limbs(ws.size / sizeof(DTYPE));
+  srand(42);
+#ifdef BENCH_MUL_HIGH
+  x = bignum_new();
+  y = bignum_new();
+  z = bignum_new();
+#endif
+
+  for (nbits = 128; nbits <= BENCH_MUL_MAX_BITS; nbits *= 2)
+  {
+    if (ns > BENCH_MUL_SLOW_NS)
+    {
+      printf("%d -\n", nbits);
+      continue;
+    }
+    nlimbs = nbits / (8 * WORD_SIZE);
+    random_limbs(a, nlimbs);
+    random_limbs(b, nlimbs);
+#ifdef BENCH_MUL_HIGH
+    bignum_init(x);
+    bignum_init(y);
+    for (i = 0; i < nlimbs; ++i)
+    {
+      x->array[i] = a[i];
+      y->array[i] = b[i];
+    }
+    bignum_normalize(x);
+    bignum_normalize(y);
+#endif
+    ns = bench_measure("mul", nbits, run_mul, NULL).median_ns;
+    printf("%d %.1f\n", nbits, ns);
+  }
+
+  free(a);
+  free(b);
+  free(c);
+  free(ws.limbs);
+#ifdef BENCH_MUL_HIGH
+  bignum_free(x);
+  bignum_free(y);
+  bignum_free(z);
+#endif
+
+  return 0;
+}
@@ -0,0 +1,239 @@
+/*
+
+    Benchmark: ns/op of every public operation
+    ==========================================
+
+    Each operation of bn.h is timed with bench_measure() (see bench.h) for
+    64, 256, 512 and 1024-bit operands, and the results are printed as a
+    table. Given a file name, the same results are also written there as
+    JSON -- `make bench` does that for every WORD_SIZE, into
+    ./build/bench_ops_w<WORD_SIZE>.json.
+
+    Operands are generated byte by byte from a fixed seed, like in
+    bench_wordsize.c, so every build works on the same numbers regardless of
+    its limb size. Results that did not settle within BENCH_MAX_SECONDS are
+    marked with a '*' in the table and "stable": false in the JSON.
+
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "bn.h"
+#include "bench.h"
+
+
+/* Random number of exactly nbits bits (a multiple of 8), filled from the least significant byte up */
+static void random_bignum(_TPtr<_T_bn> n, int nbits)
+{
+  const int nbytes = nbits / 8;
+  int i;
+  bignum_init(n);
+  for (i = 0; i < nbytes; ++i)
+  {
+    DTYPE byte = (DTYPE)(rand() & 0xFF);
+    if (i == nbytes - 1)
+    {
+      byte |= 0x80;
+    }
+    n->array[i / WORD_SIZE] |= (DTYPE)(byte << (8 * (i % WORD_SIZE)));
+  }
+  bignum_normalize(n);
+}
+
+
+enum
+{
+  OP_ADD, OP_SUB, OP_MUL, OP_SQR, OP_MUL_FULL, OP_MUL_LOW, OP_MUL_HIGH, OP_DIV, OP_MOD, OP_DIVMOD, OP_POW, OP_POWMOD, OP_ISQRT,
+  OP_AND, OP_OR, OP_XOR, OP_LSHIFT, OP_RSHIFT,
+  OP_CMP, OP_IS_ZERO, OP_INC, OP_DEC, OP_ASSIGN,
+  OP_FROM_INT, OP_TO_INT, OP_FROM_STRING, OP_TO_STRING,
+  OP_MONT_MUL, OP_BARRETT_MULMOD,
+  NOPS
+};
+
+static const char* op_names[NOPS] =
+{
+  "add", "sub", "mul", "sqr", "mul_full", "mul_low", "mul_high", "div", "mod", "divmod", "pow", "powmod", "isqrt",
+  "and", "or", "xor", "lshift", "rshift",
+  "cmp", "is_zero", "inc", "dec", "assign",
+  "from_int", "to_int", "from_string", "to_string",
+  "mont_mul", "barrett_mulmod",
+};
+
+
+/* Exponent of OP_POW, the base gets nbits / POW_EXPONENT bits */
+#define POW_EXPONENT 4
+
+/* Room for every limb as hex, see bignum_to_string */
+#define STRING_SIZE ((BN_ARRAY_SIZE * 2 * WORD_SIZE) + 1)
+
+
+static _TPtr<_T_bn> a, b, n, c, d;
+static bn_mont_ctx mont;
+static bn_barrett_ctx barrett;
+static char hex[STRING_SIZE];
+static int nhex;
+static _TPtr<char> str;
+static int nlimbs;
+static volatile int sink;
+
+
+static void run_op(void* arg)
+{
+  switch (*(const int*)arg)
+  {
+    case OP_ADD:            bignum_add(a, b, c);                      break;
+    case OP_SUB:            bignum_sub(a, b, c);                      break;
+    case OP_MUL:            bignum_mul(a, b, c);                      break;
+    case OP_SQR:            bignum_sqr(a, c);                         break;
+    case OP_MUL_FULL:       bignum_mul_full(a, b, c, d);              break;
+    case OP_MUL_LOW:        bignum_mul_low(a, b, c, nlimbs);          break;
+    case OP_MUL_HIGH:       bignum_mul_high(a, b, c, nlimbs);         break;
+    case OP_DIV:            bignum_div(a, b, c);                      break;
+    case OP_MOD:            bignum_mod(a, b, c);                      break;
+    case OP_DIVMOD:         bignum_divmod(a, b, c, d);                break;
+    case OP_POW:            bignum_pow(a, b, c);                      break;
+    case OP_POWMOD:         bignum_powmod(a, b, n, c);                break;
+    case OP_ISQRT:          bignum_isqrt(a, c);                       break;
+    case OP_AND:            bignum_and(a, b, c);                      break;
+    case OP_OR:             bignum_or(a, b, c);                       break;
+    case OP_XOR:            bignum_xor(a, b, c);                      break;
+    case OP_LSHIFT:         bignum_lshift(a, c, 37);                  break;
+    case OP_RSHIFT:         bignum_rshift(a, c, 37);                  break;
+    case OP_CMP:            sink = bignum_cmp(a, b);                  break;
+    case OP_IS_ZERO:        sink = bignum_is_zero(a);                 break;
+    case OP_INC:            bignum_inc(c);                            break;
+    case OP_DEC:            bignum_dec(c);                            break;
+    case OP_ASSIGN:         bignum_assign(c, a);                      break;
+    case OP_FROM_INT:       bignum_from_int(c, 0x12345678);           break;
+    case OP_TO_INT:         sink = bignum_to_int(a);                  break;
+    case OP_FROM_STRING:    bignum_from_string(c, hex, nhex);         break;
+    case OP_TO_STRING:      bignum_to_string(a, str, STRING_SIZE);    break;
+    case OP_MONT_MUL:       bignum_mont_mul(&mont, a, b, c);          break;
+    case OP_BARRETT_MULMOD: bignum_barrett_mulmod(&barrett, a, b, c); break;
+  }
+}
+
+
+/* Operands for op at nbits: a and b of nbits unless the operation calls for smaller ones */
+static void setup(int op, int nbits)
+{
+  srand(42);
+  random_bignum(n, nbits);
+  n->array[0] |= 1;
+  random_bignum(a, nbits);
+  random_bignum(b, nbits);
+  bignum_assign(c, a);
+
+  switch (op)
+  {
+    /* Products and quotients get a half-size second operand */
+    case OP_MUL:
+    case OP_SQR:
+      random_bignum(a, nbits / 2);
+      random_bignum(b, nbits / 2);
+      break;
+
+    /* Parts of the double-width product of two nbits operands, the low or high nbits */
+    case OP_MUL_FULL:
+    case OP_MUL_LOW:
+    case OP_MUL_HIGH:
+      nlimbs = nbits / (8 * WORD_SIZE);
+      break;
+
+    case OP_DIV:
+    case OP_MOD:
+    case OP_DIVMOD:
+      random_bignum(b, nbits / 2);
+      break;
+
+    /* a^4 has about nbits bits */
+    case OP_POW:
+      random_bignum(a, nbits / POW_EXPONENT);
+      bignum_from_int(b, POW_EXPONENT);
+      break;
+
+    /* Modular operations get reduced operands */
+    case OP_POWMOD:
+    case OP_MONT_MUL:
+    case OP_BARRETT_MULMOD:
+      bignum_mod(a, n, a);
+      bignum_mod(b, n, b);
+      bignum_mont_init(&mont, n);
+      bignum_barrett_init(&barrett, n);
+      break;
+
+    /* nbits / 4 hex digits, most significant first */
+    case OP_FROM_STRING:
+      bignum_to_string(a, str, STRING_SIZE);
+      for (nhex = 0; (nhex < STRING_SIZE - 1) && (str[nhex] != 0); ++nhex)
+      {
+        hex[nhex] = str[nhex];
+      }
+      hex[nhex] = 0;
+      break;
+  }
+}
+
+
+int main(int argc, char** argv)
+{
+  static const int operand_bits[] = { 64, 256, 512, 1024 };
+  const int nsizes = sizeof(operand_bits) / sizeof(*operand_bits);
+  const int width = BN_ARRAY_SIZE * 8 * WORD_SIZE;
+  static bench_result results[NOPS * (sizeof(operand_bits) / sizeof(*operand_bits))];
+  static char buf[STRING_SIZE];
+  int nresults = 0;
+
+  a = bignum_new();
+  b = bignum_new();
+  n = bignum_new();
+  c = bignum_new();
+  d = bignum_new();
+  str = StaticUncheckedToTStrAdaptor(buf, sizeof(buf));
+
+  printf("\nOperation benchmark, WORD_SIZE = %d, BN_ARRAY_SIZE = %d\n\n", WORD_SIZE, BN_ARRAY_SIZE);
+  bench_print_header(stdout);
+
+  int i, op;
+  for (i = 0; i < nsizes; ++i)
+  {
+    const int nbits = operand_bits[i];
+    if (nbits > width)
+    {
+      continue;
+    }
+
+    for (op = 0; op < NOPS; ++op)
+    {
+      setup(op, nbits);
+      results[nresults] = bench_measure(op_names[op], nbits, run_op, &op);
+      bench_print(stdout, &results[nresults]);
+      nresults += 1;
+    }
+  }
+  printf("\n");
+
+  if (argc > 1)
+  {
+    FILE* out = fopen(argv[1], "w");
+    if (out == NULL)
+    {
+      perror(argv[1]);
+      return 1;
+    }
+    bench_json_write(out, "bench_ops", results, nresults);
+    fclose(out);
+    printf("  results written to %s\n\n", argv[1]);
+  }
+
+  bignum_free(a);
+  bignum_free(b);
+  bignum_free(n);
+  bignum_free(c);
+  bignum_free(d);
+  __free__(str);
+
+  return 0;
+}
@@ -0,0 +1,152 @@
+/*
+
+    Benchmark: bignum_pow across exponent sizes
+    ============================================
+
+    pow_linear() below is the algorithm bignum_pow used to have: one
+    bignum_mul per unit of the exponent's value. bignum_pow() now scans the
+    exponent bits (square-and-multiply), so its cost grows with log2(b).
+
+    The linear reference is only timed for small exponents -- beyond that it
+    would not finish in reasonable time.
+    Build and run for every supported WORD_SIZE with `make bench`.
+
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <time.h>
+#include "bn.h"
+
+
+/* Minimum wall-clock time spent per measurement, in seconds */
+#define MIN_SECONDS 0.25
+
+/* Largest exponent (in bits) the linear reference is run for */
+#define MAX_LINEAR_EXPONENT_BITS 12
+
+
+static double now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+static _TPtr<_T_bn> new_bignum(void)
+{
+  _TPtr<_T_bn> n = (_TPtr<_T_bn>)__bn_malloc__(sizeof(_T_bn));
+  t_memset(n, 0, sizeof(_T_bn));
+  bignum_init(n);
+  return n;
+}
+
+
+static void free_bignum(_TPtr<_T_bn> n)
+{
+  __bn_free__(n->array);
+  __bn_free__(n);
+}
+
+
+/* The previous bignum_pow, kept as reference. */
+static void pow_linear(_TPtr<_T_bn> a, _TPtr<_T_bn> b, _TPtr<_T_bn> c)
+{
+  _TPtr<_T_bn> tmp = new_bignum();
+  _TPtr<_T_bn> bcopy = new_bignum();
+
+  bignum_init(c);
+
+  if (bignum_is_zero(b))
+  {
+    bignum_inc(c);
+  }
+  else
+  {
+    bignum_assign(bcopy, b);
+    bignum_assign(tmp, a);
+    bignum_dec(bcopy);
+    while (!bignum_is_zero(bcopy))
+    {
+      bignum_mul(tmp, a, c);
+      bignum_dec(bcopy);
+      bignum_assign(tmp, c);
+    }
+    bignum_assign(c, tmp);
+  }
+
+  free_bignum(tmp);
+  free_bignum(bcopy);
+}
+
+
+static double ns_per_op(void (*kernel)(_TPtr<_T_bn>, _TPtr<_T_bn>, _TPtr<_T_bn>), _TPtr<_T_bn> a, _TPtr<_T_bn> b, _TPtr<_T_bn> c)
+{
+  long iterations = 0;
+  double start = now();
+  double elapsed;
+  do
+  {
+    kernel(a, b, c);
+    iterations += 1;
+    elapsed = now() - start;
+  }
+  while (elapsed < MIN_SECONDS);
+
+  return (elapsed * 1e9) / iterations;
+}
+
+
+int main()
+{
+  /* Exponents as (number of bits, base): odd bases never take the overflow shortcut */
+  static const struct { int ebits; int base; } cases[] =
+  {
+    {  4, 3 }, {  8, 3 }, { 12, 3 }, { 16, 3 }, { 32, 3 }, { 64, 3 },
+    {  4, 2 }, { 12, 2 }, { 64, 2 },
+  };
+  const int ncases = sizeof(cases) / sizeof(*cases);
+
+  _TPtr<_T_bn> a = new_bignum();
+  _TPtr<_T_bn> b = new_bignum();
+  _TPtr<_T_bn> c_lin = new_bignum();
+  _TPtr<_T_bn> c_bin = new_bignum();
+
+  printf("\nbignum_pow benchmark, WORD_SIZE = %d, BN_ARRAY_SIZE = %d\n\n", WORD_SIZE, BN_ARRAY_SIZE);
+  printf("  %4s  %6s  %14s  %14s  %8s\n", "base", "e bits", "linear ns", "binary ns", "speedup");
+
+  int i;
+  for (i = 0; i < ncases; ++i)
+  {
+    /* b = 2^ebits - 1: every exponent bit set, the worst case for square-and-multiply */
+    bignum_from_int(a, cases[i].base);
+    bignum_from_int(b, 1);
+    bignum_lshift(b, b, cases[i].ebits);
+    bignum_dec(b);
+
+    double t_bin = ns_per_op(bignum_pow, a, b, c_bin);
+
+    if (cases[i].ebits <= MAX_LINEAR_EXPONENT_BITS)
+    {
+      double t_lin = ns_per_op(pow_linear, a, b, c_lin);
+      assert(bignum_cmp(c_lin, c_bin) == EQUAL);
+      printf("  %4d  %6d  %14.1f  %14.1f  %7.1fx\n", cases[i].base, cases[i].ebits, t_lin, t_bin, t_lin / t_bin);
+    }
+    else
+    {
+      printf("  %4d  %6d  %14s  %14.1f  %8s\n", cases[i].base, cases[i].ebits, "-", t_bin, "-");
+    }
+  }
+  printf("\n");
+
+  free_bignum(a);
+  free_bignum(b);
+  free_bignum(c_lin);
+  free_bignum(c_bin);
+
+  return 0;
+}
+
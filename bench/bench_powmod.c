@@ -0,0 +1,173 @@
+/*
+
+    Benchmark: bignum_powmod with 512- and 1024-bit moduli
+    =======================================================
+
+    pow_mod_faster() below is the hand-rolled modular exponentiation from
+    tests/rsa.c: it copies the exponent, shifts it right one bit at a time
+    and reduces every product with bignum_mod. Because bignum_mul truncates,
+    it is only correct while the modulus fits in half a bignum, so it is
+    timed for the 512-bit modulus only.
+
+    Exponents are as wide as the modulus (private-key sized).
+    Build and run for every supported WORD_SIZE with `make bench`.
+
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <time.h>
+#include "bn.h"
+
+
+/* Minimum wall-clock time spent per measurement, in seconds */
+#define MIN_SECONDS 0.5
+
+
+static double now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+static _TPtr<_T_bn> new_bignum(void)
+{
+  _TPtr<_T_bn> n = (_TPtr<_T_bn>)__bn_malloc__(sizeof(_T_bn));
+  t_memset(n, 0, sizeof(_T_bn));
+  bignum_init(n);
+  return n;
+}
+
+
+static void free_bignum(_TPtr<_T_bn> n)
+{
+  __bn_free__(n->array);
+  __bn_free__(n);
+}
+
+
+/* Random number of exactly nbits bits */
+static void random_bignum(_TPtr<_T_bn> n, int nbits)
+{
+  const int nwords = nbits / (8 * WORD_SIZE);
+  int i;
+  bignum_init(n);
+  for (i = 0; i < nwords; ++i)
+  {
+    n->array[i] = (DTYPE)(((DTYPE_TMP)rand() << 16) ^ (DTYPE_TMP)rand());
+  }
+  n->array[nwords - 1] |= (DTYPE)DTYPE_MSB;
+  bignum_normalize(n);
+}
+
+
+/* Modular exponentiation as hand-rolled in tests/rsa.c */
+static void pow_mod_faster(_TPtr<_T_bn> a, _TPtr<_T_bn> b, _TPtr<_T_bn> n, _TPtr<_T_bn> res)
+{
+  _TPtr<_T_bn> tmpa = new_bignum();
+  _TPtr<_T_bn> tmpb = new_bignum();
+  _TPtr<_T_bn> tmp = new_bignum();
+
+  bignum_from_int(res, 1);
+  bignum_assign(tmpa, a);
+  bignum_assign(tmpb, b);
+
+  while (1)
+  {
+    if (tmpb->array[0] & 1)
+    {
+      bignum_mul(res, tmpa, tmp);
+      bignum_mod(tmp, n, res);
+    }
+    bignum_rshift(tmpb, tmp, 1);
+    bignum_assign(tmpb, tmp);
+
+    if (bignum_is_zero(tmpb))
+      break;
+
+    bignum_mul(tmpa, tmpa, tmp);
+    bignum_mod(tmp, n, tmpa);
+  }
+
+  free_bignum(tmpa);
+  free_bignum(tmpb);
+  free_bignum(tmp);
+}
+
+
+static double ns_per_op(void (*kernel)(_TPtr<_T_bn>, _TPtr<_T_bn>, _TPtr<_T_bn>, _TPtr<_T_bn>),
+                        _TPtr<_T_bn> a, _TPtr<_T_bn> b, _TPtr<_T_bn> n, _TPtr<_T_bn> c)
+{
+  long iterations = 0;
+  double start = now();
+  double elapsed;
+  do
+  {
+    kernel(a, b, n, c);
+    iterations += 1;
+    elapsed = now() - start;
+  }
+  while (elapsed < MIN_SECONDS);
+
+  return (elapsed * 1e9) / iterations;
+}
+
+
+int main()
+{
+  static const int modulus_bits[] = { 512, 1024 };
+  const int nsizes = sizeof(modulus_bits) / sizeof(*modulus_bits);
+
+  _TPtr<_T_bn> a = new_bignum();
+  _TPtr<_T_bn> b = new_bignum();
+  _TPtr<_T_bn> n = new_bignum();
+  _TPtr<_T_bn> c_ref = new_bignum();
+  _TPtr<_T_bn> c = new_bignum();
+
+  srand(42);
+
+  printf("\nbignum_powmod benchmark, WORD_SIZE = %d, BN_ARRAY_SIZE = %d\n\n", WORD_SIZE, BN_ARRAY_SIZE);
+  printf("  %6s  %16s  %16s  %8s  %10s\n", "bits", "rsa.c loop ns", "powmod ns", "speedup", "ops/sec");
+
+  int i;
+  for (i = 0; i < nsizes; ++i)
+  {
+    const int nbits = modulus_bits[i];
+    if (nbits > BN_ARRAY_SIZE * 8 * WORD_SIZE)
+    {
+      continue;
+    }
+
+    random_bignum(n, nbits);
+    random_bignum(b, nbits);
+    random_bignum(a, nbits);
+    bignum_mod(a, n, a);
+
+    double t_new = ns_per_op(bignum_powmod, a, b, n, c);
+
+    if (2 * nbits <= BN_ARRAY_SIZE * 8 * WORD_SIZE)
+    {
+      double t_ref = ns_per_op(pow_mod_faster, a, b, n, c_ref);
+      assert(bignum_cmp(c_ref, c) == EQUAL);
+      printf("  %6d  %16.0f  %16.0f  %7.1fx  %10.1f\n", nbits, t_ref, t_new, t_ref / t_new, 1e9 / t_new);
+    }
+    else
+    {
+      printf("  %6d  %16s  %16.0f  %8s  %10.1f\n", nbits, "-", t_new, "-", 1e9 / t_new);
+    }
+  }
+  printf("\n");
+
+  free_bignum(a);
+  free_bignum(b);
+  free_bignum(n);
+  free_bignum(c_ref);
+  free_bignum(c);
+
+  return 0;
+}
+
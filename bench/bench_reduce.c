@@ -0,0 +1,219 @@
+/*
+
+    Benchmark: choosing a modular reduction strategy
+    ================================================
+
+    For each modulus size and number of products reduced per modulus, times
+    the whole job -- precomputation included -- with
+
+      - plain:       bignum_mul + bignum_mod
+      - Barrett:     bignum_barrett_init, then bignum_barrett_mulmod per product
+      - Montgomery:  bignum_mont_init, to_mont of both operands, bignum_mont_mul
+                     per product and one from_mont at the end
+
+    and reports nanoseconds per product. Montgomery's conversions only pay off
+    once enough products share a modulus; Barrett needs no conversion, but its
+    context costs one long division. bignum_mul truncates, so the plain
+    variant is only timed for moduli of up to half the bignum width.
+
+    Build and run for every supported WORD_SIZE with `make bench`.
+
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <time.h>
+#include "bn.h"
+
+
+/* Minimum wall-clock time spent per measurement, in seconds */
+#define MIN_SECONDS 0.2
+
+
+static double now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+static _TPtr<_T_bn> new_bignum(void)
+{
+  _TPtr<_T_bn> n = (_TPtr<_T_bn>)__bn_malloc__(sizeof(_T_bn));
+  t_memset(n, 0, sizeof(_T_bn));
+  bignum_init(n);
+  return n;
+}
+
+
+static void free_bignum(_TPtr<_T_bn> n)
+{
+  __bn_free__(n->array);
+  __bn_free__(n);
+}
+
+
+/* Random number of exactly nbits bits */
+static void random_bignum(_TPtr<_T_bn> n, int nbits)
+{
+  const int nwords = nbits / (8 * WORD_SIZE);
+  int i;
+  bignum_init(n);
+  for (i = 0; i < nwords; ++i)
+  {
+    n->array[i] = (DTYPE)(((DTYPE_TMP)rand() << 16) ^ (DTYPE_TMP)rand());
+  }
+  n->array[nwords - 1] |= (DTYPE)DTYPE_MSB;
+  bignum_normalize(n);
+}
+
+
+static _TPtr<_T_bn> a, b, n, c, am, bm, tmp;
+
+
+/* Each job multiplies a by b, nproducts times, modulo n; the result ends up in c */
+static void job_plain(int nproducts)
+{
+  int i;
+  for (i = 0; i < nproducts; ++i)
+  {
+    bignum_mul(a, b, tmp);
+    bignum_mod(tmp, n, c);
+  }
+}
+
+
+static void job_barrett(int nproducts)
+{
+  bn_barrett_ctx ctx;
+  int i;
+  bignum_barrett_init(&ctx, n);
+  for (i = 0; i < nproducts; ++i)
+  {
+    bignum_barrett_mulmod(&ctx, a, b, c);
+  }
+}
+
+
+static void job_mont(int nproducts)
+{
+  bn_mont_ctx ctx;
+  int i;
+  bignum_mont_init(&ctx, n);
+  bignum_to_mont(&ctx, a, am);
+  bignum_to_mont(&ctx, b, bm);
+  for (i = 0; i < nproducts; ++i)
+  {
+    bignum_mont_mul(&ctx, am, bm, tmp);
+  }
+  bignum_from_mont(&ctx, tmp, c);
+}
+
+
+static double ns_per_product(void (*job)(int), int nproducts)
+{
+  long iterations = 0;
+  double start = now();
+  double elapsed;
+  do
+  {
+    job(nproducts);
+    iterations += 1;
+    elapsed = now() - start;
+  }
+  while (elapsed < MIN_SECONDS);
+
+  return (elapsed * 1e9) / ((double)iterations * nproducts);
+}
+
+
+int main()
+{
+  static const int modulus_bits[] = { 128, 256, 512, 1024 };
+  static const int products_per_modulus[] = { 1, 4, 16, 64, 256 };
+  const int nsizes = sizeof(modulus_bits) / sizeof(*modulus_bits);
+  const int ncounts = sizeof(products_per_modulus) / sizeof(*products_per_modulus);
+
+  a = new_bignum();
+  b = new_bignum();
+  n = new_bignum();
+  c = new_bignum();
+  am = new_bignum();
+  bm = new_bignum();
+  tmp = new_bignum();
+  _TPtr<_T_bn> c_ref = new_bignum();
+
+  srand(42);
+
+  printf("\nModular reduction benchmark, WORD_SIZE = %d, BN_ARRAY_SIZE = %d\n", WORD_SIZE, BN_ARRAY_SIZE);
+  printf("(ns per product, setup included)\n\n");
+  printf("  %6s  %8s  %12s  %12s  %12s  %10s\n", "bits", "products", "plain", "Barrett", "Montgomery", "fastest");
+
+  int i, j;
+  for (i = 0; i < nsizes; ++i)
+  {
+    const int nbits = modulus_bits[i];
+    if (nbits > BN_ARRAY_SIZE * 8 * WORD_SIZE)
+    {
+      continue;
+    }
+    const int plain_fits = (2 * nbits <= BN_ARRAY_SIZE * 8 * WORD_SIZE);
+
+    random_bignum(n, nbits);
+    n->array[0] |= 1;
+    random_bignum(a, nbits);
+    random_bignum(b, nbits);
+    bignum_mod(a, n, a);
+    bignum_mod(b, n, b);
+
+    /* All strategies must agree */
+    job_barrett(1);
+    bignum_assign(c_ref, c);
+    job_mont(1);
+    assert(bignum_cmp(c, c_ref) == EQUAL);
+    if (plain_fits)
+    {
+      job_plain(1);
+      assert(bignum_cmp(c, c_ref) == EQUAL);
+    }
+
+    for (j = 0; j < ncounts; ++j)
+    {
+      const int k = products_per_modulus[j];
+      double t_plain = plain_fits ? ns_per_product(job_plain, k) : 0.0;
+      double t_barrett = ns_per_product(job_barrett, k);
+      double t_mont = ns_per_product(job_mont, k);
+
+      const char* fastest = (t_barrett < t_mont) ? "Barrett" : "Montgomery";
+      if (plain_fits && (t_plain < t_barrett) && (t_plain < t_mont))
+      {
+        fastest = "plain";
+      }
+
+      if (plain_fits)
+      {
+        printf("  %6d  %8d  %12.1f  %12.1f  %12.1f  %10s\n", nbits, k, t_plain, t_barrett, t_mont, fastest);
+      }
+      else
+      {
+        printf("  %6d  %8d  %12s  %12.1f  %12.1f  %10s\n", nbits, k, "-", t_barrett, t_mont, fastest);
+      }
+    }
+  }
+  printf("\n");
+
+  free_bignum(a);
+  free_bignum(b);
+  free_bignum(n);
+  free_bignum(c);
+  free_bignum(am);
+  free_bignum(bm);
+  free_bignum(tmp);
+  free_bignum(c_ref);
+
+  return 0;
+}
+
@@ -0,0 +1,133 @@
+/*
+
+    Benchmark: cost of the basic operations for one WORD_SIZE
+    ==========================================================
+
+    WORD_SIZE is fixed at compile time, so the comparison between limb
+    sizes is made by building this file once per WORD_SIZE and putting the
+    outputs side by side -- `make bench-wordsize` does that for 4 and 8.
+
+    Operands are generated byte by byte from a fixed seed, so every build
+    works on the same numbers regardless of its limb size.
+    Output is one "operation bits ns" line per measurement, timed with
+    bench_measure() from bench.h.
+
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include "bn.h"
+#include "bench.h"
+
+
+/* Random number of exactly nbits bits (a multiple of 8), filled from the least significant byte up */
+static void random_bignum(_TPtr<_T_bn> n, int nbits)
+{
+  const int nbytes = nbits / 8;
+  int i;
+  bignum_init(n);
+  for (i = 0; i < nbytes; ++i)
+  {
+    DTYPE byte = (DTYPE)(rand() & 0xFF);
+    if (i == nbytes - 1)
+    {
+      byte |= 0x80;
+    }
+    n->array[i / WORD_SIZE] |= (DTYPE)(byte << (8 * (i % WORD_SIZE)));
+  }
+  bignum_normalize(n);
+}
+
+
+enum { OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_MOD, OP_CMP, OP_LSHIFT, OP_RSHIFT, OP_POWMOD, OP_MONT_MUL, OP_BARRETT_MULMOD, NOPS };
+
+static const char* op_names[NOPS] =
+{
+  "add", "sub", "mul", "div", "mod", "cmp", "lshift", "rshift", "powmod", "mont_mul", "barrett_mulmod",
+};
+
+
+static _TPtr<_T_bn> a, b, n, c;
+static bn_mont_ctx mont;
+static bn_barrett_ctx barrett;
+
+
+static void run_op(void* arg)
+{
+  switch (*(const int*)arg)
+  {
+    case OP_ADD:            bignum_add(a, b, c);                     break;
+    case OP_SUB:            bignum_sub(a, b, c);                     break;
+    case OP_MUL:            bignum_mul(a, b, c);                     break;
+    case OP_DIV:            bignum_div(a, b, c);                     break;
+    case OP_MOD:            bignum_mod(a, b, c);                     break;
+    case OP_CMP:            (void)bignum_cmp(a, b);                  break;
+    case OP_LSHIFT:         bignum_lshift(a, c, 37);                 break;
+    case OP_RSHIFT:         bignum_rshift(a, c, 37);                 break;
+    case OP_POWMOD:         bignum_powmod(a, b, n, c);               break;
+    case OP_MONT_MUL:       bignum_mont_mul(&mont, a, b, c);         break;
+    case OP_BARRETT_MULMOD: bignum_barrett_mulmod(&barrett, a, b, c); break;
+  }
+}
+
+
+int main()
+{
+  static const int operand_bits[] = { 64, 256, 512, 1024 };
+  const int nsizes = sizeof(operand_bits) / sizeof(*operand_bits);
+  const int width = BN_ARRAY_SIZE * 8 * WORD_SIZE;
+
+  a = bignum_new();
+  b = bignum_new();
+  n = bignum_new();
+  c = bignum_new();
+
+  int i, op;
+  for (i = 0; i < nsizes; ++i)
+  {
+    const int nbits = operand_bits[i];
+    if (nbits > width)
+    {
+      continue;
+    }
+
+    for (op = 0; op < NOPS; ++op)
+    {
+      srand(42);
+      random_bignum(n, nbits);
+      n->array[0] |= 1;
+      random_bignum(a, nbits);
+
+      /* Products and quotients get a half-size second operand, modular operations reduced ones */
+      if ((op == OP_MUL) || (op == OP_DIV) || (op == OP_MOD))
+      {
+        random_bignum(a, (op == OP_MUL) ? (nbits / 2) : nbits);
+        random_bignum(b, nbits / 2);
+      }
+      else if ((op == OP_POWMOD) || (op == OP_MONT_MUL) || (op == OP_BARRETT_MULMOD))
+      {
+        random_bignum(b, nbits);
+        bignum_mod(a, n, a);
+        bignum_mod(b, n, b);
+        bignum_mont_init(&mont, n);
+        bignum_barrett_init(&barrett, n);
+      }
+      else
+      {
+        random_bignum(b, nbits);
+      }
+
+      printf("%-16s %5d %14.1f\n", op_names[op], nbits, bench_measure(op_names[op], nbits, run_op, &op).ns_per_op);
+    }
+  }
+
+  bignum_free(a);
+  bignum_free(b);
+  bignum_free(n);
+  bignum_free(c);
+
+  return 0;
+}
+
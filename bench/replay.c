@@ -0,0 +1,364 @@
+/*
+
+    Replay of a BN_TRACE capture
+    ============================
+
+      replay trace [results.json]
+
+    Reads a trace written by bignum_trace_dump() (format in bn.h), rebuilds
+    the operands of every recorded call and times them against this build:
+    per function, bench_measure() runs all of its calls in trace order, so
+    ns/call comes from the operand sizes the application really used. The
+    whole trace is also timed once in its original order.
+
+    Operands are stored as bytes, so a trace recorded with one WORD_SIZE
+    replays with any other. inc and dec work in place on their operand, as
+    they do in the application, so repeated passes drift a little from the
+    recorded values.
+
+    `make replay` records factorial with -DBN_TRACE and replays it,
+    `make replay TRACE=file` replays a capture of your own.
+
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bn.h"
+#include "bench.h"
+
+
+#define MAX_OPERANDS 3
+
+
+typedef struct call
+{
+  int fn;
+  int arg;
+  int nops;
+  _TPtr<_T_bn> op[MAX_OPERANDS];
+  bn_mont_ctx* mont;          /* modulus op[0], for the Montgomery calls */
+  bn_barrett_ctx* barrett;    /* modulus op[0], for the Barrett calls */
+} call;
+
+
+typedef struct group
+{
+  call** calls;
+  int ncalls;
+} group;
+
+
+#define FN_NAME(name) #name,
+static const char* const fn_names[BN_FN_COUNT] = { "(outside)", BN_FUNCTIONS(FN_NAME) };
+#undef FN_NAME
+
+
+static _TPtr<_T_bn> c, d;
+static volatile int sink;
+
+
+static void fail(const char* msg)
+{
+  fprintf(stderr, "replay: %s\n", msg);
+  exit(1);
+}
+
+
+static unsigned read_u16(const unsigned char* p)
+{
+  return p[0] | (p[1] << 8);
+}
+
+
+/* Number from nbytes bytes, least significant first */
+static _TPtr<_T_bn> load_operand(const unsigned char* p, int nbytes)
+{
+  _TPtr<_T_bn> n = bignum_new();
+  int i;
+  if (nbytes > BN_ARRAY_SIZE * WORD_SIZE)
+  {
+    fail("operand larger than BN_ARRAY_SIZE");
+  }
+  for (i = 0; i < nbytes; ++i)
+  {
+    n->array[i / WORD_SIZE] |= (DTYPE)((DTYPE)p[i] << (8 * (i % WORD_SIZE)));
+  }
+  bignum_normalize(n);
+  return n;
+}
+
+
+static void run_call(call* k)
+{
+  _TPtr<_T_bn>* op = k->op;
+
+  switch (k->fn)
+  {
+    case BN_FN_add:            bignum_add(op[0], op[1], c);                   break;
+    case BN_FN_sub:            bignum_sub(op[0], op[1], c);                   break;
+    case BN_FN_mul:            bignum_mul(op[0], op[1], c);                   break;
+    case BN_FN_sqr:            bignum_sqr(op[0], c);                          break;
+    case BN_FN_mul_full:       bignum_mul_full(op[0], op[1], c, d);           break;
+    case BN_FN_mul_low:        bignum_mul_low(op[0], op[1], c, k->arg);       break;
+    case BN_FN_mul_high:       bignum_mul_high(op[0], op[1], c, k->arg);      break;
+    case BN_FN_div:            bignum_div(op[0], op[1], c);                   break;
+    case BN_FN_mod:            bignum_mod(op[0], op[1], c);                   break;
+    case BN_FN_divmod:         bignum_divmod(op[0], op[1], c, d);             break;
+    case BN_FN_and:            bignum_and(op[0], op[1], c);                   break;
+    case BN_FN_or:             bignum_or(op[0], op[1], c);                    break;
+    case BN_FN_xor:            bignum_xor(op[0], op[1], c);                   break;
+    case BN_FN_lshift:         bignum_lshift(op[0], c, k->arg);               break;
+    case BN_FN_rshift:         bignum_rshift(op[0], c, k->arg);               break;
+    case BN_FN_cmp:            sink = bignum_cmp(op[0], op[1]);               break;
+    case BN_FN_is_zero:        sink = bignum_is_zero(op[0]);                  break;
+    case BN_FN_inc:            bignum_inc(op[0]);                             break;
+    case BN_FN_dec:            bignum_dec(op[0]);                             break;
+    case BN_FN_pow:            bignum_pow(op[0], op[1], c);                   break;
+    case BN_FN_powmod:         bignum_powmod(op[0], op[1], op[2], c);         break;
+    case BN_FN_isqrt:          bignum_isqrt(op[0], c);                        break;
+    case BN_FN_assign:         bignum_assign(c, op[0]);                       break;
+    case BN_FN_to_mont:        bignum_to_mont(k->mont, op[1], c);             break;
+    case BN_FN_from_mont:      bignum_from_mont(k->mont, op[1], c);           break;
+    case BN_FN_mont_mul:       bignum_mont_mul(k->mont, op[1], op[2], c);     break;
+    case BN_FN_barrett_mulmod: bignum_barrett_mulmod(k->barrett, op[1], op[2], c); break;
+    case BN_FN_barrett_reduce:
+      bignum_barrett_reduce(k->barrett, op[1], ((k->nops > 2) ? op[2] : NULL), c);
+      break;
+  }
+}
+
+
+/* Operands each function needs, 0 for functions that are not recorded */
+static int min_operands(int fn)
+{
+  switch (fn)
+  {
+    case BN_FN_lshift: case BN_FN_rshift: case BN_FN_is_zero: case BN_FN_inc: case BN_FN_dec:
+    case BN_FN_isqrt: case BN_FN_assign: case BN_FN_sqr:
+      return 1;
+    case BN_FN_add: case BN_FN_sub: case BN_FN_mul: case BN_FN_div: case BN_FN_mod: case BN_FN_divmod:
+    case BN_FN_and: case BN_FN_or: case BN_FN_xor: case BN_FN_cmp: case BN_FN_pow:
+    case BN_FN_to_mont: case BN_FN_from_mont: case BN_FN_barrett_reduce:
+    case BN_FN_mul_full: case BN_FN_mul_low: case BN_FN_mul_high:
+      return 2;
+    case BN_FN_powmod: case BN_FN_mont_mul: case BN_FN_barrett_mulmod:
+      return 3;
+  }
+  return 0;
+}
+
+
+static void run_group(void* arg)
+{
+  group* g = (group*)arg;
+  int i;
+  for (i = 0; i < g->ncalls; ++i)
+  {
+    run_call(g->calls[i]);
+  }
+}
+
+
+static int bit_length(_TPtr<_T_bn> n)
+{
+  int bits = n->used * 8 * WORD_SIZE;
+  DTYPE top = (n->used > 0) ? n->array[n->used - 1] : 0;
+  while ((bits > 0) && !(top & ((DTYPE)1 << (8 * WORD_SIZE - 1))))
+  {
+    top <<= 1;
+    bits -= 1;
+  }
+  return bits;
+}
+
+
+int main(int argc, char** argv)
+{
+  static bench_result results[BN_FN_COUNT];
+  static int counts[BN_FN_COUNT];
+  static group groups[BN_FN_COUNT];
+  int nresults = 0;
+  int i, j;
+
+  if (argc < 2)
+  {
+    printf("usage: %s trace [results.json]\n", argv[0]);
+    return 1;
+  }
+
+  /* The whole trace in memory */
+  FILE* f = fopen(argv[1], "rb");
+  if (f == NULL)
+  {
+    perror(argv[1]);
+    return 1;
+  }
+  fseek(f, 0, SEEK_END);
+  long size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  unsigned char* buf = (unsigned char*)malloc(size + 1);
+  if ((buf == NULL) || (fread(buf, 1, size, f) != (size_t)size))
+  {
+    fail("cannot read the trace");
+  }
+  fclose(f);
+
+  const long header = sizeof(BN_TRACE_MAGIC) - 1 + 1;
+  if ((size < header) || (memcmp(buf, BN_TRACE_MAGIC, header - 1) != 0))
+  {
+    fail("not a BN_TRACE file");
+  }
+
+  /* Count the records, then rebuild them */
+  long ncalls = 0;
+  long pos;
+  for (pos = header; pos < size; pos += read_u16(&buf[pos]))
+  {
+    if ((pos + BN_TRACE_RECORD > size) || (read_u16(&buf[pos]) < BN_TRACE_RECORD) || (pos + read_u16(&buf[pos]) > size))
+    {
+      fail("truncated record");
+    }
+    ncalls += 1;
+  }
+
+  call* calls = (call*)calloc(ncalls, sizeof(call));
+  double* bits = (double*)calloc(BN_FN_COUNT, sizeof(double));
+  long k = 0;
+  for (pos = header; pos < size; pos += read_u16(&buf[pos]), ++k)
+  {
+    const unsigned char* rec = &buf[pos];
+    const unsigned char* end = rec + read_u16(rec);
+    const unsigned char* p = rec + BN_TRACE_RECORD;
+    call* x = &calls[k];
+
+    x->fn = rec[2];
+    x->nops = rec[3];
+    x->arg = (int)(rec[4] | (rec[5] << 8) | (rec[6] << 16) | ((unsigned)rec[7] << 24));
+    if ((x->fn >= BN_FN_COUNT) || (min_operands(x->fn) == 0) || (x->nops < min_operands(x->fn)) || (x->nops > MAX_OPERANDS))
+    {
+      fail("unknown function or wrong number of operands, was the trace made by a different version?");
+    }
+    if ((x->fn == BN_FN_mul_low) || (x->fn == BN_FN_mul_high))
+    {
+      /* nlimbs was counted in limbs of the recording WORD_SIZE */
+      const int limit = (x->fn == BN_FN_mul_low) ? BN_ARRAY_SIZE : (2 * BN_ARRAY_SIZE);
+      x->arg = (int)(((long)x->arg * buf[header - 1]) / WORD_SIZE);
+      x->arg = (x->arg < 0) ? 0 : ((x->arg > limit) ? limit : x->arg);
+    }
+    for (j = 0; j < x->nops; ++j)
+    {
+      if ((p + 2 > end) || (p + 2 + read_u16(p) > end))
+      {
+        fail("operand runs past its record");
+      }
+      x->op[j] = load_operand(p + 2, read_u16(p));
+      p += 2 + read_u16(p);
+    }
+    if ((x->fn == BN_FN_to_mont) || (x->fn == BN_FN_from_mont) || (x->fn == BN_FN_mont_mul))
+    {
+      x->mont = (bn_mont_ctx*)malloc(sizeof(bn_mont_ctx));
+      bignum_mont_init(x->mont, x->op[0]);
+    }
+    if ((x->fn == BN_FN_barrett_reduce) || (x->fn == BN_FN_barrett_mulmod))
+    {
+      x->barrett = (bn_barrett_ctx*)malloc(sizeof(bn_barrett_ctx));
+      bignum_barrett_init(x->barrett, x->op[0]);
+    }
+    groups[x->fn].ncalls += 1;
+    bits[x->fn] += bit_length(x->op[0]);
+  }
+
+  for (i = 0; i < BN_FN_COUNT; ++i)
+  {
+    groups[i].calls = (call**)malloc((groups[i].ncalls + 1) * sizeof(call*));
+    groups[i].ncalls = 0;
+  }
+  for (k = 0; k < ncalls; ++k)
+  {
+    group* g = &groups[calls[k].fn];
+    g->calls[g->ncalls++] = &calls[k];
+  }
+
+  c = bignum_new();
+  d = bignum_new();
+
+  printf("\nReplay of %s: %ld calls, WORD_SIZE = %d (recorded with %d)\n\n", argv[1], ncalls, WORD_SIZE, buf[header - 1]);
+  printf("  %-16s %8s %6s %12s %12s %10s %7s\n", "function", "calls", "bits", "ns/call", "median", "stddev", "share");
+
+  /* Per function, then the share of the total each one accounts for */
+  double total = 0.0;
+  for (i = 0; i < BN_FN_COUNT; ++i)
+  {
+    const int n = groups[i].ncalls;
+    if (n == 0)
+    {
+      continue;
+    }
+    bench_result r = bench_measure(fn_names[i], (int)(bits[i] / n + 0.5), run_group, &groups[i]);
+    r.ns_per_op /= n;
+    r.median_ns /= n;
+    r.stddev_ns /= n;
+    r.ops_per_sec *= n;
+    for (j = 0; j < BENCH_NCOUNTERS; ++j)
+    {
+      if (r.counters[j] >= 0.0)
+      {
+        r.counters[j] /= n;
+      }
+    }
+    counts[nresults] = n;
+    results[nresults++] = r;
+    total += r.ns_per_op * n;
+  }
+  for (i = 0; i < nresults; ++i)
+  {
+    const bench_result* r = &results[i];
+    printf("  %-16s %8d %6d %12.1f %12.1f %10.1f %6.1f%%%s\n", r->name, counts[i], r->bits, r->ns_per_op, r->median_ns, r->stddev_ns,
+           100.0 * r->ns_per_op * counts[i] / total, (r->stable ? "" : "*"));
+  }
+
+  group all = { NULL, (int)ncalls };
+  all.calls = (call**)malloc((ncalls + 1) * sizeof(call*));
+  for (k = 0; k < ncalls; ++k)
+  {
+    all.calls[k] = &calls[k];
+  }
+  bench_result whole = bench_measure("(trace)", 0, run_group, &all);
+  printf("\n  whole trace in order: %.3f ms, %.0f calls/s\n\n", whole.median_ns * 1e-6, (ncalls * 1e9) / whole.median_ns);
+
+  if (argc > 2)
+  {
+    FILE* out = fopen(argv[2], "w");
+    if (out == NULL)
+    {
+      perror(argv[2]);
+      return 1;
+    }
+    bench_json_write(out, "replay", results, nresults);
+    fclose(out);
+  }
+
+  for (k = 0; k < ncalls; ++k)
+  {
+    for (j = 0; j < calls[k].nops; ++j)
+    {
+      bignum_free(calls[k].op[j]);
+    }
+    free(calls[k].mont);
+    free(calls[k].barrett);
+  }
+  for (i = 0; i < BN_FN_COUNT; ++i)
+  {
+    free(groups[i].calls);
+  }
+  free(all.calls);
+  free(calls);
+  free(bits);
+  free(buf);
+  bignum_free(c);
+  bignum_free(d);
+
+  return 0;
+}
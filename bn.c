@@ -21,15 +21,351 @@ There may well be room for performance-optimizations and improvements.
 #include <stdio.h>
 #include <stdbool.h>
 #include <assert.h>
+#include <pthread.h>
 #include "bn.h"
+#if defined(BN_PROFILE) || defined(BN_TRACE)
+#include <stdlib.h>
+#endif
+#if defined(BN_INSTRUMENT) || defined(BN_PROFILE)
+#include <string.h>
+#endif
+#ifdef BN_PROFILE
+#include <time.h>
+#endif
+
+
+
+/* Bookkeeping of the number of significant limbs. */
+static void _set_top(_TPtr<_T_bn> n, int top, int old_used);
+static int  _used_words(DTYPE* a, int n);
+
+/* Scratch memory handed to the _ws functions. */
+static DTYPE* _ws_limbs(bn_ws* ws, int nlimbs);
+
+/* Bulk refill of a pool free list, and the hand-back of all of them at thread exit. */
+static void _pool_refill(int cls);
+static void _pool_key_create(void);
+static void _pool_park(void* unused);
+
+/* Column accumulator for the multiplication kernels. */
+static void _mul_acc(DTYPE* acc, DTYPE x, DTYPE y);
+static void _mul_words(DTYPE* r, int nr, DTYPE* a, int na, DTYPE* b, int nb);
+static void _sqr_words(DTYPE* r, int nr, DTYPE* a, int na);
+static void _mul_high_words(DTYPE* r, int nr, DTYPE* a, int na, DTYPE* b, int nb, int lo);
+static int  _mul_part(DTYPE* r, int lo, int nr, DTYPE* a, int na, DTYPE* b, int nb, DTYPE* scratch);
+static int  _mul_bn(DTYPE** r, _TPtr<_T_bn> a, _TPtr<_T_bn> b, int lo, int nr, bn_ws* ws);
+
+/* Karatsuba and Toom-3 multiplication for operands of LONGMUL_CUTOFF limbs and more. */
+static void _mul_long(DTYPE* r, DTYPE* a, int na, DTYPE* b, int nb, DTYPE* scratch);
+static void _mul_equal(DTYPE* r, DTYPE* a, DTYPE* b, int n, DTYPE* scratch);
+static void _kara_words(DTYPE* r, DTYPE* a, DTYPE* b, int n, DTYPE* scratch);
+static void _toom3_words(DTYPE* r, DTYPE* a, DTYPE* b, int n, DTYPE* scratch);
+static int  _kara_diff(DTYPE* r, DTYPE* hi, int m, DTYPE* lo, int h);
+static DTYPE _add_into(DTYPE* r, int nr, DTYPE* a, int na);
+static DTYPE _sub_from(DTYPE* r, int nr, DTYPE* a, int na);
+static void _addmul_small(DTYPE* r, int nr, DTYPE* a, int na, DTYPE m);
+static void _divexact3(DTYPE* r, int n);
+static void _half_words(DTYPE* r, int n);
+
+/* Number-theoretic transform multiplication for operands of NTT_CUTOFF limbs and more. */
+static void _ntt_mul(DTYPE* r, DTYPE* a, int na, DTYPE* b, int nb, DTYPE* scratch);
+static int  _ntt_points(int na, int nb);
+static int  _ntt_nlimbs(int na, int nb);
+static void _ntt_load(uint32_t* x, int npoints, DTYPE* a, int na, uint32_t p);
+static void _ntt_twiddles(uint32_t* tw, int npoints, uint32_t p);
+static void _ntt_forward(uint32_t* x, int npoints, uint32_t* tw, uint32_t p);
+static void _ntt_inverse(uint32_t* x, int npoints, uint32_t* tw, uint32_t p);
+static void _ntt_dif(uint32_t* x, int n, int m, uint32_t* w, uint32_t p);
+static void _ntt_dit(uint32_t* x, int n, int m, uint32_t* w, uint32_t p);
+static uint32_t _ntt_mulw(uint32_t x, uint32_t w, uint32_t wq, uint32_t p);
+static uint32_t _ntt_shoup(uint32_t w, uint32_t p);
+static uint32_t _ntt_redc(uint64_t t, uint32_t p, uint32_t pinv);
+static uint32_t _ntt_pow(uint32_t x, uint32_t e, uint32_t p);
+
+/* Word-level division on plain limb arrays. */
+static int  _load_limbs(DTYPE* dst, _TPtr<_T_bn> src, int pad);
+static void _store_limbs(_TPtr<_T_bn> dst, DTYPE* src, int n);
+static int  _norm_shift(DTYPE* v, int n);
+static void _divmod_norm(DTYPE* q, DTYPE* u, int m, DTYPE* v, int n, int s);
+static void _divmod_words(DTYPE* q, DTYPE* u, int m, DTYPE* v, int n);
+static void _divmod(_TPtr<_T_bn> a, _TPtr<_T_bn> b, _TPtr<_T_bn> c, _TPtr<_T_bn> d, DTYPE* scratch);
+
+/* Modular exponentiation helpers. */
+static int  _test_bit(_TPtr<_T_bn> n, int bit);
+static void _mulmod_words(DTYPE* r, DTYPE* x, DTYPE* y, DTYPE* v, int n, int s, DTYPE* prod);
+
+/* Montgomery multiplication and Barrett reduction kernels. */
+static void _mont_mul_words(DTYPE* r, DTYPE* a, DTYPE* b, bn_mont_ctx* ctx);
+static void _barrett_reduce_words(DTYPE* x, int m, bn_barrett_ctx* ctx);
+static int  _cmp_words(DTYPE* a, DTYPE* b, int n);
+static DTYPE _sub_words(DTYPE* r, DTYPE* a, DTYPE* b, int n);
+
+/* Largest sliding window used by bignum_powmod -> table of 2^(POWMOD_MAX_WINDOW - 1) odd powers */
+#define POWMOD_MAX_WINDOW 6
+
+/*
+  Operands of at least KARATSUBA_CUTOFF limbs are multiplied by Karatsuba, of at
+  least TOOM3_CUTOFF limbs by Toom-3; smaller ones (and the base case of the
+  recursion) by _mul_words. Break-even points measured with bench/bench_mul_cutoff.c,
+  `make bench-karatsuba` and `make bench-toom3` to re-tune, `make bench-crossover`
+  shows which tier is fastest at each size.
+*/
+#ifndef KARATSUBA_CUTOFF
+  #if (WORD_SIZE == 2)
+    #define KARATSUBA_CUTOFF 32
+  #else
+    #define KARATSUBA_CUTOFF 24
+  #endif
+#endif
+#ifndef TOOM3_CUTOFF
+  #if (WORD_SIZE == 2)
+    #define TOOM3_CUTOFF 192
+  #elif (WORD_SIZE == 4)
+    #define TOOM3_CUTOFF 96
+  #else
+    #define TOOM3_CUTOFF 128
+  #endif
+#endif
+#if (TOOM3_CUTOFF < 5)
+  #error TOOM3_CUTOFF must be at least 5 limbs, so that each of the three parts gets one
+#endif
+#define LONGMUL_CUTOFF    ((KARATSUBA_CUTOFF < TOOM3_CUTOFF) ? KARATSUBA_CUTOFF : TOOM3_CUTOFF)
+
+/*
+  Short products -- only the low or the high limbs of a product, as bignum_mul,
+  bignum_mul_low and bignum_mul_high want them -- sum just the columns asked
+  for, about half the work of the full product. From SHORTMUL_CUTOFF limbs on
+  the full product by Karatsuba and up is cheaper than that, and the limbs are
+  cut from it. Measured with `make bench-shortmul`: the column sums win up to
+  64 limbs at WORD_SIZE 1 (four-limb accumulator) and up to 128 elsewhere.
+*/
+#ifndef SHORTMUL_CUTOFF
+  #if (WORD_SIZE == 1)
+    #define SHORTMUL_CUTOFF 96
+  #else
+    #define SHORTMUL_CUTOFF 192
+  #endif
+#endif
+
+/*
+  Limbs of the column accumulator of _mul_words and _mul_high_words: a column
+  of up to B limb products fits in three (B = 2^(8 * WORD_SIZE)), but at
+  WORD_SIZE 1 that is only 256 products, so it gets a fourth.
+*/
+#if (WORD_SIZE == 1)
+  #define MUL_ACC_NLIMBS 4
+#else
+  #define MUL_ACC_NLIMBS 3
+#endif
+
+/*
+  Columns below its lowest limb that _mul_high_words sums as guard: with g
+  guard limbs, the carry from the columns it skips changes the result only
+  about once in B^(g-1) / k products of k columns, and those are redone in full.
+*/
+#ifndef MULHIGH_GUARD
+  #if (WORD_SIZE == 1)
+    #define MULHIGH_GUARD 4
+  #elif (WORD_SIZE == 2)
+    #define MULHIGH_GUARD 3
+  #else
+    #define MULHIGH_GUARD 2
+  #endif
+#endif
+#if (MULHIGH_GUARD < 1)
+  #error MULHIGH_GUARD must be at least 1 limb
+#endif
+
+/*
+  Products of operands that both have NTT_CUTOFF limbs or more (and at least
+  LONGMUL_CUTOFF) are formed by number-theoretic transforms, see _ntt_mul.
+  The NTT costs the same at every WORD_SIZE, about 20 ms for two 2^20-bit
+  operands, while the other tiers get faster with wider limbs: it takes over
+  from 512 bits at WORD_SIZE 1, but only from 128 Kbit at WORD_SIZE 8.
+  Measured with `make bench-ntt`.
+*/
+#ifndef NTT_CUTOFF
+  #if (WORD_SIZE == 1)
+    #define NTT_CUTOFF 64
+  #elif (WORD_SIZE == 2)
+    #define NTT_CUTOFF 192
+  #elif (WORD_SIZE == 4)
+    #define NTT_CUTOFF 768
+  #else
+    #define NTT_CUTOFF 2048
+  #endif
+#endif
+#if (NTT_CUTOFF < 1)
+  #error NTT_CUTOFF must be at least 1 limb
+#endif
 
+/* Three primes c * 2^k + 1 below 2^30 with primitive root 3: the smallest k limits transforms to 2^23 points */
+static const uint32_t _ntt_primes[3] = { 998244353, 167772161, 469762049 };
+#define NTT_ROOT          3
+#define NTT_MAX_POINTS    (1 << 23)
+/* Points per block in the cache-blocked part of a transform: block and its twiddles stay in L1 */
+#define NTT_BLOCK         2048
 
+/*
+  Scratch of _mul_long for operands of up to BN_ARRAY_SIZE limbs: a padded operand and
+  a product (3n), then 6m + 1 limbs per Karatsuba level (m = ceil(n / 2)) or 12k + 12
+  per Toom-3 level (k = ceil(n / 3)) -> below 9n, plus a few limbs per level.
+  Nothing when numbers are too small to ever use it. An NTT of two n-limb
+  operands takes six 32-bit words per point, with at most n * WORD_SIZE + 2
+  points -> 24n limbs and change.
+*/
+#if (BN_ARRAY_SIZE >= NTT_CUTOFF) && (BN_ARRAY_SIZE >= LONGMUL_CUTOFF)
+  #define WS_LONGMUL_NLIMBS ((24 * BN_ARRAY_SIZE) + 512)
+#elif (BN_ARRAY_SIZE >= LONGMUL_CUTOFF)
+  #define WS_LONGMUL_NLIMBS ((9 * BN_ARRAY_SIZE) + 512)
+#else
+  #define WS_LONGMUL_NLIMBS 0
+#endif
+
+/* Scratch limbs needed by each _ws function -- powmod's table makes it the largest */
+#define WS_MUL_NLIMBS     ((4 * BN_ARRAY_SIZE) + WS_LONGMUL_NLIMBS)
+#define WS_DIVMOD_NLIMBS  ((3 * BN_ARRAY_SIZE) + 1)
+#define WS_POW_NLIMBS     (3 * BN_ARRAY_SIZE)
+#define WS_POWMOD_NLIMBS  ((((1 << (POWMOD_MAX_WINDOW - 1)) + 5) * BN_ARRAY_SIZE) + 2 + WS_LONGMUL_NLIMBS)
+#define WS_ISQRT_NLIMBS   (5 * BN_ARRAY_SIZE)
+
+/* Layout of a bignum_new() block: header, then the limbs at the next DTYPE boundary */
+#define BN_LIMB_OFFSET    (((sizeof(_T_bn) + sizeof(DTYPE) - 1) / sizeof(DTYPE)) * sizeof(DTYPE))
+#define BN_BLOCK_SIZE     (BN_LIMB_OFFSET + (BN_ARRAY_SIZE * sizeof(DTYPE)))
+
+/* Pool size classes: header, limb array and bignum_new() block, rounded up to BN_POOL_ALIGN */
+#define BN_POOL_ALIGN     16
+#define BN_POOL_ROUND(S)  ((((S) + BN_POOL_ALIGN - 1) / BN_POOL_ALIGN) * BN_POOL_ALIGN)
+#define BN_POOL_NCLASSES  3
+#define BN_POOL_LARGE     BN_POOL_NCLASSES         /* class of a request passed on to the sandbox heap */
+#define BN_POOL_FREE      (BN_POOL_NCLASSES + 1)   /* class of a slot sitting on a free list */
+#define BN_POOL_MAGIC     ((size_t)0x6b6e7562b16e756bULL)
+
+static const size_t _pool_class_size[BN_POOL_NCLASSES] =
+{
+  BN_POOL_ROUND(sizeof(_T_bn)),
+  BN_POOL_ROUND(BN_ARRAY_SIZE * sizeof(DTYPE)),
+  BN_POOL_ROUND(BN_BLOCK_SIZE + BN_CACHE_LINE - 1),
+};
+
+/* Prefix in front of every pool allocation */
+_Tainted typedef Tstruct bn_pool_slot
+{
+  _TPtr<Tstruct bn_pool_slot> next;  /* next free slot, while on a free list */
+  size_t tag;                        /* size class ^ BN_POOL_MAGIC ^ own address */
+}_T_bn_pool_slot;
+
+/* Tag of a slot in class cls -- applied to a stored tag it gives the class back, */
+/* and anything above BN_POOL_FREE for a pointer that never came from the pool.   */
+#define BN_POOL_TAG(slot, cls)  ((size_t)(cls) ^ BN_POOL_MAGIC ^ (size_t)(uintptr_t)(slot))
+
+#define BN_POOL_PREFIX    BN_POOL_ROUND(sizeof(_T_bn_pool_slot))
+
+/* Free lists and counters are per thread, so the pool needs no locking on the fast path. */
+/* An exiting thread parks its free lists on _pool_parked (see _pool_park), and the next  */
+/* refill on any thread takes them from there before it goes to the sandbox heap.        */
+static __thread _TPtr<_T_bn_pool_slot> _pool_free[BN_POOL_NCLASSES];
+static __thread bn_pool_stats _pool_stats;
+static _TPtr<_T_bn_pool_slot> _pool_parked[BN_POOL_NCLASSES];
+static pthread_mutex_t _pool_parked_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t _pool_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t _pool_key;
+
+/* Every public function opens with BN_ENTER and leaves through BN_LEAVE -> no code without */
+/* BN_INSTRUMENT, BN_PROFILE or BN_TRACE                                                    */
+#if defined(BN_INSTRUMENT) || defined(BN_PROFILE)
+#define BN_FN_NAME(name) "bignum_" #name,
+static const char* const _fn_names[BN_FN_COUNT] = { "(outside)", BN_FUNCTIONS(BN_FN_NAME) };
+#undef BN_FN_NAME
+#endif
+
+#ifdef BN_INSTRUMENT
+static void _instr_enter(int fn);
+static void _instr_leave(void);
+
+static __thread bn_instr_snapshot _instr;
+static __thread int _instr_fn = BN_FN_OUTSIDE;   /* outermost public function running */
+static __thread int _instr_depth = 0;            /* number of public functions on the stack */
+
+static const char* const _instr_counter_names[BN_INSTR_NCOUNTERS] = { "malloc", "free", "bytes", "memset", "sprintf", "w2c" };
+
+  #define BN_INSTR_ENTER(fn)  _instr_enter(fn)
+  #define BN_INSTR_LEAVE()    _instr_leave()
+#else
+  #define BN_INSTR_ENTER(fn)
+  #define BN_INSTR_LEAVE()
+#endif
+
+#ifdef BN_PROFILE
+/* Nesting deeper than this is still timed as part of its caller, but not on its own */
+#define BN_PROF_MAX_DEPTH 16
 
-/* Functions for shifting number in-place. */
-static void _lshift_one_bit(_TPtr<_T_bn> a);
-static void _rshift_one_bit(_TPtr<_T_bn> a);
-static void _lshift_word(_TPtr<_T_bn> a, int nwords);
-static void _rshift_word(_TPtr<_T_bn> a, int nwords);
+static uint64_t _prof_now(void);
+static void _prof_enter(int fn);
+static void _prof_leave(void);
+static bn_prof_table* _prof_table(void);
+
+/* Each thread's table is linked into a list on first use and never freed, so merging */
+/* still sees it after the thread has exited                                          */
+typedef struct bn_prof_thread
+{
+  bn_prof_table table;
+  struct bn_prof_thread* next;
+} bn_prof_thread;
+
+static bn_prof_thread* _prof_threads = NULL;
+static __thread bn_prof_thread* _prof_mine = NULL;
+
+/* Open calls on this thread: which function, when the hook was entered and when the body */
+/* started, and the cycles spent in nested calls including their hooks                  */
+static __thread struct { int fn; uint64_t entered; uint64_t start; uint64_t nested; } _prof_stack[BN_PROF_MAX_DEPTH];
+static __thread int _prof_depth = 0;
+
+  #define BN_PROF_ENTER(fn)   _prof_enter(fn)
+  #define BN_PROF_LEAVE()     _prof_leave()
+#else
+  #define BN_PROF_ENTER(fn)
+  #define BN_PROF_LEAVE()
+#endif
+
+#ifdef BN_TRACE
+/* Largest record: the header and three operands of BN_ARRAY_SIZE limbs */
+#define BN_TRACE_MAX_RECORD (BN_TRACE_RECORD + (3 * (2 + (BN_ARRAY_SIZE * WORD_SIZE))))
+#if (BN_TRACE_SIZE < BN_TRACE_MAX_RECORD)
+  #error BN_TRACE_SIZE must hold at least one record of three full-size operands
+#endif
+
+static void _trace_record(int fn, int arg, DTYPE* mod, int nmod, _TPtr<_T_bn> x, _TPtr<_T_bn> y, _TPtr<_T_bn> z);
+static int  _trace_put_words(unsigned char* rec, int pos, DTYPE* w, int n);
+static void _trace_append(unsigned char* rec, int size);
+static int  _trace_size(int pos);
+
+/* Ring buffer of this thread, allocated on first use. Records live in [tail, head), or */
+/* in [tail, end) and [0, head) once head has wrapped around to the start               */
+static __thread unsigned char* _trace_buf = NULL;
+static __thread int _trace_head = 0;
+static __thread int _trace_tail = 0;
+static __thread int _trace_end = 0;
+static __thread int _trace_wrapped = 0;
+static __thread unsigned long _trace_count = 0;
+static __thread unsigned long _trace_dropped = 0;
+static __thread int _trace_depth = 0;          /* number of public functions on the stack */
+
+  /* Only the outermost call is recorded: the one the application made */
+  #define BN_TRACE_ENTER()                     _trace_depth += 1
+  #define BN_TRACE_LEAVE()                     _trace_depth -= 1
+  #define BN_TRACE_CALL(fn, arg, x, y, z)      if (_trace_depth == 1) { _trace_record(BN_FN_##fn, (arg), NULL, 0, (x), (y), (z)); }
+  #define BN_TRACE_CALL_CTX(fn, ctx, x, y, z)  if ((_trace_depth == 1) && (ctx)) { _trace_record(BN_FN_##fn, 0, (ctx)->n, (ctx)->nlimbs, (x), (y), (z)); }
+#else
+  #define BN_TRACE_ENTER()
+  #define BN_TRACE_LEAVE()
+  #define BN_TRACE_CALL(fn, arg, x, y, z)
+  #define BN_TRACE_CALL_CTX(fn, ctx, x, y, z)
+#endif
+
+/* Profiling is innermost, so it times as little of the instrumentation as possible */
+#define BN_ENTER(name)  BN_TRACE_ENTER(); BN_INSTR_ENTER(BN_FN_##name); BN_PROF_ENTER(BN_FN_##name)
+#define BN_LEAVE()      BN_PROF_LEAVE(); BN_INSTR_LEAVE(); BN_TRACE_LEAVE()
 
 #ifdef WASM_SBX
 typedef _Decoy Tstruct Spl_bn
@@ -51,9 +387,10 @@ Spl_T_bn Dummy_bn(void){
 /* Public / Exported functions. */
 void bignum_init(_TPtr<_T_bn> n)
 {
+  BN_ENTER(init);
 #ifndef NOOP_SBX
     if (n == NULL) {
-        n = (_TPtr<_T_bn>)__malloc__(sizeof(_T_bn));
+        n = (_TPtr<_T_bn>)__bn_malloc__(sizeof(_T_bn));
         t_memset(n, 0, sizeof(_T_bn));
     }
 #else
@@ -70,7 +407,7 @@ void bignum_init(_TPtr<_T_bn> n)
   //hence check for null before you init
 #ifndef NOOP_SBX
   if (n->array == NULL)
-    n->array = (_TPtr<DTYPE>)__malloc__(BN_ARRAY_SIZE * sizeof(DTYPE));
+    n->array = (_TPtr<DTYPE>)__bn_malloc__(BN_ARRAY_SIZE * sizeof(DTYPE));
 #else
     if (n->array == NULL) {
         _T_bn simple[BN_ARRAY_SIZE];
@@ -80,16 +417,388 @@ void bignum_init(_TPtr<_T_bn> n)
 #pragma TAINTED_SCOPE pop
     }
 #endif
+  /* Every limb: used may be garbage in a header the caller set up itself */
   int i;
   for (i = 0; i < BN_ARRAY_SIZE; ++i)
   {
     n->array[i] = 0;
   }
+  n->used = 0;
+  BN_LEAVE();
+}
+
+
+void bignum_normalize(_TPtr<_T_bn> n)
+{
+  BN_ENTER(normalize);
+  require(n, "n is null");
+
+  /* For callers that write n->array directly: recompute used from scratch */
+  _set_top(n, BN_ARRAY_SIZE, 0);
+  BN_LEAVE();
+}
+
+
+_TPtr<_T_bn> bignum_new(void)
+{
+  /*
+    Header and limbs share one allocation, so a bignum costs a single call to
+    the allocator and its limbs sit right behind the header instead of somewhere
+    else on the heap. __bn_malloc__ only promises 8 or 16 byte alignment, so the
+    block is over-allocated and the header placed on the next cache-line boundary.
+  */
+  BN_ENTER(new);
+  _TPtr<char> block = (_TPtr<char>)__bn_malloc__(BN_BLOCK_SIZE + BN_CACHE_LINE - 1);
+  require(block, "out of memory");
+
+  const size_t pad = (BN_CACHE_LINE - ((uintptr_t)block % BN_CACHE_LINE)) % BN_CACHE_LINE;
+  _TPtr<_T_bn> n = (_TPtr<_T_bn>)(block + pad);
+  n->array = (_TPtr<DTYPE>)(block + pad + BN_LIMB_OFFSET);
+  n->block = block;
+  bignum_init(n);
+
+  BN_LEAVE();
+  return n;
+}
+
+
+void bignum_free(_TPtr<_T_bn> n)
+{
+  BN_ENTER(free);
+  if (n == NULL)
+  {
+    BN_LEAVE();
+    return;
+  }
+
+  if (n->block != NULL)
+  {
+    /* Header lives inside the block -> nothing to touch afterwards */
+    __bn_free__(n->block);
+  }
+  else
+  {
+    /* Header from __bn_malloc__, limbs from bignum_init (on the stack with NOOP_SBX) */
+#ifndef NOOP_SBX
+    __bn_free__(n->array);
+#endif
+    __bn_free__(n);
+  }
+  BN_LEAVE();
+}
+
+
+_TPtr<void> bignum_pool_malloc(size_t size)
+{
+  /*
+    Bignum allocations come in a few fixed sizes, so each size class keeps a
+    LIFO free list per thread: a hit is a single pointer pop, and an empty list
+    is refilled with BN_POOL_REFILL slots from one call to the sandbox heap.
+    Slots are never returned to the heap, but the free lists of a thread that
+    exits are parked for the other threads to reuse. Every allocation is
+    preceded by a prefix tagged with its class, so bignum_pool_free() needs no
+    size and catches double frees.
+  */
+  int cls = 0;
+  while ((cls < BN_POOL_NCLASSES) && (size > _pool_class_size[cls]))
+  {
+    cls += 1;
+  }
+
+  _TPtr<_T_bn_pool_slot> slot = NULL;
+  if (cls == BN_POOL_LARGE)
+  {
+    slot = (_TPtr<_T_bn_pool_slot>)__sbx_malloc__(BN_POOL_PREFIX + size);
+    require(slot, "out of memory");
+    _pool_stats.large += 1;
+  }
+  else
+  {
+    if (_pool_free[cls] == NULL)
+    {
+      _pool_refill(cls);
+    }
+    else
+    {
+      _pool_stats.hits += 1;
+    }
+    slot = _pool_free[cls];
+    _pool_free[cls] = slot->next;
+
+    _pool_stats.in_use += 1;
+    if (_pool_stats.in_use > _pool_stats.high_water)
+    {
+      _pool_stats.high_water = _pool_stats.in_use;
+    }
+  }
+  slot->tag = BN_POOL_TAG(slot, cls);
+
+  return (_TPtr<void>)((_TPtr<char>)slot + BN_POOL_PREFIX);
+}
+
+
+void bignum_pool_free(_TPtr<void> p)
+{
+  if (p == NULL)
+  {
+    return;
+  }
+
+  _TPtr<_T_bn_pool_slot> slot = (_TPtr<_T_bn_pool_slot>)((_TPtr<char>)p - BN_POOL_PREFIX);
+  const size_t cls = BN_POOL_TAG(slot, slot->tag);
+  require((cls != BN_POOL_FREE), "p was freed twice");
+  require((cls < BN_POOL_FREE), "p is not from bignum_pool_malloc");
+  if (cls == BN_POOL_LARGE)
+  {
+    __sbx_free__(slot);
+  }
+  else
+  {
+    /* Goes onto this thread's list, whichever thread allocated it */
+    slot->tag = BN_POOL_TAG(slot, BN_POOL_FREE);
+    slot->next = _pool_free[cls];
+    _pool_free[cls] = slot;
+    _pool_stats.in_use -= 1;
+  }
+}
+
+
+void bignum_pool_stats(bn_pool_stats* stats)
+{
+  require(stats, "stats is null");
+
+  *stats = _pool_stats;
+}
+
+
+#ifdef BN_INSTRUMENT
+void bignum_instr_count(int counter, size_t bytes)
+{
+  require((counter >= 0) && (counter < BN_INSTR_NCOUNTERS), "no such counter");
+
+  _instr.count[_instr_fn][counter] += 1;
+  _instr.count[_instr_fn][BN_INSTR_BYTES] += bytes;
+}
+
+
+void bignum_instr_snapshot(bn_instr_snapshot* snap)
+{
+  require(snap, "snap is null");
+
+  *snap = _instr;
+}
+
+
+void bignum_instr_reset(void)
+{
+  memset(&_instr, 0, sizeof(_instr));
+}
+
+
+const char* bignum_instr_name(int fn)
+{
+  require((fn >= 0) && (fn < BN_FN_COUNT), "no such function");
+
+  return _fn_names[fn];
+}
+
+
+void bignum_instr_dump(FILE* out)
+{
+  /*
+    One JSON object: the build it came from and one entry per function that was
+    called or charged anything, e.g.
+    { "word_size": 4, "sandbox": "HEAP_SBX", "pool": true, "functions": [
+      { "name": "bignum_new", "calls": 2, "malloc": 2, "free": 0, "bytes": 448, ... } ] }
+  */
+  require(out, "out is null");
+
+#if defined(WASM_SBX)
+  const char* sandbox = "WASM_SBX";
+#elif defined(HEAP_SBX)
+  const char* sandbox = "HEAP_SBX";
+#elif defined(NOOP_SBX)
+  const char* sandbox = "NOOP_SBX";
+#else
+  const char* sandbox = "none";
+#endif
+#ifdef BN_POOL
+  const char* pool = "true";
+#else
+  const char* pool = "false";
+#endif
+
+  fprintf(out, "{ \"word_size\": %d, \"sandbox\": \"%s\", \"pool\": %s, \"functions\": [", WORD_SIZE, sandbox, pool);
+  const char* sep = "";
+  int fn, c;
+  for (fn = 0; fn < BN_FN_COUNT; ++fn)
+  {
+    unsigned long any = _instr.calls[fn];
+    for (c = 0; c < BN_INSTR_NCOUNTERS; ++c)
+    {
+      any |= _instr.count[fn][c];
+    }
+    if (any == 0)
+    {
+      continue;
+    }
+
+    fprintf(out, "%s\n  { \"name\": \"%s\", \"calls\": %lu", sep, _fn_names[fn], _instr.calls[fn]);
+    for (c = 0; c < BN_INSTR_NCOUNTERS; ++c)
+    {
+      fprintf(out, ", \"%s\": %lu", _instr_counter_names[c], _instr.count[fn][c]);
+    }
+    fprintf(out, " }");
+    sep = ",";
+  }
+  fprintf(out, "\n] }\n");
+}
+#endif /* BN_INSTRUMENT */
+
+
+#ifdef BN_PROFILE
+void bignum_prof_merge(bn_prof_table* out)
+{
+  require(out, "out is null");
+
+  memset(out, 0, sizeof(*out));
+
+  bn_prof_thread* t;
+  for (t = __atomic_load_n(&_prof_threads, __ATOMIC_ACQUIRE); t != NULL; t = t->next)
+  {
+    int fn, i;
+    for (fn = 0; fn < BN_FN_COUNT; ++fn)
+    {
+      const bn_prof_entry* e = &t->table.fn[fn];
+      out->fn[fn].calls += e->calls;
+      out->fn[fn].cycles += e->cycles;
+      out->fn[fn].self_cycles += e->self_cycles;
+      for (i = 0; i < BN_PROF_NBUCKETS; ++i)
+      {
+        out->fn[fn].hist[i] += e->hist[i];
+      }
+    }
+  }
+}
+
+
+void bignum_prof_reset(void)
+{
+  bn_prof_thread* t;
+  for (t = __atomic_load_n(&_prof_threads, __ATOMIC_ACQUIRE); t != NULL; t = t->next)
+  {
+    memset(&t->table, 0, sizeof(t->table));
+  }
+}
+
+
+void bignum_prof_dump(FILE* out, const bn_prof_table* t)
+{
+  /*
+    One line per function that was called, most self cycles first. p50 and p99
+    are histogram buckets: the call took between that many cycles and twice as
+    many. Self cycles add up to the total time spent inside the library.
+  */
+  require(out, "out is null");
+  require(t, "t is null");
+
+  int order[BN_FN_COUNT];
+  int n = 0;
+  unsigned long long total = 0;
+  int fn, i, j;
+
+  for (fn = 0; fn < BN_FN_COUNT; ++fn)
+  {
+    if (t->fn[fn].calls != 0)
+    {
+      /* Insertion sort on self cycles, descending */
+      for (i = n; (i > 0) && (t->fn[order[i - 1]].self_cycles < t->fn[fn].self_cycles); --i)
+      {
+        order[i] = order[i - 1];
+      }
+      order[i] = fn;
+      n += 1;
+      total += t->fn[fn].self_cycles;
+    }
+  }
+
+  fprintf(out, "  %-24s %10s %14s %14s %7s %12s %10s %10s\n", "function", "calls", "cycles", "self cycles", "self", "cycles/call", "p50", "p99");
+  for (i = 0; i < n; ++i)
+  {
+    const bn_prof_entry* e = &t->fn[order[i]];
+    unsigned long long seen = 0;
+    int p50 = -1;
+    int p99 = -1;
+    for (j = 0; j < BN_PROF_NBUCKETS; ++j)
+    {
+      seen += e->hist[j];
+      if ((p50 < 0) && ((2 * seen) >= e->calls))
+      {
+        p50 = j;
+      }
+      if ((p99 < 0) && ((100 * seen) >= (99 * e->calls)))
+      {
+        p99 = j;
+      }
+    }
+    fprintf(out, "  %-24s %10llu %14llu %14llu %6.1f%% %12.0f %10llu %10llu\n",
+            _fn_names[order[i]], e->calls, e->cycles, e->self_cycles,
+            ((total != 0) ? ((100.0 * e->self_cycles) / total) : 0.0),
+            ((double)e->cycles / e->calls), (1ULL << p50), (1ULL << p99));
+  }
+}
+#endif /* BN_PROFILE */
+
+
+#ifdef BN_TRACE
+void bignum_trace_reset(void)
+{
+  _trace_head = 0;
+  _trace_tail = 0;
+  _trace_end = 0;
+  _trace_wrapped = 0;
+  _trace_count = 0;
+  _trace_dropped = 0;
+}
+
+
+unsigned long bignum_trace_count(void)
+{
+  return _trace_count;
+}
+
+
+unsigned long bignum_trace_dropped(void)
+{
+  return _trace_dropped;
+}
+
+
+unsigned long bignum_trace_dump(FILE* out)
+{
+  require(out, "out is null");
+
+  const unsigned char word_size = WORD_SIZE;
+  fwrite(BN_TRACE_MAGIC, 1, sizeof(BN_TRACE_MAGIC) - 1, out);
+  fwrite(&word_size, 1, 1, out);
+
+  if (_trace_wrapped)
+  {
+    fwrite(&_trace_buf[_trace_tail], 1, _trace_end - _trace_tail, out);
+    fwrite(&_trace_buf[0], 1, _trace_head, out);
+  }
+  else if (_trace_buf != NULL)
+  {
+    fwrite(&_trace_buf[_trace_tail], 1, _trace_head - _trace_tail, out);
+  }
+  return _trace_count;
 }
+#endif /* BN_TRACE */
 
 
 void bignum_from_int(_TPtr<_T_bn> n, DTYPE_TMP i)
 {
+  BN_ENTER(from_int);
   require(n, "n is null");
 
   bignum_init(n);
@@ -109,13 +818,21 @@ void bignum_from_int(_TPtr<_T_bn> n, DTYPE_TMP i)
   DTYPE_TMP num_32 = 32;
   DTYPE_TMP tmp = i >> num_32; /* bit-shift with U64 operands to force 64-bit results */
   n->array[1] = tmp;
+ #elif (WORD_SIZE == 8)
+  n->array[0] = (DTYPE)i;
+  n->array[1] = (DTYPE)(i >> 64);
  #endif
 #endif
+
+  /* i spans at most sizeof(DTYPE_TMP) / WORD_SIZE limbs */
+  _set_top(n, (int)(sizeof(DTYPE_TMP) / WORD_SIZE), 0);
+  BN_LEAVE();
 }
 
 
 int bignum_to_int(_TPtr<_T_bn> n)
 {
+  BN_ENTER(to_int);
   require(n, "n is null");
 
   int ret = 0;
@@ -131,14 +848,18 @@ int bignum_to_int(_TPtr<_T_bn> n)
   ret += n->array[1] << 16;
 #elif (WORD_SIZE == 4)
   ret += n->array[0];
+#elif (WORD_SIZE == 8)
+  ret += (int)n->array[0];
 #endif
 
+  BN_LEAVE();
   return ret;
 }
 
 
 void bignum_from_string(_TPtr<_T_bn> n, char* str, int nbytes)
 {
+  BN_ENTER(from_string);
   require(n, "n is null");
   require(str, "str is null");
   require(nbytes > 0, "nbytes must be positive");
@@ -161,12 +882,15 @@ void bignum_from_string(_TPtr<_T_bn> n, char* str, int nbytes)
     i -= (2 * WORD_SIZE); /* step WORD_SIZE hex-byte(s) back in the string. */
     j += 1;               /* step one element forward in the array. */
   }
+  _set_top(n, j, 0);
+  BN_LEAVE();
 }
 
 //we're finna gon move this to the sandbox
 
 _Tainted void bignum_to_string(_TPtr<_T_bn> n, _TPtr<char> str, int nbytes)
 {
+  BN_ENTER(to_string);
 #ifdef WASM_SBX
     w2c_bignum_to_string(c_fetch_sandbox_address(), (int)n, (int)str, nbytes);
 #else
@@ -198,15 +922,19 @@ _Tainted void bignum_to_string(_TPtr<_T_bn> n, _TPtr<char> str, int nbytes)
     /* Zero-terminate string */
     str[i] = 0;
 #endif
+  BN_LEAVE();
 }
 
 
 void bignum_dec(_TPtr<_T_bn> n)
 {
+  BN_ENTER(dec);
   require(n, "n is null");
+  BN_TRACE_CALL(dec, 0, n, NULL, NULL);
 
   DTYPE tmp; /* copy of n */
   DTYPE res;
+  const int used = n->used;
 
   int i;
   for (i = 0; i < BN_ARRAY_SIZE; ++i)
@@ -220,15 +948,23 @@ void bignum_dec(_TPtr<_T_bn> n)
       break;
     }
   }
+
+  /* Decrementing 0 borrows through every limb and wraps around */
+  int top = (i < BN_ARRAY_SIZE) ? (i + 1) : BN_ARRAY_SIZE;
+  _set_top(n, (top > used) ? top : used, used);
+  BN_LEAVE();
 }
 
 
 void bignum_inc(_TPtr<_T_bn> n)
 {
+  BN_ENTER(inc);
   require(n, "n is null");
+  BN_TRACE_CALL(inc, 0, n, NULL, NULL);
 
   DTYPE res;
   DTYPE_TMP tmp; /* copy of n */
+  const int used = n->used;
 
   int i;
   for (i = 0; i < BN_ARRAY_SIZE; ++i)
@@ -242,39 +978,59 @@ void bignum_inc(_TPtr<_T_bn> n)
       break;
     }
   }
+
+  /* The carry may reach one limb past the top, or wrap the number around to 0 */
+  int top = (i < BN_ARRAY_SIZE) ? (i + 1) : BN_ARRAY_SIZE;
+  _set_top(n, (top > used) ? top : used, used);
+  BN_LEAVE();
 }
 
 
 void bignum_add(_TPtr<_T_bn> a, _TPtr<_T_bn> b, _TPtr<_T_bn> c)
 {
+  BN_ENTER(add);
   require(a, "a is null");
   require(b, "b is null");
   require(c, "c is null");
+  BN_TRACE_CALL(add, 0, a, b, NULL);
 
   DTYPE_TMP tmp;
   int carry = 0;
+  const int old_used = c->used;
+  int top = (a->used > b->used) ? a->used : b->used;
   int i;
-  for (i = 0; i < BN_ARRAY_SIZE; ++i)
+  for (i = 0; i < top; ++i)
   {
     tmp = (DTYPE_TMP)a->array[i] + b->array[i] + carry;
     carry = (tmp > MAX_VAL);
     c->array[i] = (tmp & MAX_VAL);
   }
+  if (carry && (top < BN_ARRAY_SIZE))
+  {
+    c->array[top] = 1;
+    top += 1;
+  }
+  _set_top(c, top, old_used);
+  BN_LEAVE();
 }
 
 
 void bignum_sub(_TPtr<_T_bn> a, _TPtr<_T_bn> b, _TPtr<_T_bn> c)
 {
+  BN_ENTER(sub);
   require(a, "a is null");
   require(b, "b is null");
   require(c, "c is null");
+  BN_TRACE_CALL(sub, 0, a, b, NULL);
 
   DTYPE_TMP res;
   DTYPE_TMP tmp1;
   DTYPE_TMP tmp2;
   int borrow = 0;
+  const int old_used = c->used;
+  int top = (a->used > b->used) ? a->used : b->used;
   int i;
-  for (i = 0; i < BN_ARRAY_SIZE; ++i)
+  for (i = 0; i < top; ++i)
   {
     tmp1 = (DTYPE_TMP)a->array[i] + (MAX_VAL + 1); /* + number_base */
     tmp2 = (DTYPE_TMP)b->array[i] + borrow;;
@@ -282,581 +1038,2889 @@ void bignum_sub(_TPtr<_T_bn> a, _TPtr<_T_bn> b, _TPtr<_T_bn> c)
     c->array[i] = (DTYPE)(res & MAX_VAL); /* "modulo number_base" == "% (number_base - 1)" if number_base is 2^N */
     borrow = (res <= MAX_VAL);
   }
+  if (borrow)
+  {
+    /* a < b: the borrow runs through all the zero limbs above -> result wraps around */
+    for (; i < BN_ARRAY_SIZE; ++i)
+    {
+      c->array[i] = (DTYPE)MAX_VAL;
+    }
+    top = BN_ARRAY_SIZE;
+  }
+  _set_top(c, top, old_used);
+  BN_LEAVE();
 }
 
 
 void bignum_mul(_TPtr<_T_bn> a, _TPtr<_T_bn> b, _TPtr<_T_bn> c)
 {
+  BN_ENTER(mul);
   require(a, "a is null");
   require(b, "b is null");
   require(c, "c is null");
+  BN_TRACE_CALL(mul, 0, a, b, NULL);
+  DTYPE scratch[WS_MUL_NLIMBS];
+  bn_ws ws = { scratch, sizeof(scratch) };
+  bignum_mul_ws(a, b, c, &ws);
+  BN_LEAVE();
+}
 
-  _TPtr<_T_bn> row = NULL; //moving from static memory to heap --> SLOW!
-  _TPtr<_T_bn> tmp = NULL;
-#ifndef NOOP_SBX
-  row = (_TPtr<_T_bn>)__malloc__(sizeof(_T_bn));
-  tmp = (_TPtr<_T_bn>)__malloc__(sizeof(_T_bn));
-  //memset these both to 0
-  t_memset(row, 0, sizeof(_T_bn));
-  t_memset(tmp, 0, sizeof(_T_bn));
-#else
-  _T_bn _c_row;
-  _T_bn _C_tmp;
-  _T_bn _C_row_array[BN_ARRAY_SIZE];
-  _T_bn _C_tmp_array[BN_ARRAY_SIZE];
-#pragma TAINTED_SCOPE push
-#pragma TAINTED_SCOPE on
-  row = (_TPtr<_T_bn>)&_c_row;
-  tmp = (_TPtr<_T_bn>)&_C_tmp;
-    row->array = (_TPtr<DTYPE>)&_C_row_array;
-    tmp->array = (_TPtr<DTYPE>)&_C_tmp_array;
-#pragma TAINTED_SCOPE pop
-#endif
-  int i, j;
 
-  bignum_init(c);
+void bignum_mul_ws(_TPtr<_T_bn> a, _TPtr<_T_bn> b, _TPtr<_T_bn> c, bn_ws* ws)
+{
+  /*
+    Column-wise (Comba) multiplication, see _mul_words:
 
-  for (i = 0; i < BN_ARRAY_SIZE; ++i)
-  {
-    bignum_init(row);
+    c[k] = sum(a[i] * b[k - i]) for i in 0..k, plus the carry out of column k - 1.
 
-    for (j = 0; j < BN_ARRAY_SIZE; ++j)
-    {
-      if (i + j < BN_ARRAY_SIZE)
-      {
-        bignum_init(tmp);
-        DTYPE_TMP intermediate = ((DTYPE_TMP)a->array[i] * (DTYPE_TMP)b->array[j]);
-        bignum_from_int(tmp, intermediate);
-        _lshift_word(tmp, i + j);
-        bignum_add(tmp, row, row);
-      }
-    }
-    bignum_add(c, row, c);
-  }
-#ifndef NOOP_SBX
-  __free__(row->array);
-  __free__(tmp->array);
-  __free__(row);
-  __free__(tmp);
-#endif
+    Only the significant limbs of a and b take part, and columns at or above
+    BN_ARRAY_SIZE are never computed -> result is truncated, the low half of
+    bignum_mul_full. When both operands have LONGMUL_CUTOFF limbs or more and
+    the product fits, it is formed by Karatsuba, Toom-3 or the NTT instead
+    (see _mul_long); truncated products only from SHORTMUL_CUTOFF limbs on,
+    see _mul_part. The operands are copied into the workspace first, so c may
+    alias a or b.
+  */
+  BN_ENTER(mul_ws);
+  require(a, "a is null");
+  require(b, "b is null");
+  require(c, "c is null");
+  BN_TRACE_CALL(mul, 0, a, b, NULL);
+
+  DTYPE* r;
+  int nr = _mul_bn(&r, a, b, 0, BN_ARRAY_SIZE, ws);
+  _store_limbs(c, r, nr);
+  BN_LEAVE();
 }
 
 
-void bignum_div(_TPtr<_T_bn> a, _TPtr<_T_bn> b, _TPtr<_T_bn> c)
+void bignum_sqr(_TPtr<_T_bn> a, _TPtr<_T_bn> b)
+{
+  BN_ENTER(sqr);
+  require(a, "a is null");
+  require(b, "b is null");
+  BN_TRACE_CALL(sqr, 0, a, NULL, NULL);
+  DTYPE scratch[WS_MUL_NLIMBS];
+  bn_ws ws = { scratch, sizeof(scratch) };
+  bignum_sqr_ws(a, b, &ws);
+  BN_LEAVE();
+}
+
+
+void bignum_sqr_ws(_TPtr<_T_bn> a, _TPtr<_T_bn> b, bn_ws* ws)
+{
+  /*
+    b = a * a, truncated to BN_ARRAY_SIZE limbs like bignum_mul. Of the na^2
+    limb products a square needs only the na * (na + 1) / 2 distinct ones:
+    each a[i] * a[j] with i < j is formed once and doubled, then the diagonal
+    a[i]^2 is added (see _sqr_words). Karatsuba, Toom-3 and the NTT have
+    their own squaring paths, taken from LONGMUL_CUTOFF limbs on.
+    Same workspace as bignum_mul_ws, and b may alias a.
+  */
+  BN_ENTER(sqr_ws);
+  require(a, "a is null");
+  require(b, "b is null");
+  BN_TRACE_CALL(sqr, 0, a, NULL, NULL);
+
+  DTYPE* r;
+  int nr = _mul_bn(&r, a, a, 0, BN_ARRAY_SIZE, ws);
+  _store_limbs(b, r, nr);
+  BN_LEAVE();
+}
+
+
+void bignum_mul_full(_TPtr<_T_bn> a, _TPtr<_T_bn> b, _TPtr<_T_bn> lo, _TPtr<_T_bn> hi)
+{
+  BN_ENTER(mul_full);
+  require(a, "a is null");
+  require(b, "b is null");
+  require(lo, "lo is null");
+  require(hi, "hi is null");
+  BN_TRACE_CALL(mul_full, 0, a, b, NULL);
+  DTYPE scratch[WS_MUL_NLIMBS];
+  bn_ws ws = { scratch, sizeof(scratch) };
+  bignum_mul_full_ws(a, b, lo, hi, &ws);
+  BN_LEAVE();
+}
+
+
+void bignum_mul_full_ws(_TPtr<_T_bn> a, _TPtr<_T_bn> b, _TPtr<_T_bn> lo, _TPtr<_T_bn> hi, bn_ws* ws)
+{
+  /*
+    (hi:lo) = a * b with nothing dropped: lo gets the low BN_ARRAY_SIZE limbs of
+    the product, hi the ones above -- the pair bignum_barrett_reduce takes, so
+    a product can be reduced without bignums of twice the width.
+    lo and hi must be different bignums; either may alias a or b.
+  */
+  BN_ENTER(mul_full_ws);
+  require(a, "a is null");
+  require(b, "b is null");
+  require(lo, "lo is null");
+  require(hi, "hi is null");
+  require(lo != hi, "lo and hi are the same bignum");
+  BN_TRACE_CALL(mul_full, 0, a, b, NULL);
+
+  DTYPE* r;
+  int nr = _mul_bn(&r, a, b, 0, 2 * BN_ARRAY_SIZE, ws);
+  _store_limbs(lo, r, (nr < BN_ARRAY_SIZE) ? nr : BN_ARRAY_SIZE);
+  _store_limbs(hi, r + BN_ARRAY_SIZE, (nr > BN_ARRAY_SIZE) ? (nr - BN_ARRAY_SIZE) : 0);
+  BN_LEAVE();
+}
+
+
+void bignum_mul_low(_TPtr<_T_bn> a, _TPtr<_T_bn> b, _TPtr<_T_bn> c, int nlimbs)
 {
+  BN_ENTER(mul_low);
   require(a, "a is null");
   require(b, "b is null");
   require(c, "c is null");
+  BN_TRACE_CALL(mul_low, nlimbs, a, b, NULL);
+  DTYPE scratch[WS_MUL_NLIMBS];
+  bn_ws ws = { scratch, sizeof(scratch) };
+  bignum_mul_low_ws(a, b, c, nlimbs, &ws);
+  BN_LEAVE();
+}
 
-  _TPtr<_T_bn> current = NULL;
-  _TPtr<_T_bn> denom = NULL;
-  _TPtr<_T_bn> tmp = NULL;
 
-#ifndef NOOP_SBX
-  current = (_TPtr<_T_bn>)__malloc__(sizeof(_T_bn));
-  denom = (_TPtr<_T_bn>)__malloc__(sizeof(_T_bn));
-  tmp = (_TPtr<_T_bn>)__malloc__(sizeof(_T_bn));
-  //memset these to zero
-  t_memset(current, 0, sizeof(_T_bn));
-  t_memset(denom, 0, sizeof(_T_bn));
-  t_memset(tmp, 0, sizeof(_T_bn));
-#else
-    _T_bn _c_current;
-    _T_bn _C_denom;
-    _T_bn _C_tmp;
-    _T_bn _C_current_array[BN_ARRAY_SIZE];
-    _T_bn _C_denom_array[BN_ARRAY_SIZE];
-    _T_bn _C_tmp_array[BN_ARRAY_SIZE];
-#pragma TAINTED_SCOPE push
-#pragma TAINTED_SCOPE on
-    current = (_TPtr<_T_bn>)&_c_current;
-    denom = (_TPtr<_T_bn>)&_C_denom;
-    tmp = (_TPtr<_T_bn>)&_C_tmp;
-    current->array = (_TPtr<DTYPE>)&_C_current_array;
-    denom->array = (_TPtr<DTYPE>)&_C_denom_array;
-    tmp->array = (_TPtr<DTYPE>)&_C_tmp_array;
-#pragma TAINTED_SCOPE pop
-#endif
-  bignum_from_int(current, 1);               // int current = 1;
-  bignum_assign(denom, b);                   // denom = b
-  bignum_assign(tmp, a);                     // tmp   = a
+void bignum_mul_low_ws(_TPtr<_T_bn> a, _TPtr<_T_bn> b, _TPtr<_T_bn> c, int nlimbs, bn_ws* ws)
+{
+  /*
+    c = a * b mod B^nlimbs, B = 2^(8 * WORD_SIZE): the low nlimbs limbs of the
+    product, 0 <= nlimbs <= BN_ARRAY_SIZE, and no column above them is summed
+    (the product mod R of Montgomery reduction, or r2 of Barrett's).
+    c may alias a or b.
+  */
+  BN_ENTER(mul_low_ws);
+  require(a, "a is null");
+  require(b, "b is null");
+  require(c, "c is null");
+  require((nlimbs >= 0) && (nlimbs <= BN_ARRAY_SIZE), "nlimbs out of range");
+  BN_TRACE_CALL(mul_low, nlimbs, a, b, NULL);
+
+  DTYPE* r;
+  int nr = _mul_bn(&r, a, b, 0, nlimbs, ws);
+  _store_limbs(c, r, nr);
+  BN_LEAVE();
+}
+
+
+void bignum_mul_high(_TPtr<_T_bn> a, _TPtr<_T_bn> b, _TPtr<_T_bn> c, int nlimbs)
+{
+  BN_ENTER(mul_high);
+  require(a, "a is null");
+  require(b, "b is null");
+  require(c, "c is null");
+  BN_TRACE_CALL(mul_high, nlimbs, a, b, NULL);
+  DTYPE scratch[WS_MUL_NLIMBS];
+  bn_ws ws = { scratch, sizeof(scratch) };
+  bignum_mul_high_ws(a, b, c, nlimbs, &ws);
+  BN_LEAVE();
+}
+
 
+void bignum_mul_high_ws(_TPtr<_T_bn> a, _TPtr<_T_bn> b, _TPtr<_T_bn> c, int nlimbs, bn_ws* ws)
+{
+  /*
+    c = floor(a * b / B^nlimbs), B = 2^(8 * WORD_SIZE), 0 <= nlimbs <= 2 * BN_ARRAY_SIZE:
+    the product without its low nlimbs limbs, exact, truncated to BN_ARRAY_SIZE
+    limbs like bignum_mul (nothing is lost for nlimbs >= BN_ARRAY_SIZE).
+    Only a few columns below limb nlimbs are summed, see _mul_high_words --
+    the quotient estimate of Barrett reduction is such a product.
+    c may alias a or b.
+  */
+  BN_ENTER(mul_high_ws);
+  require(a, "a is null");
+  require(b, "b is null");
+  require(c, "c is null");
+  require((nlimbs >= 0) && (nlimbs <= 2 * BN_ARRAY_SIZE), "nlimbs out of range");
+  BN_TRACE_CALL(mul_high, nlimbs, a, b, NULL);
+
+  DTYPE* r;
+  int nr = _mul_bn(&r, a, b, nlimbs, BN_ARRAY_SIZE, ws);
+  _store_limbs(c, r, nr);
+  BN_LEAVE();
+}
 
-  const DTYPE_TMP half_max = 1 + (DTYPE_TMP)(MAX_VAL / 2);
-  bool overflow = false;
-  while (bignum_cmp(denom, a) != LARGER)     // while (denom <= a) {
+
+void bignum_mul_limbs(DTYPE* r, DTYPE* a, int na, DTYPE* b, int nb, bn_ws* ws)
+{
+  /*
+    r[0..na+nb-1] = a[0..na-1] * b[0..nb-1] on plain limb arrays, for numbers
+    longer than a bignum: the same tiers as bignum_mul_ws, and from NTT_CUTOFF
+    limbs on the number-theoretic transform (see _ntt_mul), which is what makes
+    operands of hundreds of thousands of bits practical.
+    ws needs bignum_mul_limbs_ws_size(na, nb) bytes, and may be NULL when that
+    is 0. r must not alias a or b; b == a with nb == na squares. Not recorded
+    by BN_TRACE.
+  */
+  BN_ENTER(mul_limbs);
+  require(r, "r is null");
+  require(((a != NULL) || (na == 0)), "a is null");
+  require(((b != NULL) || (nb == 0)), "b is null");
+  require((na >= 0) && (nb >= 0), "negative length");
+
+  if ((na >= LONGMUL_CUTOFF) && (nb >= LONGMUL_CUTOFF))
   {
-    if (denom->array[BN_ARRAY_SIZE - 1] >= half_max)
-    {
-      overflow = true;
-      break;
-    }
-    _lshift_one_bit(current);                //   current <<= 1;
-    _lshift_one_bit(denom);                  //   denom <<= 1;
+    _mul_long(r, a, na, b, nb, _ws_limbs(ws, (int)(bignum_mul_limbs_ws_size(na, nb) / sizeof(DTYPE))));
   }
-  if (!overflow)
+  else if ((a == b) && (na == nb))
   {
-    _rshift_one_bit(denom);                  // denom >>= 1;
-    _rshift_one_bit(current);                // current >>= 1;
+    _sqr_words(r, 2 * na, a, na);
   }
-  bignum_init(c);                             // int answer = 0;
+  else
+  {
+    _mul_words(r, na + nb, a, na, b, nb);
+  }
+  BN_LEAVE();
+}
 
-  while (!bignum_is_zero(current))           // while (current != 0)
+
+size_t bignum_mul_limbs_ws_size(int na, int nb)
+{
+  /* Scratch of _mul_long for these lengths: pieces of the shorter length n up to Toom-3 (9n + 512), or one NTT */
+  BN_ENTER(mul_limbs_ws_size);
+  const int n = (na < nb) ? na : nb;
+  size_t nlimbs = 0;
+  if ((n >= LONGMUL_CUTOFF) && (n >= NTT_CUTOFF))
   {
-    if (bignum_cmp(tmp, denom) != SMALLER)  //   if (dividend >= denom)
-    {
-      bignum_sub(tmp, denom, tmp);         //     dividend -= denom;
-      bignum_or(c, current, c);              //     answer |= current;
-    }
-    _rshift_one_bit(current);                //   current >>= 1;
-    _rshift_one_bit(denom);                  //   denom >>= 1;
+    nlimbs = _ntt_nlimbs(na, nb);
   }
-#ifndef NOOP_SBX
-  __free__(current->array); __free__(denom->array);__free__(tmp->array);
-  __free__(current);
-  __free__(denom);
-  __free__(tmp);
-#endif
+  else if (n >= LONGMUL_CUTOFF)
+  {
+    nlimbs = (9 * (size_t)n) + 512;
+  }
+  BN_LEAVE();
+  return nlimbs * sizeof(DTYPE);
+}
+
+
+void bignum_div(_TPtr<_T_bn> a, _TPtr<_T_bn> b, _TPtr<_T_bn> c)
+{
+  BN_ENTER(div);
+  require(a, "a is null");
+  require(b, "b is null");
+  require(c, "c is null");
+  BN_TRACE_CALL(div, 0, a, b, NULL);
+  DTYPE scratch[WS_DIVMOD_NLIMBS];
+  bn_ws ws = { scratch, sizeof(scratch) };
+  bignum_div_ws(a, b, c, &ws);
+  BN_LEAVE();
+}
+
+
+void bignum_div_ws(_TPtr<_T_bn> a, _TPtr<_T_bn> b, _TPtr<_T_bn> c, bn_ws* ws)
+{
+  BN_ENTER(div_ws);
+  require(a, "a is null");
+  require(b, "b is null");
+  require(c, "c is null");
+  BN_TRACE_CALL(div, 0, a, b, NULL);
+
+  _divmod(a, b, c, NULL, _ws_limbs(ws, WS_DIVMOD_NLIMBS));
+  BN_LEAVE();
 }
 
 
 void bignum_lshift(_TPtr<_T_bn> a, _TPtr<_T_bn> b, int nbits)
 {
+  BN_ENTER(lshift);
   require(a, "a is null");
   require(b, "b is null");
   require(nbits >= 0, "no negative shifts");
+  BN_TRACE_CALL(lshift, nbits, a, NULL, NULL);
 
-  bignum_assign(b, a);
-  /* Handle shift in multiples of word-size */
+  if (b->array == NULL)
+  {
+    bignum_init(b);
+  }
+
+  /* Split the shift into whole words and the remaining bits */
   const int nbits_pr_word = (WORD_SIZE * 8);
-  int nwords = nbits / nbits_pr_word;
-  if (nwords != 0)
+  const int nwords = nbits / nbits_pr_word;
+  nbits -= (nwords * nbits_pr_word);
+
+  const int old_used = b->used;
+  int top = (a->used == 0) ? 0 : (a->used + nwords + (nbits != 0));
+  if (top > BN_ARRAY_SIZE)
   {
-    _lshift_word(b, nwords);
-    nbits -= (nwords * nbits_pr_word);
+    top = BN_ARRAY_SIZE;
   }
 
-  if (nbits != 0)
+  /* Top-down, so b may alias a */
+  int i, j;
+  for (i = top - 1; i >= nwords; --i)
   {
-    int i;
-    for (i = (BN_ARRAY_SIZE - 1); i > 0; --i)
+    j = i - nwords;
+    if (nbits != 0)
+    {
+      b->array[i] = (a->array[j] << nbits) | ((j > 0) ? (a->array[j - 1] >> (nbits_pr_word - nbits)) : 0);
+    }
+    else
     {
-      b->array[i] = (b->array[i] << nbits) | (b->array[i - 1] >> ((8 * WORD_SIZE) - nbits));
+      b->array[i] = a->array[j];
     }
-    b->array[i] <<= nbits;
   }
+  /* Zero pad shifted words. */
+  for (; i >= 0; --i)
+  {
+    b->array[i] = 0;
+  }
+  _set_top(b, top, old_used);
+  BN_LEAVE();
 }
 
 
 void bignum_rshift(_TPtr<_T_bn> a, _TPtr<_T_bn> b, int nbits)
 {
+  BN_ENTER(rshift);
   require(a, "a is null");
   require(b, "b is null");
   require(nbits >= 0, "no negative shifts");
-  
-  bignum_assign(b, a);
-  /* Handle shift in multiples of word-size */
+  BN_TRACE_CALL(rshift, nbits, a, NULL, NULL);
+
+  if (b->array == NULL)
+  {
+    bignum_init(b);
+  }
+
+  /* Split the shift into whole words and the remaining bits */
   const int nbits_pr_word = (WORD_SIZE * 8);
-  int nwords = nbits / nbits_pr_word;
-  if (nwords != 0)
+  const int nwords = nbits / nbits_pr_word;
+  nbits -= (nwords * nbits_pr_word);
+
+  const int old_used = b->used;
+  int top = a->used - nwords;
+  if (top < 0)
   {
-    _rshift_word(b, nwords);
-    nbits -= (nwords * nbits_pr_word);
+    top = 0;
   }
 
-  if (nbits != 0)
+  /* Bottom-up, so b may alias a */
+  int i, j;
+  for (i = 0; i < top; ++i)
   {
-    int i;
-    for (i = 0; i < (BN_ARRAY_SIZE - 1); ++i)
+    j = i + nwords;
+    if (nbits != 0)
+    {
+      b->array[i] = (a->array[j] >> nbits) | ((j + 1 < BN_ARRAY_SIZE) ? (a->array[j + 1] << (nbits_pr_word - nbits)) : 0);
+    }
+    else
     {
-      b->array[i] = (b->array[i] >> nbits) | (b->array[i + 1] << ((8 * WORD_SIZE) - nbits));
+      b->array[i] = a->array[j];
     }
-    b->array[i] >>= nbits;
   }
-  
+  _set_top(b, top, old_used);
+  BN_LEAVE();
 }
 
 
 void bignum_mod(_TPtr<_T_bn> a, _TPtr<_T_bn> b, _TPtr<_T_bn> c)
+{
+  BN_ENTER(mod);
+  require(a, "a is null");
+  require(b, "b is null");
+  require(c, "c is null");
+  BN_TRACE_CALL(mod, 0, a, b, NULL);
+  DTYPE scratch[WS_DIVMOD_NLIMBS];
+  bn_ws ws = { scratch, sizeof(scratch) };
+  bignum_mod_ws(a, b, c, &ws);
+  BN_LEAVE();
+}
+
+
+void bignum_mod_ws(_TPtr<_T_bn> a, _TPtr<_T_bn> b, _TPtr<_T_bn> c, bn_ws* ws)
 {
   /*
-    Take divmod and throw away div part
+    Take divmod and throw away div part -- the quotient is never stored
   */
+  BN_ENTER(mod_ws);
   require(a, "a is null");
   require(b, "b is null");
   require(c, "c is null");
+  BN_TRACE_CALL(mod, 0, a, b, NULL);
 
-  _TPtr<_T_bn> tmp = NULL;
-#ifndef NOOP_SBX
-  tmp = (_TPtr<_T_bn>)__malloc__(sizeof(_T_bn));
-    //memset this to zero
-    t_memset(tmp, 0, sizeof(_T_bn));
-#else
-    _T_bn _C_tmp;
-    _T_bn _C_tmp_array[BN_ARRAY_SIZE];
-#pragma TAINTED_SCOPE push
-#pragma TAINTED_SCOPE on
-    tmp = (_TPtr<_T_bn>)&_C_tmp;
-    tmp->array = (_TPtr<DTYPE>)&_C_tmp_array;
-#pragma TAINTED_SCOPE pop
-#endif
-
-  bignum_divmod(a,b,tmp,c);
-    __free__(tmp->array);
-  __free__(tmp);
+  _divmod(a, b, NULL, c, _ws_limbs(ws, WS_DIVMOD_NLIMBS));
+  BN_LEAVE();
 }
 
 void bignum_divmod(_TPtr<_T_bn> a, _TPtr<_T_bn> b, _TPtr<_T_bn> c, _TPtr<_T_bn> d)
+{
+  BN_ENTER(divmod);
+  require(a, "a is null");
+  require(b, "b is null");
+  require(c, "c is null");
+  require(d, "d is null");
+  BN_TRACE_CALL(divmod, 0, a, b, NULL);
+  DTYPE scratch[WS_DIVMOD_NLIMBS];
+  bn_ws ws = { scratch, sizeof(scratch) };
+  bignum_divmod_ws(a, b, c, d, &ws);
+  BN_LEAVE();
+}
+
+
+void bignum_divmod_ws(_TPtr<_T_bn> a, _TPtr<_T_bn> b, _TPtr<_T_bn> c, _TPtr<_T_bn> d, bn_ws* ws)
 {
   /*
     Puts a%b in d
     and a/b in c
 
-    mod(a,b) = a - ((a / b) * b)
-
-    example:
-      mod(8, 3) = 8 - ((8 / 3) * 3) = 2
+    Both come out of the same division pass: the remainder is what is
+    left of the dividend once the last quotient limb has been subtracted.
   */
+  BN_ENTER(divmod_ws);
   require(a, "a is null");
   require(b, "b is null");
   require(c, "c is null");
-#ifndef NOOP_SBX
-  _TPtr<_T_bn> tmp = (_TPtr<_T_bn>)__malloc__(sizeof(_T_bn));
-  //memset this to 0
-  t_memset(tmp, 0, sizeof(_T_bn));
-#else
-    _T_bn _C_tmp;
-#pragma TAINTED_SCOPE push
-#pragma TAINTED_SCOPE on
-    _TPtr<_T_bn> tmp = (_TPtr<_T_bn>)&_C_tmp;
-#pragma TAINTED_SCOPE pop
-#endif
-
-  /* c = (a / b) */
-  bignum_div(a, b, c);
-
-  /* tmp = (c * b) */
-  bignum_mul(c, b, tmp);
-
-  /* c = a - tmp */
-  bignum_sub(a, tmp, d);
+  require(d, "d is null");
+  BN_TRACE_CALL(divmod, 0, a, b, NULL);
 
-        __free__(tmp->array);
-  __free__(tmp);
+  _divmod(a, b, c, d, _ws_limbs(ws, WS_DIVMOD_NLIMBS));
+  BN_LEAVE();
 }
 
 
 void bignum_and(_TPtr<_T_bn> a, _TPtr<_T_bn> b, _TPtr<_T_bn> c)
 {
+  BN_ENTER(and);
   require(a, "a is null");
   require(b, "b is null");
   require(c, "c is null");
+  BN_TRACE_CALL(and, 0, a, b, NULL);
 
+  const int old_used = c->used;
+  const int top = (a->used < b->used) ? a->used : b->used;
   int i;
-  for (i = 0; i < BN_ARRAY_SIZE; ++i)
+  for (i = 0; i < top; ++i)
   {
     c->array[i] = (a->array[i] & b->array[i]);
   }
+  _set_top(c, top, old_used);
+  BN_LEAVE();
 }
 
 
 void bignum_or(_TPtr<_T_bn> a, _TPtr<_T_bn> b, _TPtr<_T_bn> c)
 {
+  BN_ENTER(or);
   require(a, "a is null");
   require(b, "b is null");
   require(c, "c is null");
+  BN_TRACE_CALL(or, 0, a, b, NULL);
 
+  const int old_used = c->used;
+  const int top = (a->used > b->used) ? a->used : b->used;
   int i;
-  for (i = 0; i < BN_ARRAY_SIZE; ++i)
+  for (i = 0; i < top; ++i)
   {
     c->array[i] = (a->array[i] | b->array[i]);
   }
+  _set_top(c, top, old_used);
+  BN_LEAVE();
 }
 
 
 void bignum_xor(_TPtr<_T_bn> a, _TPtr<_T_bn> b, _TPtr<_T_bn> c)
 {
+  BN_ENTER(xor);
   require(a, "a is null");
   require(b, "b is null");
   require(c, "c is null");
+  BN_TRACE_CALL(xor, 0, a, b, NULL);
 
+  const int old_used = c->used;
+  const int top = (a->used > b->used) ? a->used : b->used;
   int i;
-  for (i = 0; i < BN_ARRAY_SIZE; ++i)
+  for (i = 0; i < top; ++i)
   {
     c->array[i] = (a->array[i] ^ b->array[i]);
   }
+  _set_top(c, top, old_used);
+  BN_LEAVE();
 }
 
 
 int bignum_cmp(_TPtr<_T_bn> a, _TPtr<_T_bn> b)
 {
+  BN_ENTER(cmp);
   require(a, "a is null");
   require(b, "b is null");
+  BN_TRACE_CALL(cmp, 0, a, b, NULL);
+
+  /* More significant limbs -> larger number */
+  if (a->used != b->used)
+  {
+    BN_LEAVE();
+    return (a->used > b->used) ? LARGER : SMALLER;
+  }
 
-  //printf("Re-entering function\n");
-  int i = BN_ARRAY_SIZE;
-  do
+  int i = a->used;
+  while (i != 0)
   {
-      //print value of i
-    //t_printf("i = %d, a->array[i] = %d, b->array[i] = %d\n", i, a->array[i], b->array[i]);
-    i -= 1; /* Decrement first, to start with last array element */
+    i -= 1; /* Decrement first, to start with the top significant limb */
     if (a->array[i] > b->array[i])
     {
+      BN_LEAVE();
       return LARGER;
     }
     else if (a->array[i] < b->array[i])
     {
+      BN_LEAVE();
       return SMALLER;
     }
   }
-  while (i != 0);
 
+  BN_LEAVE();
   return EQUAL;
 }
 
 
 int bignum_is_zero(_TPtr<_T_bn> n)
 {
+  BN_ENTER(is_zero);
   require(n, "n is null");
+  BN_TRACE_CALL(is_zero, 0, n, NULL, NULL);
 
-  int i;
-  for (i = 0; i < BN_ARRAY_SIZE; ++i)
-  {
-    if (n->array[i])
-    {
-      return 0;
-    }
-  }
-
-  return 1;
+  BN_LEAVE();
+  return (n->used == 0);
 }
 
 
 void bignum_pow(_TPtr<_T_bn> a, _TPtr<_T_bn> b, _TPtr<_T_bn> c)
 {
+  BN_ENTER(pow);
   require(a, "a is null");
   require(b, "b is null");
   require(c, "c is null");
+  BN_TRACE_CALL(pow, 0, a, b, NULL);
+  DTYPE scratch[WS_POW_NLIMBS];
+  bn_ws ws = { scratch, sizeof(scratch) };
+  bignum_pow_ws(a, b, c, &ws);
+  BN_LEAVE();
+}
 
-  _TPtr<_T_bn> tmp = NULL;
-#ifndef NOOP_SBX
-  tmp = (_TPtr<_T_bn>)__malloc__(sizeof(_T_bn));
-    //memset this to 0
-    t_memset(tmp, 0, sizeof(_T_bn));
-#else
-    _T_bn _C_tmp;
-#pragma TAINTED_SCOPE push
-#pragma TAINTED_SCOPE on
-    tmp = (_TPtr<_T_bn>)&_C_tmp;
-#pragma TAINTED_SCOPE pop
-#endif
 
-  bignum_init(c);
+void bignum_pow_ws(_TPtr<_T_bn> a, _TPtr<_T_bn> b, _TPtr<_T_bn> c, bn_ws* ws)
+{
+  /*
+    Left-to-right binary exponentiation:
+    scan the exponent from its most significant set bit, squaring for every
+    bit and multiplying by a for every set bit -> O(log b) multiplications.
+
+    Like bignum_mul the result wraps around, i.e. c = a^b mod 2^(bits in a bignum).
+  */
+  BN_ENTER(pow_ws);
+  require(a, "a is null");
+  require(b, "b is null");
+  require(c, "c is null");
+  BN_TRACE_CALL(pow, 0, a, b, NULL);
+
+  const int nbits = (8 * WORD_SIZE);
+  DTYPE* base = _ws_limbs(ws, WS_POW_NLIMBS);
+  DTYPE* res = base + BN_ARRAY_SIZE;
+  DTYPE* tmp = res + BN_ARRAY_SIZE;
+  DTYPE* r = res;
+  DTYPE* t = tmp;
+  DTYPE* swap;
+  int nr = 0;  /* significant limbs in r */
+  int nt;
+  int i;
+
+  int na = _load_limbs(base, a, 0);
+
+  /* Index of most significant limb of the exponent */
+  int top = b->used - 1;
 
-  if (bignum_cmp(b, c) == EQUAL)
+  if (top < 0)
   {
     /* Return 1 when exponent is 0 -- n^0 = 1 */
-    bignum_inc(c);
+    res[0] = 1;
+    nr = 1;
   }
-  else
+  else if (na != 0)
   {
-#ifndef NOOP_SBX
-    _TPtr<_T_bn> bcopy = (_TPtr<_T_bn>)__malloc__(sizeof(_T_bn));
-    //memset this to 0
-    t_memset(bcopy, 0, sizeof(_T_bn));
-#else
-    _T_bn _C_bcopy;
-#pragma TAINTED_SCOPE push
-#pragma TAINTED_SCOPE on
-    _TPtr<_T_bn> bcopy = (_TPtr<_T_bn>)&_C_bcopy;
-#pragma TAINTED_SCOPE pop
-#endif
-
-    bignum_assign(bcopy, b);
+    /*
+      If a = 2^z * odd, then a^b has z * b trailing zero bits, so once
+      z * b reaches the bit width the truncated result is known to be 0.
+      (The a == 0 case is already covered by na == 0 -> res = 0.)
+    */
+    int zeros = 0;
+    while (((base[zeros / nbits] >> (zeros % nbits)) & 1) == 0)
+    {
+      zeros += 1;
+    }
 
-    /* Copy a -> tmp */
-    bignum_assign(tmp, a);
+    bool overflow = false;
+    if (zeros != 0)
+    {
+      /* overflow = (b >= ceil(width / zeros)), without forming b as an integer */
+      const DTYPE_TMP limit = ((BN_ARRAY_SIZE * nbits) + zeros - 1) / zeros;
+      DTYPE_TMP value = 0;
+      for (i = top; (i >= 0) && !overflow; --i)
+      {
+        value = (value << nbits) | b->array[i];
+        overflow = (value >= limit);
+      }
+    }
 
-    bignum_dec(bcopy);
- 
-    /* Begin summing products: */
-    while (!bignum_is_zero(bcopy))
+    if (!overflow)
     {
+      /* Most significant set bit of the exponent */
+      int bit = (top * nbits) + (nbits - 1);
+      while (((b->array[top] >> (bit % nbits)) & 1) == 0)
+      {
+        bit -= 1;
+      }
 
-      /* c = tmp * tmp */
-      bignum_mul(tmp, a, c);
-      /* Decrement b by one */
-      bignum_dec(bcopy);
+      /* res = a, consuming the top bit */
+      for (i = 0; i < na; ++i)
+      {
+        res[i] = base[i];
+      }
+      nr = na;
 
-      bignum_assign(tmp, c);
+      /* Products only span as many limbs as their factors, truncated to the bignum width */
+      for (bit -= 1; bit >= 0; --bit)
+      {
+        nt = ((2 * nr) < BN_ARRAY_SIZE) ? (2 * nr) : BN_ARRAY_SIZE;
+        _sqr_words(t, nt, r, nr);
+        nr = _used_words(t, nt);
+        swap = r; r = t; t = swap;
+
+        if ((b->array[bit / nbits] >> (bit % nbits)) & 1)
+        {
+          nt = ((nr + na) < BN_ARRAY_SIZE) ? (nr + na) : BN_ARRAY_SIZE;
+          _mul_words(t, nt, r, nr, base, na);
+          nr = _used_words(t, nt);
+          swap = r; r = t; t = swap;
+        }
+      }
     }
-
-    /* c = tmp */
-    bignum_assign(c, tmp);
-        __free__(bcopy->array);
-        __free__(tmp->array);
-    __free__(bcopy);
-    __free__(tmp);
   }
+
+  _store_limbs(c, r, nr);
+  BN_LEAVE();
 }
 
-void bignum_isqrt(_TPtr<_T_bn> a, _TPtr<_T_bn> b)
+void bignum_powmod(_TPtr<_T_bn> a, _TPtr<_T_bn> b, _TPtr<_T_bn> n, _TPtr<_T_bn> c)
 {
+  BN_ENTER(powmod);
   require(a, "a is null");
   require(b, "b is null");
+  require(n, "n is null");
+  require(c, "c is null");
+  BN_TRACE_CALL(powmod, 0, a, b, n);
+  DTYPE scratch[WS_POWMOD_NLIMBS];
+  bn_ws ws = { scratch, sizeof(scratch) };
+  bignum_powmod_ws(a, b, n, c, &ws);
+  BN_LEAVE();
+}
 
-#ifndef NOOP_SBX
-  _TPtr<_T_bn> low = (_TPtr<_T_bn>)__malloc__(sizeof(_T_bn));
-  _TPtr<_T_bn> high = (_TPtr<_T_bn>)__malloc__(sizeof(_T_bn));
-  _TPtr<_T_bn> mid = (_TPtr<_T_bn>)__malloc__(sizeof(_T_bn));
-  _TPtr<_T_bn> tmp =  (_TPtr<_T_bn>)__malloc__(sizeof(_T_bn));
-//memset these to 0
-t_memset(low, 0, sizeof(_T_bn));
-t_memset(high, 0, sizeof(_T_bn));
-t_memset(mid, 0, sizeof(_T_bn));
-t_memset(tmp, 0, sizeof(_T_bn));
-#else
-    _T_bn _C_low;
-    _T_bn _C_high;
-    _T_bn _C_mid;
-    _T_bn _C_tmp;
-#pragma TAINTED_SCOPE push
-#pragma TAINTED_SCOPE on
-    _TPtr<_T_bn> low = (_TPtr<_T_bn>)&_C_low;
-    _TPtr<_T_bn> high = (_TPtr<_T_bn>)&_C_high;
-    _TPtr<_T_bn> mid = (_TPtr<_T_bn>)&_C_mid;
-    _TPtr<_T_bn> tmp = (_TPtr<_T_bn>)&_C_tmp;
-#pragma TAINTED_SCOPE pop
-#endif
 
-  bignum_init(low);
-  bignum_assign(high, a);
-  bignum_rshift(high, mid, 1);
-  bignum_inc(mid);
+void bignum_powmod_ws(_TPtr<_T_bn> a, _TPtr<_T_bn> b, _TPtr<_T_bn> n, _TPtr<_T_bn> c, bn_ws* ws)
+{
+  /*
+    c = a^b mod n, by left-to-right sliding-window exponentiation
+    (Handbook of Applied Cryptography, algorithm 14.85).
+
+    The odd powers a^1, a^3, ..., a^(2^k - 1) mod n are precomputed, where the
+    window size k is chosen from the bit length of b. The exponent is then
+    scanned from the top in windows of at most k bits that end in a set bit:
+    one squaring per bit and one table multiplication per window.
+
+    Products are formed at double width and reduced by Algorithm D against a
+    modulus that is normalized once per call. All scratch lives in the workspace.
+  */
+  BN_ENTER(powmod_ws);
+  require(a, "a is null");
+  require(b, "b is null");
+  require(n, "n is null");
+  require(c, "c is null");
+  BN_TRACE_CALL(powmod, 0, a, b, n);
+
+  DTYPE* v = _ws_limbs(ws, WS_POWMOD_NLIMBS);                   /* modulus, normalized */
+  DTYPE* x = v + BN_ARRAY_SIZE;                                  /* a mod n, one extra limb */
+  DTYPE* table = x + BN_ARRAY_SIZE + 1;                          /* x^1, x^3, x^5, ... mod n, BN_ARRAY_SIZE apart */
+  DTYPE* res = table + ((1 << (POWMOD_MAX_WINDOW - 1)) * BN_ARRAY_SIZE);
+  DTYPE* prod = res + BN_ARRAY_SIZE;                             /* double-width product, one extra limb, then Karatsuba scratch */
+  int nres = 0;                                                  /* limbs of res to store */
+  int i, j, l;
+
+  int nn = _load_limbs(v, n, 0);
+  require(nn > 0, "modulus is zero");
+
+  /* Most significant set bit of the exponent */
+  int ebits = b->used * (8 * WORD_SIZE);
+  while ((ebits > 0) && !_test_bit(b, ebits - 1))
+  {
+    ebits -= 1;
+  }
 
-  while (bignum_cmp(high, low) > 0)
+  if ((nn == 1) && (v[0] == 1))
+  {
+    /* Everything is 0 mod 1 */
+  }
+  else if (ebits == 0)
+  {
+    /* n^0 = 1 */
+    res[0] = 1;
+    nres = 1;
+  }
+  else
   {
-    bignum_mul(mid, mid, tmp);
-    if (bignum_cmp(tmp, a) > 0)
+    int s = _norm_shift(v, nn);
+
+    /* x = a mod n, zero-padded to the width of n */
+    int m = _load_limbs(x, a, nn);
+    if (m >= nn)
+    {
+      _divmod_norm(NULL, x, m, v, nn, s);
+    }
+
+    /* Window size by exponent length, same break-even points as OpenSSL */
+    int k = (ebits > 671) ? 6 : (ebits > 239) ? 5 : (ebits > 79) ? 4 : (ebits > 23) ? 3 : 1;
+    if (k > POWMOD_MAX_WINDOW)
+    {
+      k = POWMOD_MAX_WINDOW;
+    }
+
+    /* table[i] = x^(2i + 1) mod n, using res to hold x^2 mod n */
+    for (i = 0; i < nn; ++i)
+    {
+      table[i] = x[i];
+    }
+    if (k > 1)
     {
-      bignum_assign(high, mid);
-      bignum_dec(high);
+      _mulmod_words(res, x, x, v, nn, s, prod);
+      for (i = 1; i < (1 << (k - 1)); ++i)
+      {
+        _mulmod_words(table + (i * BN_ARRAY_SIZE), table + ((i - 1) * BN_ARRAY_SIZE), res, v, nn, s, prod);
+      }
     }
-    else 
+
+    bool started = false;
+    i = ebits - 1;
+    while (i >= 0)
     {
-      bignum_assign(low, mid);
+      if (!_test_bit(b, i))
+      {
+        _mulmod_words(res, res, res, v, nn, s, prod);
+        i -= 1;
+      }
+      else
+      {
+        /* Longest window b[i..l] of at most k bits that ends in a set bit */
+        l = ((i - k + 1) > 0) ? (i - k + 1) : 0;
+        while (!_test_bit(b, l))
+        {
+          l += 1;
+        }
+
+        int w = 0;
+        for (j = i; j >= l; --j)
+        {
+          w = (w << 1) | _test_bit(b, j);
+          if (started)
+          {
+            _mulmod_words(res, res, res, v, nn, s, prod);
+          }
+        }
+
+        /* w is odd -> x^w is table[w / 2] */
+        if (started)
+        {
+          _mulmod_words(res, res, table + ((w >> 1) * BN_ARRAY_SIZE), v, nn, s, prod);
+        }
+        else
+        {
+          for (j = 0; j < nn; ++j)
+          {
+            res[j] = table[((w >> 1) * BN_ARRAY_SIZE) + j];
+          }
+          started = true;
+        }
+        i = l - 1;
+      }
     }
-    bignum_sub(high,low,mid);
-    _rshift_one_bit(mid);
-    bignum_add(low,mid,mid);
-    bignum_inc(mid);
+    nres = nn;
   }
-  bignum_assign(b,low);
-  __free__(low->array);
-    __free__(high->array);
-    __free__(mid->array);
-    __free__(tmp->array);
-  __free__(low); __free__(high);__free__(mid);__free__(tmp);
 
+  _store_limbs(c, res, nres);
+  BN_LEAVE();
 }
 
-
-void bignum_assign(_TPtr<_T_bn> dst, _TPtr<_T_bn> src)
+void bignum_isqrt(_TPtr<_T_bn> a, _TPtr<_T_bn> b)
+{
+  BN_ENTER(isqrt);
+  require(a, "a is null");
+  require(b, "b is null");
+  BN_TRACE_CALL(isqrt, 0, a, NULL, NULL);
+  DTYPE scratch[WS_ISQRT_NLIMBS];
+  bn_ws ws = { scratch, sizeof(scratch) };
+  bignum_isqrt_ws(a, b, &ws);
+  BN_LEAVE();
+}
+
+
+void bignum_isqrt_ws(_TPtr<_T_bn> a, _TPtr<_T_bn> b, bn_ws* ws)
+{
+  /*
+    b = floor(sqrt(a)), one result bit at a time from the top:
+    a bit is kept if the square of the result with that bit set is still <= a.
+    Squares are formed at double width, so they never wrap around.
+  */
+  BN_ENTER(isqrt_ws);
+  require(a, "a is null");
+  require(b, "b is null");
+  BN_TRACE_CALL(isqrt, 0, a, NULL, NULL);
+
+  const int nbits = (8 * WORD_SIZE);
+  DTYPE* x = _ws_limbs(ws, WS_ISQRT_NLIMBS);   /* a, zero-padded to double width */
+  DTYPE* r = x + (2 * BN_ARRAY_SIZE);          /* root */
+  DTYPE* sq = r + BN_ARRAY_SIZE;               /* r * r */
+  int i, bit;
+
+  int na = _load_limbs(x, a, 2 * BN_ARRAY_SIZE);
+  int nr = 0;
+
+  if (na != 0)
+  {
+    /* Most significant set bit of a -> the root has half as many bits */
+    int top = (na * nbits) - 1;
+    while (((x[top / nbits] >> (top % nbits)) & 1) == 0)
+    {
+      top -= 1;
+    }
+    nr = ((top / 2) / nbits) + 1;
+    for (i = 0; i < nr; ++i)
+    {
+      r[i] = 0;
+    }
+
+    for (bit = top / 2; bit >= 0; --bit)
+    {
+      r[bit / nbits] |= ((DTYPE)1 << (bit % nbits));
+      _sqr_words(sq, 2 * nr, r, nr);
+      if (_cmp_words(sq, x, 2 * nr) == LARGER)
+      {
+        r[bit / nbits] &= ~((DTYPE)1 << (bit % nbits));
+      }
+    }
+  }
+
+  _store_limbs(b, r, nr);
+  BN_LEAVE();
+}
+
+
+void bignum_assign(_TPtr<_T_bn> dst, _TPtr<_T_bn> src)
 {
+  BN_ENTER(assign);
   require(dst, "dst is null");
   require(src, "src is null");
+  BN_TRACE_CALL(assign, 0, src, NULL, NULL);
 
   //since we are dealing with heap pointer as member instead of array, we need to check for NULL and allocate
   if (dst->array == NULL)
   {
 #ifndef NOOP_SBX
-      dst->array = (_TPtr<uint32_t>)__malloc__(BN_ARRAY_SIZE*sizeof(uint32_t));
+      dst->array = (_TPtr<DTYPE>)__bn_malloc__(BN_ARRAY_SIZE*sizeof(DTYPE));
 #else
       _T_bn _C_dst_array;
 #pragma TAINTED_SCOPE push
 #pragma TAINTED_SCOPE on
-      dst->array = (_TPtr<uint32_t>)&_C_dst_array;
+      dst->array = (_TPtr<DTYPE>)&_C_dst_array;
 #pragma TAINTED_SCOPE pop
 #endif
+      dst->used = BN_ARRAY_SIZE; /* fresh limbs hold garbage */
   }
+  const int old_used = dst->used;
+  const int used = src->used;
   int i;
-  for (i = 0; i < BN_ARRAY_SIZE; ++i)
+  for (i = 0; i < used; ++i)
   {
     dst->array[i] = src->array[i];
   }
+  _set_top(dst, used, old_used);
+  BN_LEAVE();
 }
 
 
-/* Private / Static functions. */
-static void _rshift_word(_TPtr<_T_bn> a, int nwords)
+size_t bignum_ws_size(void)
+{
+  /* Enough for every _ws function */
+  BN_ENTER(ws_size);
+  BN_LEAVE();
+  return WS_POWMOD_NLIMBS * sizeof(DTYPE);
+}
+
+
+void bignum_mont_init(bn_mont_ctx* ctx, _TPtr<_T_bn> n)
+{
+  BN_ENTER(mont_init);
+  require(ctx, "ctx is null");
+  require(n, "n is null");
+
+  DTYPE v[BN_ARRAY_SIZE];
+  DTYPE u[(2 * BN_ARRAY_SIZE) + 2];
+  int i;
+
+  ctx->nlimbs = _load_limbs(ctx->n, n, BN_ARRAY_SIZE);
+  require(ctx->nlimbs > 0, "modulus is zero");
+  require(ctx->n[0] & 1, "modulus must be odd");
+
+  /*
+    n0inv = -n^-1 mod 2^(8 * WORD_SIZE), by Newton iteration x = x * (2 - n * x).
+    Any odd n is its own inverse mod 8, and every step doubles the number of
+    correct low bits: 3 -> 6 -> 12 -> 24 -> 48 -> 96.
+  */
+  DTYPE_TMP x = ctx->n[0];
+  for (i = 0; i < 5; ++i)
+  {
+    x = (DTYPE)(x * (2 - (ctx->n[0] * x)));
+  }
+  ctx->n0inv = (DTYPE)(0 - x);
+
+  /* rr = R^2 mod n = 2^(2 * 8 * WORD_SIZE * nlimbs) mod n */
+  const int nlimbs = ctx->nlimbs;
+  for (i = 0; i < nlimbs; ++i)
+  {
+    v[i] = ctx->n[i];
+  }
+  for (i = 0; i < 2 * nlimbs; ++i)
+  {
+    u[i] = 0;
+  }
+  u[2 * nlimbs] = 1;
+  _divmod_words(NULL, u, (2 * nlimbs) + 1, v, nlimbs);
+  for (i = 0; i < BN_ARRAY_SIZE; ++i)
+  {
+    ctx->rr[i] = (i < nlimbs) ? u[i] : 0;
+  }
+  BN_LEAVE();
+}
+
+
+void bignum_to_mont(bn_mont_ctx* ctx, _TPtr<_T_bn> a, _TPtr<_T_bn> b)
 {
-  /* Naive method: */
+  BN_ENTER(to_mont);
+  require(ctx, "ctx is null");
   require(a, "a is null");
-  require(nwords >= 0, "no negative shifts");
+  require(b, "b is null");
+  BN_TRACE_CALL_CTX(to_mont, ctx, a, NULL, NULL);
 
+  DTYPE x[BN_ARRAY_SIZE + 1];
+  DTYPE v[BN_ARRAY_SIZE];
+  DTYPE res[BN_ARRAY_SIZE];
+  const int nlimbs = ctx->nlimbs;
   int i;
-  if (nwords >= BN_ARRAY_SIZE)
+
+  /* Reduce a below n first, then a * R = mont_mul(a, R^2) */
+  int m = _load_limbs(x, a, nlimbs);
+  if (m >= nlimbs)
   {
-    for (i = 0; i < BN_ARRAY_SIZE; ++i)
+    for (i = 0; i < nlimbs; ++i)
     {
-      a->array[i] = 0;
+      v[i] = ctx->n[i];
     }
-    return;
+    _divmod_words(NULL, x, m, v, nlimbs);
+  }
+  _mont_mul_words(res, x, ctx->rr, ctx);
+  _store_limbs(b, res, nlimbs);
+  BN_LEAVE();
+}
+
+
+void bignum_from_mont(bn_mont_ctx* ctx, _TPtr<_T_bn> a, _TPtr<_T_bn> b)
+{
+  BN_ENTER(from_mont);
+  require(ctx, "ctx is null");
+  require(a, "a is null");
+  require(b, "b is null");
+  BN_TRACE_CALL_CTX(from_mont, ctx, a, NULL, NULL);
+
+  DTYPE x[BN_ARRAY_SIZE];
+  DTYPE one[BN_ARRAY_SIZE];
+  DTYPE res[BN_ARRAY_SIZE];
+  int i;
+
+  /* a / R = mont_mul(a, 1) */
+  _load_limbs(x, a, ctx->nlimbs);
+  for (i = 0; i < BN_ARRAY_SIZE; ++i)
+  {
+    one[i] = 0;
   }
+  one[0] = 1;
+  _mont_mul_words(res, x, one, ctx);
+  _store_limbs(b, res, ctx->nlimbs);
+  BN_LEAVE();
+}
+
+
+void bignum_mont_mul(bn_mont_ctx* ctx, _TPtr<_T_bn> a, _TPtr<_T_bn> b, _TPtr<_T_bn> c)
+{
+  BN_ENTER(mont_mul);
+  require(ctx, "ctx is null");
+  require(a, "a is null");
+  require(b, "b is null");
+  require(c, "c is null");
+  BN_TRACE_CALL_CTX(mont_mul, ctx, a, b, NULL);
 
-  for (i = 0; i < BN_ARRAY_SIZE - nwords; ++i)
+  DTYPE x[BN_ARRAY_SIZE];
+  DTYPE y[BN_ARRAY_SIZE];
+  DTYPE res[BN_ARRAY_SIZE];
+
+  _load_limbs(x, a, ctx->nlimbs);
+  _load_limbs(y, b, ctx->nlimbs);
+  _mont_mul_words(res, x, y, ctx);
+  _store_limbs(c, res, ctx->nlimbs);
+  BN_LEAVE();
+}
+
+
+void bignum_barrett_init(bn_barrett_ctx* ctx, _TPtr<_T_bn> n)
+{
+  BN_ENTER(barrett_init);
+  require(ctx, "ctx is null");
+  require(n, "n is null");
+
+  DTYPE v[BN_ARRAY_SIZE];
+  DTYPE u[(2 * BN_ARRAY_SIZE) + 2];
+  DTYPE q[BN_ARRAY_SIZE + 2];
+  int i;
+
+  ctx->nlimbs = _load_limbs(ctx->n, n, BN_ARRAY_SIZE);
+  require(ctx->nlimbs > 0, "modulus is zero");
+
+  /* mu = floor(b^(2k) / n), with k = nlimbs -> at most k + 1 limbs */
+  const int k = ctx->nlimbs;
+  for (i = 0; i < k; ++i)
+  {
+    v[i] = ctx->n[i];
+  }
+  for (i = 0; i < 2 * k; ++i)
   {
-    a->array[i] = a->array[i + nwords];
+    u[i] = 0;
   }
-  for (; i < BN_ARRAY_SIZE; ++i)
+  u[2 * k] = 1;
+  _divmod_words(q, u, (2 * k) + 1, v, k);
+  for (i = 0; i < BN_ARRAY_SIZE + 1; ++i)
+  {
+    ctx->mu[i] = (i <= k) ? q[i] : 0;
+  }
+  BN_LEAVE();
+}
+
+
+void bignum_barrett_reduce(bn_barrett_ctx* ctx, _TPtr<_T_bn> lo, _TPtr<_T_bn> hi, _TPtr<_T_bn> r)
+{
+  BN_ENTER(barrett_reduce);
+  require(ctx, "ctx is null");
+  require(lo, "lo is null");
+  require(r, "r is null");
+  BN_TRACE_CALL_CTX(barrett_reduce, ctx, lo, hi, NULL);
+
+  DTYPE x[2 * BN_ARRAY_SIZE];
+  /* With a high half, lo is padded to the full width below it */
+  int m = _load_limbs(x, lo, (hi != NULL) ? BN_ARRAY_SIZE : 0);
+  if (hi != NULL)
   {
-    a->array[i] = 0;
+    int mh = _load_limbs(x + BN_ARRAY_SIZE, hi, 0);
+    if (mh != 0)
+    {
+      m = BN_ARRAY_SIZE + mh;
+    }
   }
+  _barrett_reduce_words(x, m, ctx);
+  _store_limbs(r, x, ctx->nlimbs);
+  BN_LEAVE();
 }
 
 
-static void _lshift_word(_TPtr<_T_bn> a, int nwords)
+void bignum_barrett_mulmod(bn_barrett_ctx* ctx, _TPtr<_T_bn> a, _TPtr<_T_bn> b, _TPtr<_T_bn> c)
 {
+  BN_ENTER(barrett_mulmod);
+  require(ctx, "ctx is null");
   require(a, "a is null");
-  require(nwords >= 0, "no negative shifts");
+  require(b, "b is null");
+  require(c, "c is null");
+  BN_TRACE_CALL_CTX(barrett_mulmod, ctx, a, b, NULL);
+
+  DTYPE x[BN_ARRAY_SIZE];
+  DTYPE y[BN_ARRAY_SIZE];
+  DTYPE prod[2 * BN_ARRAY_SIZE];
+
+  int na = _load_limbs(x, a, 0);
+  int nb = (a == b) ? na : _load_limbs(y, b, 0);
+  if (a == b)
+  {
+    _sqr_words(prod, 2 * na, x, na);
+  }
+  else
+  {
+    _mul_words(prod, na + nb, x, na, y, nb);
+  }
+  _barrett_reduce_words(prod, na + nb, ctx);
+  _store_limbs(c, prod, ctx->nlimbs);
+  BN_LEAVE();
+}
+
+
+/* Private / Static functions. */
+static void _pool_refill(int cls)
+{
+  /* First refill on this thread: register it, so _pool_park runs when it exits */
+  pthread_once(&_pool_key_once, _pool_key_create);
+  if (pthread_getspecific(_pool_key) == NULL)
+  {
+    pthread_setspecific(_pool_key, &_pool_key);
+  }
+
+  /* Slots parked by exited threads, all of the class at once */
+  pthread_mutex_lock(&_pool_parked_lock);
+  _pool_free[cls] = _pool_parked[cls];
+  _pool_parked[cls] = NULL;
+  pthread_mutex_unlock(&_pool_parked_lock);
+  if (_pool_free[cls] != NULL)
+  {
+    return;
+  }
+
+  /* Else one sandbox allocation, carved into BN_POOL_REFILL slots pushed in address order */
+  const size_t stride = BN_POOL_PREFIX + _pool_class_size[cls];
+  _TPtr<char> chunk = (_TPtr<char>)__sbx_malloc__(BN_POOL_REFILL * stride);
+  require(chunk, "out of memory");
 
   int i;
-  /* Shift whole words */
-  for (i = (BN_ARRAY_SIZE - 1); i >= nwords; --i)
+  for (i = BN_POOL_REFILL - 1; i >= 0; --i)
   {
-    a->array[i] = a->array[i - nwords];
+    _TPtr<_T_bn_pool_slot> slot = (_TPtr<_T_bn_pool_slot>)(chunk + (i * stride));
+    slot->tag = BN_POOL_TAG(slot, BN_POOL_FREE);
+    slot->next = _pool_free[cls];
+    _pool_free[cls] = slot;
   }
-  /* Zero pad shifted words. */
-  for (; i >= 0; --i)
+  _pool_stats.refills += 1;
+}
+
+
+static void _pool_key_create(void)
+{
+  pthread_key_create(&_pool_key, _pool_park);
+}
+
+
+static void _pool_park(void* unused)
+{
+  /* Thread exit: splice each of its free lists onto the parked list of the class */
+  int cls;
+  (void)unused;
+
+  pthread_mutex_lock(&_pool_parked_lock);
+  for (cls = 0; cls < BN_POOL_NCLASSES; ++cls)
+  {
+    if (_pool_free[cls] != NULL)
+    {
+      _TPtr<_T_bn_pool_slot> tail = _pool_free[cls];
+      while (tail->next != NULL)
+      {
+        tail = tail->next;
+      }
+      tail->next = _pool_parked[cls];
+      _pool_parked[cls] = _pool_free[cls];
+      _pool_free[cls] = NULL;
+    }
+  }
+  pthread_mutex_unlock(&_pool_parked_lock);
+}
+
+
+#ifdef BN_INSTRUMENT
+static void _instr_enter(int fn)
+{
+  /* Nested calls are counted, but work stays charged to the outermost function */
+  _instr.calls[fn] += 1;
+  if (_instr_depth == 0)
   {
-    a->array[i] = 0;
-  }  
+    _instr_fn = fn;
+  }
+  _instr_depth += 1;
 }
 
 
-static void _lshift_one_bit(_TPtr<_T_bn> a)
+static void _instr_leave(void)
 {
-  require(a, "a is null");
+  _instr_depth -= 1;
+  if (_instr_depth == 0)
+  {
+    _instr_fn = BN_FN_OUTSIDE;
+  }
+}
+#endif
+
+
+#ifdef BN_PROFILE
+static uint64_t _prof_now(void)
+{
+  /* Time-stamp counter where there is one, nanoseconds otherwise */
+#if defined(__x86_64__) || defined(__i386__)
+  return __builtin_ia32_rdtsc();
+#elif defined(__aarch64__)
+  uint64_t t;
+  __asm__ __volatile__("mrs %0, cntvct_el0" : "=r"(t));
+  return t;
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * 1000000000u) + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+
+static bn_prof_table* _prof_table(void)
+{
+  /* First call on this thread: allocate its table and push it onto the shared list */
+  if (_prof_mine == NULL)
+  {
+    _prof_mine = (bn_prof_thread*)calloc(1, sizeof(bn_prof_thread));
+    require(_prof_mine, "out of memory");
+    _prof_mine->next = __atomic_load_n(&_prof_threads, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&_prof_threads, &_prof_mine->next, _prof_mine, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+    {
+    }
+  }
+  return &_prof_mine->table;
+}
+
+
+static void _prof_enter(int fn)
+{
+  /*
+    The function is timed from the end of this hook to the start of _prof_leave.
+    The hooks themselves are charged to neither it nor its caller: the caller's
+    nested count runs from the start of this hook to the end of _prof_leave.
+  */
+  const uint64_t entered = _prof_now();
+
+  if (_prof_depth < BN_PROF_MAX_DEPTH)
+  {
+    _prof_stack[_prof_depth].fn = fn;
+    _prof_stack[_prof_depth].nested = 0;
+    _prof_stack[_prof_depth].entered = entered;
+  }
+  _prof_depth += 1;
+  if (_prof_depth <= BN_PROF_MAX_DEPTH)
+  {
+    _prof_stack[_prof_depth - 1].start = _prof_now();
+  }
+}
+
+
+static void _prof_leave(void)
+{
+  const uint64_t end = _prof_now();
+
+  _prof_depth -= 1;
+  if (_prof_depth >= BN_PROF_MAX_DEPTH)
+  {
+    return;
+  }
+
+  const uint64_t cycles = end - _prof_stack[_prof_depth].start;
+  bn_prof_entry* e = &_prof_table()->fn[_prof_stack[_prof_depth].fn];
+  e->calls += 1;
+  e->cycles += cycles;
+  e->self_cycles += cycles - _prof_stack[_prof_depth].nested;
+
+  int bucket = 0;
+  while ((bucket < (BN_PROF_NBUCKETS - 1)) && ((cycles >> (bucket + 1)) != 0))
+  {
+    bucket += 1;
+  }
+  e->hist[bucket] += 1;
+
+  if (_prof_depth > 0)
+  {
+    _prof_stack[_prof_depth - 1].nested += _prof_now() - _prof_stack[_prof_depth].entered;
+  }
+}
+#endif
+
+
+#ifdef BN_TRACE
+static void _trace_record(int fn, int arg, DTYPE* mod, int nmod, _TPtr<_T_bn> x, _TPtr<_T_bn> y, _TPtr<_T_bn> z)
+{
+  /* Operands are written up to the first NULL -- e.g. the missing hi of bignum_barrett_reduce */
+  unsigned char rec[BN_TRACE_MAX_RECORD];
+  DTYPE limbs[BN_ARRAY_SIZE];
+  int pos = BN_TRACE_RECORD;
+  int nops = 0;
 
+  if (mod != NULL)
+  {
+    pos = _trace_put_words(rec, pos, mod, nmod);
+    nops += 1;
+  }
+  if (x != NULL)
+  {
+    pos = _trace_put_words(rec, pos, limbs, _load_limbs(limbs, x, 0));
+    nops += 1;
+    if (y != NULL)
+    {
+      pos = _trace_put_words(rec, pos, limbs, _load_limbs(limbs, y, 0));
+      nops += 1;
+      if ((z != NULL) && (mod == NULL))
+      {
+        pos = _trace_put_words(rec, pos, limbs, _load_limbs(limbs, z, 0));
+        nops += 1;
+      }
+    }
+  }
+
+  rec[0] = (unsigned char)pos;
+  rec[1] = (unsigned char)(pos >> 8);
+  rec[2] = (unsigned char)fn;
+  rec[3] = (unsigned char)nops;
+  rec[4] = (unsigned char)arg;
+  rec[5] = (unsigned char)(arg >> 8);
+  rec[6] = (unsigned char)(arg >> 16);
+  rec[7] = (unsigned char)(arg >> 24);
+  _trace_append(rec, pos);
+}
+
+
+static int _trace_put_words(unsigned char* rec, int pos, DTYPE* w, int n)
+{
+  /* u16 byte count, then the limbs least significant byte first */
+  const int nbytes = n * WORD_SIZE;
   int i;
-  for (i = (BN_ARRAY_SIZE - 1); i > 0; --i)
+
+  rec[pos] = (unsigned char)nbytes;
+  rec[pos + 1] = (unsigned char)(nbytes >> 8);
+  pos += 2;
+  for (i = 0; i < nbytes; ++i)
   {
-    a->array[i] = (a->array[i] << 1) | (a->array[i - 1] >> ((8 * WORD_SIZE) - 1));
+    rec[pos + i] = (unsigned char)(w[i / WORD_SIZE] >> (8 * (i % WORD_SIZE)));
   }
-  a->array[0] <<= 1;
+  return pos + nbytes;
 }
 
 
-static void _rshift_one_bit(_TPtr<_T_bn> a)
+static int _trace_size(int pos)
 {
-  require(a, "a is null");
+  return _trace_buf[pos] | (_trace_buf[pos + 1] << 8);
+}
+
+
+static void _trace_append(unsigned char* rec, int size)
+{
+  /* Drop the oldest records until there is room for size bytes in front of head */
+  if (_trace_buf == NULL)
+  {
+    _trace_buf = (unsigned char*)calloc(1, BN_TRACE_SIZE);
+    require(_trace_buf, "out of memory");
+  }
+
+  for (;;)
+  {
+    if (!_trace_wrapped)
+    {
+      if (_trace_head + size <= BN_TRACE_SIZE)
+      {
+        break;
+      }
+      _trace_end = _trace_head;
+      _trace_head = 0;
+      _trace_wrapped = 1;
+    }
+    else if (_trace_head + size <= _trace_tail)
+    {
+      break;
+    }
+    else if (_trace_tail == _trace_end)
+    {
+      /* Nothing left behind head: the records are [0, head) again */
+      _trace_tail = 0;
+      _trace_wrapped = 0;
+    }
+    else
+    {
+      _trace_tail += _trace_size(_trace_tail);
+      _trace_count -= 1;
+      _trace_dropped += 1;
+    }
+  }
 
   int i;
-  for (i = 0; i < (BN_ARRAY_SIZE - 1); ++i)
+  for (i = 0; i < size; ++i)
+  {
+    _trace_buf[_trace_head + i] = rec[i];
+  }
+  _trace_head += size;
+  _trace_count += 1;
+}
+#endif
+
+
+static DTYPE* _ws_limbs(bn_ws* ws, int nlimbs)
+{
+  require(ws, "ws is null");
+  require(ws->limbs, "workspace has no memory");
+  require(ws->size >= (nlimbs * sizeof(DTYPE)), "workspace too small, see bignum_ws_size()");
+
+  return ws->limbs;
+}
+
+
+static void _mul_acc(DTYPE* acc, DTYPE x, DTYPE y)
+{
+  /* acc[0..MUL_ACC_NLIMBS-1] += x * y */
+  DTYPE_TMP prod = (DTYPE_TMP)x * y;
+  DTYPE_TMP tmp;
+
+  tmp = (DTYPE_TMP)acc[0] + (DTYPE)prod;
+  acc[0] = (DTYPE)tmp;
+  tmp = (DTYPE_TMP)acc[1] + (prod >> (8 * WORD_SIZE)) + (tmp >> (8 * WORD_SIZE));
+  acc[1] = (DTYPE)tmp;
+#if (MUL_ACC_NLIMBS == 4)
+  tmp = (DTYPE_TMP)acc[2] + (tmp >> (8 * WORD_SIZE));
+  acc[2] = (DTYPE)tmp;
+  acc[3] += (DTYPE)(tmp >> (8 * WORD_SIZE));
+#else
+  acc[2] += (DTYPE)(tmp >> (8 * WORD_SIZE));
+#endif
+}
+
+
+static void _mul_words(DTYPE* r, int nr, DTYPE* a, int na, DTYPE* b, int nb)
+{
+  /*
+    r[0..nr-1] = a[0..na-1] * b[0..nb-1], column by column.
+    The product is truncated to nr limbs, or zero-padded if nr > na + nb.
+    r must not alias a or b.
+  */
+  DTYPE acc[MUL_ACC_NLIMBS] = { 0 };
+  int i, k, lo, hi;
+  for (k = 0; k < nr; ++k)
+  {
+    lo = (k < nb) ? 0 : (k - nb + 1);
+    hi = (k < na) ? k : (na - 1);
+    for (i = lo; i <= hi; ++i)
+    {
+      _mul_acc(acc, a[i], b[k - i]);
+    }
+    r[k] = acc[0];
+    for (i = 1; i < MUL_ACC_NLIMBS; ++i)
+    {
+      acc[i - 1] = acc[i];
+    }
+    acc[MUL_ACC_NLIMBS - 1] = 0;
+  }
+}
+
+
+static void _mul_high_words(DTYPE* r, int nr, DTYPE* a, int na, DTYPE* b, int nb, int lo)
+{
+  /*
+    r[0..nr-1] = limbs lo .. lo+nr-1 of a[0..na-1] * b[0..nb-1], exact, zero-padded
+    past the top of the product; column by column like _mul_words, starting
+    MULHIGH_GUARD columns below lo instead of at 0.
+    The skipped columns k < k0 sum to less than k0 * (B - 1) * B^k0, so they
+    carry less than k0 * B into column k0. Unless adding that much to the
+    guard limbs could overflow them, it cannot reach limb lo and r stands;
+    otherwise the columns are summed again from 0.
+    r must not alias a or b.
+  */
+  DTYPE acc[MUL_ACC_NLIMBS];
+  DTYPE guard[MULHIGH_GUARD];
+  DTYPE_TMP tmp, carry;
+  int i, k, first, last;
+  int k0 = (lo > MULHIGH_GUARD) ? (lo - MULHIGH_GUARD) : 0;
+
+  while (1)
+  {
+    for (i = 0; i < MUL_ACC_NLIMBS; ++i)
+    {
+      acc[i] = 0;
+    }
+    for (i = 0; i < MULHIGH_GUARD; ++i)
+    {
+      guard[i] = 0;
+    }
+    for (k = k0; k < (lo + nr); ++k)
+    {
+      first = (k < nb) ? 0 : (k - nb + 1);
+      last = (k < na) ? k : (na - 1);
+      for (i = first; i <= last; ++i)
+      {
+        _mul_acc(acc, a[i], b[k - i]);
+      }
+      if (k >= lo)
+      {
+        r[k - lo] = acc[0];
+      }
+      else if (k >= (lo - MULHIGH_GUARD))
+      {
+        guard[k - (lo - MULHIGH_GUARD)] = acc[0];
+      }
+      for (i = 1; i < MUL_ACC_NLIMBS; ++i)
+      {
+        acc[i - 1] = acc[i];
+      }
+      acc[MUL_ACC_NLIMBS - 1] = 0;
+    }
+    if (k0 == 0)
+    {
+      return;
+    }
+
+    /* guard + k0 * B < B^MULHIGH_GUARD? */
+    carry = (DTYPE_TMP)k0;
+    for (i = 1; (i < MULHIGH_GUARD) && (carry != 0); ++i)
+    {
+      tmp = (DTYPE_TMP)guard[i] + (DTYPE)carry;
+      carry = (carry >> (8 * WORD_SIZE)) + (tmp >> (8 * WORD_SIZE));
+    }
+    if (carry == 0)
+    {
+      return;
+    }
+    k0 = 0;
+  }
+}
+
+
+static void _sqr_words(DTYPE* r, int nr, DTYPE* a, int na)
+{
+  /*
+    r[0..nr-1] = a[0..na-1]^2 with about half the limb products of _mul_words:
+
+      a^2 = 2 * sum(a[i] * a[j] * B^(i+j)) for i < j,  plus sum(a[i]^2 * B^2i)
+
+    The cross products are summed row by row into r, then one pass doubles r
+    and adds the diagonal. The product is truncated to nr limbs, or zero-padded
+    if nr > 2 * na. r must not alias a.
+  */
+  DTYPE_TMP tmp, sq;
+  DTYPE carry;
+  int i, j, top;
+  for (i = 0; i < nr; ++i)
+  {
+    r[i] = 0;
+  }
+
+  for (i = 0; i < na; ++i)
+  {
+    /* Row i: a[i] * a[j] for j = i+1 .. top-1, top cut so that i + j stays below nr */
+    top = (na < (nr - i)) ? na : (nr - i);
+    carry = 0;
+    for (j = i + 1; j < top; ++j)
+    {
+      tmp = ((DTYPE_TMP)a[i] * a[j]) + r[i + j] + carry;
+      r[i + j] = (DTYPE)tmp;
+      carry = (DTYPE)(tmp >> (8 * WORD_SIZE));
+    }
+    if ((i + top) < nr)
+    {
+      r[i + top] = carry;
+    }
+  }
+
+  /* r = 2 * r + diagonal, the carry between limbs is at most 2 */
+  carry = 0;
+  for (i = 0; (i < na) && ((2 * i) < nr); ++i)
+  {
+    sq = (DTYPE_TMP)a[i] * a[i];
+    tmp = ((DTYPE_TMP)r[2 * i] << 1) + (DTYPE)sq + carry;
+    r[2 * i] = (DTYPE)tmp;
+    carry = (DTYPE)(tmp >> (8 * WORD_SIZE));
+    if (((2 * i) + 1) < nr)
+    {
+      tmp = ((DTYPE_TMP)r[(2 * i) + 1] << 1) + (sq >> (8 * WORD_SIZE)) + carry;
+      r[(2 * i) + 1] = (DTYPE)tmp;
+      carry = (DTYPE)(tmp >> (8 * WORD_SIZE));
+    }
+  }
+}
+
+
+static int _mul_part(DTYPE* r, int lo, int nr, DTYPE* a, int na, DTYPE* b, int nb, DTYPE* scratch)
+{
+  /*
+    r[0..] = limbs lo .. lo+nr-1 of a[0..na-1] * b[0..nb-1]. Returns how many of
+    them lie below the top of the product; the rest are zero and not written.
+    Short products sum only the columns asked for: _mul_words (or _sqr_words
+    for b == a) for the low limbs, _mul_high_words for any others. The whole
+    product from LONGMUL_CUTOFF limbs on, and short ones from SHORTMUL_CUTOFF
+    on, are formed by _mul_long and r is cut from it.
+    r needs room for na + nb limbs and must not alias a, b or scratch;
+    scratch is that of _mul_long.
+  */
+  const int n = ((na == 0) || (nb == 0)) ? 0 : (na + nb);
+  const int m = (lo >= n) ? 0 : (((n - lo) < nr) ? (n - lo) : nr);
+  const int whole = (lo == 0) && (m == n);
+  int i;
+
+  if (m == 0)
+  {
+    return 0;
+  }
+  if ((na >= LONGMUL_CUTOFF) && (nb >= LONGMUL_CUTOFF) &&
+      (whole || ((na >= SHORTMUL_CUTOFF) && (nb >= SHORTMUL_CUTOFF))))
+  {
+    _mul_long(r, a, na, b, nb, scratch);
+    for (i = 0; (lo > 0) && (i < m); ++i)
+    {
+      r[i] = r[lo + i];
+    }
+  }
+  else if (lo > 0)
+  {
+    _mul_high_words(r, m, a, na, b, nb, lo);
+  }
+  else if ((a == b) && (na == nb))
+  {
+    _sqr_words(r, m, a, na);
+  }
+  else
+  {
+    _mul_words(r, m, a, na, b, nb);
+  }
+  return m;
+}
+
+
+static int _mul_bn(DTYPE** r, _TPtr<_T_bn> a, _TPtr<_T_bn> b, int lo, int nr, bn_ws* ws)
+{
+  /*
+    Limbs lo .. lo+nr-1 of a * b into the workspace by _mul_part, *r pointing at
+    them; returns how many were written. Workspace: a, b, the product
+    (2 * BN_ARRAY_SIZE) and the scratch of _mul_long, WS_MUL_NLIMBS in all.
+    a == b reads one copy, so that every tier takes its squaring path.
+  */
+  DTYPE* x = _ws_limbs(ws, WS_MUL_NLIMBS);
+  DTYPE* y = (a == b) ? x : (x + BN_ARRAY_SIZE);
+  DTYPE* t = x + (4 * BN_ARRAY_SIZE);
+  *r = x + (2 * BN_ARRAY_SIZE);
+
+  int na = _load_limbs(x, a, 0);
+  int nb = (y == x) ? na : _load_limbs(y, b, 0);
+  return _mul_part(*r, lo, nr, x, na, y, nb, t);
+}
+
+
+static void _mul_long(DTYPE* r, DTYPE* a, int na, DTYPE* b, int nb, DTYPE* scratch)
+{
+  /*
+    r[0..na+nb-1] = a * b, for operands of at least LONGMUL_CUTOFF limbs.
+    The longer operand is cut into pieces as long as the shorter one, each
+    piece is multiplied by _mul_equal and added in at its offset; a last,
+    shorter piece is zero-padded, or left to _mul_words below the cutoff.
+    When the shorter operand has NTT_CUTOFF limbs, one NTT takes the whole
+    product instead, however unbalanced.
+    r must not alias a, b or scratch; scratch needs 9n + 512 limbs (n the
+    shorter length), or _ntt_nlimbs(na, nb) for the NTT.
+  */
+  DTYPE* swap;
+  int i, k, len;
+
+  if (na < nb)
+  {
+    swap = a; a = b; b = swap;
+    k = na; na = nb; nb = k;
+  }
+
+  if (nb >= NTT_CUTOFF)
+  {
+    _ntt_mul(r, a, na, b, nb, scratch);
+    return;
+  }
+
+  DTYPE* pad = scratch;
+  DTYPE* prod = pad + nb;
+  DTYPE* t = prod + (2 * nb);
+
+  if (na == nb)
+  {
+    _mul_equal(r, a, b, nb, t);
+    return;
+  }
+
+  for (i = 0; i < (na + nb); ++i)
+  {
+    r[i] = 0;
+  }
+  for (i = 0; i < na; i += nb)
+  {
+    len = ((na - i) < nb) ? (na - i) : nb;
+    if (len == nb)
+    {
+      _mul_equal(prod, a + i, b, nb, t);
+    }
+    else if (len >= LONGMUL_CUTOFF)
+    {
+      for (k = 0; k < nb; ++k)
+      {
+        pad[k] = (k < len) ? a[i + k] : 0;
+      }
+      _mul_equal(prod, pad, b, nb, t);
+    }
+    else
+    {
+      _mul_words(prod, len + nb, a + i, len, b, nb);
+    }
+    _add_into(r + i, na + nb - i, prod, len + nb);
+  }
+}
+
+
+static void _mul_equal(DTYPE* r, DTYPE* a, DTYPE* b, int n, DTYPE* scratch)
+{
+  /* r[0..2n-1] = a[0..n-1] * b[0..n-1] by the fastest tier for n limbs, a square if a == b */
+  if (n >= NTT_CUTOFF)
+  {
+    _ntt_mul(r, a, n, b, n, scratch);
+  }
+  else if (n >= TOOM3_CUTOFF)
+  {
+    _toom3_words(r, a, b, n, scratch);
+  }
+  else if (n >= KARATSUBA_CUTOFF)
+  {
+    _kara_words(r, a, b, n, scratch);
+  }
+  else if (a == b)
+  {
+    _sqr_words(r, 2 * n, a, n);
+  }
+  else
+  {
+    _mul_words(r, 2 * n, a, n, b, n);
+  }
+}
+
+
+static void _kara_words(DTYPE* r, DTYPE* a, DTYPE* b, int n, DTYPE* scratch)
+{
+  /*
+    r[0..2n-1] = a[0..n-1] * b[0..n-1], Karatsuba (Knuth, TAOCP vol. 2, 4.3.3.A).
+
+    With a = a1 * B^h + a0 and b = b1 * B^h + b0, h = n / 2 and m = n - h limbs on top:
+
+      a * b = z2 * B^2h + (z2 + z0 - (a1 - a0) * (b1 - b0)) * B^h + z0,  z2 = a1 * b1, z0 = a0 * b0
+
+    Three half-size products instead of four. The differences are taken as
+    absolute values with their sign kept aside, so everything stays unsigned.
+    z0 and z2 go straight into the low and high half of r; the middle term is
+    summed in scratch and added in at limb h. Below KARATSUBA_CUTOFF limbs
+    the column kernel is faster.
+    A square (a == b) takes three half-size squares: db is da, and
+    da * da = (a1 - a0)^2 is never negative.
+    r must not alias a, b or scratch; scratch needs 6m + 1 limbs per level.
+  */
+  if (n < KARATSUBA_CUTOFF)
+  {
+    if (a == b)
+    {
+      _sqr_words(r, 2 * n, a, n);
+    }
+    else
+    {
+      _mul_words(r, 2 * n, a, n, b, n);
+    }
+    return;
+  }
+
+  const int h = n / 2;
+  const int m = n - h;
+  DTYPE* da = scratch;            /* |a1 - a0|, m limbs */
+  DTYPE* db = da + m;             /* |b1 - b0|, m limbs */
+  DTYPE* p = db + m;              /* da * db, 2m limbs */
+  DTYPE* mid = p + (2 * m);       /* middle term, 2m + 1 limbs */
+  DTYPE* t = mid + (2 * m) + 1;   /* next level */
+  int i;
+
+  _mul_equal(r, a, b, h, t);
+  _mul_equal(r + (2 * h), a + h, b + h, m, t);
+
+  int neg = 0;
+  if (a == b)
+  {
+    _kara_diff(da, a + h, m, a, h);
+    _mul_equal(p, da, da, m, t);
+  }
+  else
+  {
+    neg = _kara_diff(da, a + h, m, a, h) ^ _kara_diff(db, b + h, m, b, h);
+    _mul_equal(p, da, db, m, t);
+  }
+
+  /* mid = z2 + z0 -/+ p, which is a1 * b0 + a0 * b1 >= 0 */
+  for (i = 0; i < (2 * m); ++i)
+  {
+    mid[i] = r[(2 * h) + i];
+  }
+  mid[2 * m] = 0;
+  _add_into(mid, (2 * m) + 1, r, 2 * h);
+  if (neg)
+  {
+    _add_into(mid, (2 * m) + 1, p, 2 * m);
+  }
+  else
+  {
+    _sub_from(mid, (2 * m) + 1, p, 2 * m);
+  }
+
+  _add_into(r + h, (2 * n) - h, mid, (2 * m) + 1);
+}
+
+
+static void _toom3_words(DTYPE* r, DTYPE* a, DTYPE* b, int n, DTYPE* scratch)
+{
+  /*
+    r[0..2n-1] = a[0..n-1] * b[0..n-1], Toom-Cook 3-way (Knuth, TAOCP vol. 2, 4.3.3.A),
+    with the interpolation sequence of Bodrato & Zanoni, "Integer and Polynomial
+    Multiplication: Towards Optimal Toom-Cook Matrices".
+
+    a = a2 * x^2 + a1 * x + a0 at x = B^k, k = ceil(n / 3), a2 has the n - 2k top limbs.
+    Five products of about n / 3 limbs at x = 0, 1, -1, 2 and infinity
+
+      v0 = a0 * b0,  v1 = a(1) * b(1),  vm1 = a(-1) * b(-1),  v2 = a(2) * b(2),  vinf = a2 * b2
+
+    determine the five coefficients c0..c4 of the product. Only vm1 can be
+    negative, its factors are kept as magnitude and sign (see _kara_diff):
+
+      c0 = v0,  c4 = vinf
+      t2 = (v2 - vm1) / 3          exact, c1 + c2 + 3 c3 + 5 c4
+      t1 = (v1 - vm1) / 2          c1 + c3
+      c2 = v1 - v0                 c1 + c2 + c3 + c4 for now
+      c3 = (t2 - c2) / 2 - 2 vinf
+      c2 = c2 - t1 - vinf
+      c1 = t1 - c3
+
+    Every step stays non-negative, so all of it is unsigned limb arithmetic.
+    v0 and vinf go straight into r, c1..c3 are added in at limbs k, 2k and 3k.
+    A square (a == b) evaluates a only and squares at every point; vm1 is
+    then a(-1)^2 and never negative.
+    r must not alias a, b or scratch; scratch needs 12k + 12 limbs per level.
+  */
+  const int k = (n + 2) / 3;
+  const int n2 = n - (2 * k);      /* limbs of a2 and b2 */
+  const int l = (2 * k) + 2;       /* limbs of the products of k + 1 limb values */
+  DTYPE* sa = scratch;             /* a0 + a2 */
+  DTYPE* sb = sa + k + 1;          /* b0 + b2 */
+  DTYPE* ea = sb + k + 1;          /* a at the current point */
+  DTYPE* eb = ea + k + 1;          /* b at the current point */
+  DTYPE* v1 = eb + k + 1;
+  DTYPE* vm1 = v1 + l;
+  DTYPE* v2 = vm1 + l;
+  DTYPE* t1 = v2 + l;
+  DTYPE* t = t1 + l;               /* next level */
+  DTYPE* vinf = r + (4 * k);
+  const int sqr = (a == b);
+  DTYPE* fb = sqr ? ea : eb;       /* second factor at the current point */
+  int i, neg;
+
+  _mul_equal(r, a, b, k, t);
+  _mul_equal(vinf, a + (2 * k), b + (2 * k), n2, t);
+  for (i = 2 * k; i < (4 * k); ++i)
+  {
+    r[i] = 0;
+  }
+
+  /* x = 1 */
+  for (i = 0; i <= k; ++i)
+  {
+    sa[i] = (i < k) ? a[i] : 0;
+    sb[i] = (i < k) ? b[i] : 0;
+  }
+  _add_into(sa, k + 1, a + (2 * k), n2);
+  _add_into(sb, k + 1, b + (2 * k), n2);
+  for (i = 0; i <= k; ++i)
+  {
+    ea[i] = sa[i];
+    eb[i] = sb[i];
+  }
+  _add_into(ea, k + 1, a + k, k);
+  if (!sqr)
+  {
+    _add_into(eb, k + 1, b + k, k);
+  }
+  _mul_equal(v1, ea, fb, k + 1, t);
+
+  /* x = -1 */
+  neg = _kara_diff(ea, sa, k + 1, a + k, k);
+  neg = sqr ? 0 : (neg ^ _kara_diff(eb, sb, k + 1, b + k, k));
+  _mul_equal(vm1, ea, fb, k + 1, t);
+
+  /* x = 2 */
+  for (i = 0; i <= k; ++i)
+  {
+    ea[i] = (i < k) ? a[i] : 0;
+    eb[i] = (i < k) ? b[i] : 0;
+  }
+  _addmul_small(ea, k + 1, a + k, k, 2);
+  _addmul_small(ea, k + 1, a + (2 * k), n2, 4);
+  if (!sqr)
+  {
+    _addmul_small(eb, k + 1, b + k, k, 2);
+    _addmul_small(eb, k + 1, b + (2 * k), n2, 4);
+  }
+  _mul_equal(v2, ea, fb, k + 1, t);
+
+  /* Interpolation: v2 -> t2 -> c3, t1, v1 -> c2 */
+  if (neg)
+  {
+    _add_into(v2, l, vm1, l);
+  }
+  else
+  {
+    _sub_from(v2, l, vm1, l);
+  }
+  _divexact3(v2, l);
+
+  for (i = 0; i < l; ++i)
+  {
+    t1[i] = v1[i];
+  }
+  if (neg)
+  {
+    _add_into(t1, l, vm1, l);
+  }
+  else
+  {
+    _sub_from(t1, l, vm1, l);
+  }
+  _half_words(t1, l);
+
+  _sub_from(v1, l, r, 2 * k);
+  _sub_from(v2, l, v1, l);
+  _half_words(v2, l);
+  _sub_from(v2, l, vinf, 2 * n2);
+  _sub_from(v2, l, vinf, 2 * n2);
+  _sub_from(v1, l, t1, l);
+  _sub_from(v1, l, vinf, 2 * n2);
+  _sub_from(t1, l, v2, l);
+
+  /* r += c1 * x + c2 * x^2 + c3 * x^3, coefficients cut to what fits -- the rest is zero */
+  _add_into(r + k, (2 * n) - k, t1, (l < ((2 * n) - k)) ? l : ((2 * n) - k));
+  _add_into(r + (2 * k), (2 * n) - (2 * k), v1, (l < ((2 * n) - (2 * k))) ? l : ((2 * n) - (2 * k)));
+  _add_into(r + (3 * k), (2 * n) - (3 * k), v2, (l < ((2 * n) - (3 * k))) ? l : ((2 * n) - (3 * k)));
+}
+
+
+static int _kara_diff(DTYPE* r, DTYPE* hi, int m, DTYPE* lo, int h)
+{
+  /*
+    r[0..m-1] = |hi - lo|, where lo has h <= m limbs and is zero-extended.
+    Returns 1 if lo > hi, i.e. the difference hi - lo is negative.
+  */
+  int neg = (_cmp_words(hi, lo, h) == SMALLER);
+  int i;
+  for (i = h; i < m; ++i)
+  {
+    neg = neg && (hi[i] == 0);
+  }
+
+  if (neg)
+  {
+    for (i = 0; i < m; ++i)
+    {
+      r[i] = (i < h) ? lo[i] : 0;
+    }
+    _sub_from(r, m, hi, m);
+  }
+  else
+  {
+    for (i = 0; i < m; ++i)
+    {
+      r[i] = hi[i];
+    }
+    _sub_from(r, m, lo, h);
+  }
+  return neg;
+}
+
+
+static DTYPE _add_into(DTYPE* r, int nr, DTYPE* a, int na)
+{
+  /* r[0..nr-1] += a[0..na-1], na <= nr, returning the carry out of r */
+  DTYPE_TMP tmp;
+  DTYPE carry = 0;
+  int i;
+  for (i = 0; (i < na) || (carry && (i < nr)); ++i)
+  {
+    tmp = (DTYPE_TMP)r[i] + ((i < na) ? a[i] : 0) + carry;
+    r[i] = (DTYPE)tmp;
+    carry = (DTYPE)(tmp >> (8 * WORD_SIZE));
+  }
+  return carry;
+}
+
+
+static void _addmul_small(DTYPE* r, int nr, DTYPE* a, int na, DTYPE m)
+{
+  /* r[0..nr-1] += a[0..na-1] * m, na <= nr, carry out of r dropped */
+  DTYPE_TMP tmp;
+  DTYPE carry = 0;
+  int i;
+  for (i = 0; (i < na) || (carry && (i < nr)); ++i)
+  {
+    tmp = (DTYPE_TMP)r[i] + ((i < na) ? ((DTYPE_TMP)a[i] * m) : 0) + carry;
+    r[i] = (DTYPE)tmp;
+    carry = (DTYPE)(tmp >> (8 * WORD_SIZE));
+  }
+}
+
+
+static void _divexact3(DTYPE* r, int n)
+{
+  /*
+    r[0..n-1] /= 3 in place, r must be a multiple of 3.
+    Exact division by multiplying with 3^-1 mod B, one limb at a time, borrowing
+    the high part of q * 3 into the next limb (Jebelean, "An algorithm for exact
+    division"): no trial quotients.
+  */
+  const DTYPE inv3 = (DTYPE)(((MAX_VAL / 3) * 2) + 1);   /* 0xAB..AB, 3 * inv3 = 1 mod B */
+  DTYPE_TMP tmp;
+  DTYPE borrow = 0;
+  DTYPE q;
+  int i;
+  for (i = 0; i < n; ++i)
+  {
+    tmp = (DTYPE_TMP)r[i] - borrow;
+    q = (DTYPE)((DTYPE)tmp * inv3);
+    r[i] = q;
+    borrow = ((tmp >> (8 * WORD_SIZE)) != 0) + (DTYPE)(((DTYPE_TMP)q * 3) >> (8 * WORD_SIZE));
+  }
+}
+
+
+static void _half_words(DTYPE* r, int n)
+{
+  /* r[0..n-1] >>= 1 in place */
+  int i;
+  for (i = 0; i < n; ++i)
+  {
+    r[i] = (r[i] >> 1) | ((i + 1 < n) ? (DTYPE)(r[i + 1] << ((8 * WORD_SIZE) - 1)) : 0);
+  }
+}
+
+
+static DTYPE _sub_from(DTYPE* r, int nr, DTYPE* a, int na)
+{
+  /* r[0..nr-1] -= a[0..na-1], na <= nr, returning the borrow out of r */
+  DTYPE_TMP tmp;
+  DTYPE borrow = 0;
+  int i;
+  for (i = 0; (i < na) || (borrow && (i < nr)); ++i)
+  {
+    tmp = (DTYPE_TMP)r[i] - ((i < na) ? a[i] : 0) - borrow;
+    r[i] = (DTYPE)tmp;
+    borrow = ((tmp >> (8 * WORD_SIZE)) != 0);
+  }
+  return borrow;
+}
+
+
+static void _ntt_mul(DTYPE* r, DTYPE* a, int na, DTYPE* b, int nb, DTYPE* scratch)
+{
+  /*
+    r[0..na+nb-1] = a * b by number-theoretic transforms (Pollard, "The Fast
+    Fourier Transform in a Finite Field", 1971).
+
+    Cut into 32-bit digits, a and b are polynomials in 2^32 and their product
+    is the convolution of the digit sequences. It is computed modulo each of
+    three primes p < 2^30 as a cyclic convolution of npoints >= da + db - 1
+    points: forward transform of both, pointwise product, inverse transform.
+    A coefficient is a sum of at most min(da, db) <= 2^22 products below 2^64,
+    so it is below p0 * p1 * p2 (just over 2^86) and its three residues
+    determine it (Garner's CRT); the coefficients are then added up at 32-bit
+    offsets with a running carry.
+
+    The twiddle factors of a prime are tabulated once and shared by its
+    transforms; squares (a == b) need one forward transform per prime.
+    r must not alias a, b or scratch; scratch needs _ntt_nlimbs(na, nb) limbs.
+  */
+  const int npoints = _ntt_points(na, nb);
+  const int square = (a == b) && (na == nb);
+  const int nr = na + nb;
+  int i, k;
+
+  require(npoints <= NTT_MAX_POINTS, "product too long for the NTT primes");
+
+  /* Three residue vectors, the second operand, then the twiddle table; 32-bit aligned */
+  uint32_t* res = (uint32_t*)(((uintptr_t)scratch + 3) & ~(uintptr_t)3);
+  uint32_t* y = res + (3 * (size_t)npoints);
+  uint32_t* tw = y + npoints;
+
+  for (k = 0; k < 3; ++k)
+  {
+    const uint32_t p = _ntt_primes[k];
+    uint32_t* x = res + ((size_t)k * npoints);
+
+    _ntt_twiddles(tw, npoints, p);
+    _ntt_load(x, npoints, a, na, p);
+    _ntt_forward(x, npoints, tw, p);
+    if (!square)
+    {
+      _ntt_load(y, npoints, b, nb, p);
+      _ntt_forward(y, npoints, tw, p);
+    }
+
+    /*
+      Pointwise product by Montgomery reduction, which leaves a factor 2^-32;
+      it is cancelled together with the 1 / npoints of the inverse transform.
+    */
+    uint32_t pinv = p;
+    for (i = 0; i < 4; ++i)
+    {
+      pinv *= 2 - (p * pinv);          /* Newton: doubles the correct low bits of p^-1 mod 2^32 */
+    }
+    pinv = 0 - pinv;
+    const uint32_t scale = (uint32_t)(((uint64_t)_ntt_pow(npoints, p - 2, p) << 32) % p);
+    const uint32_t scaleq = _ntt_shoup(scale, p);
+    const uint32_t* z = square ? x : y;
+    for (i = 0; i < npoints; ++i)
+    {
+      x[i] = _ntt_mulw(_ntt_redc((uint64_t)x[i] * z[i], p, pinv), scale, scaleq, p);
+    }
+    _ntt_inverse(x, npoints, tw, p);
+  }
+
+  /* Garner: c = c0 + p0 * (c1 + p1 * c2), with c0 < p0, c1 < p1, c2 < p2; constant factors by _ntt_mulw */
+  const uint32_t p0 = _ntt_primes[0];
+  const uint32_t p1 = _ntt_primes[1];
+  const uint32_t p2 = _ntt_primes[2];
+  const uint32_t one1q = _ntt_shoup(1, p1);
+  const uint32_t one2q = _ntt_shoup(1, p2);
+  const uint32_t inv01 = _ntt_pow(p0, p1 - 2, p1);
+  const uint32_t inv01q = _ntt_shoup(inv01, p1);
+  const uint32_t p02 = p0 % p2;
+  const uint32_t p02q = _ntt_shoup(p02, p2);
+  const uint32_t inv012 = _ntt_pow((uint32_t)(((uint64_t)p02 * p1) % p2), p2 - 2, p2);
+  const uint32_t inv012q = _ntt_shoup(inv012, p2);
+
+  /* c + carry as hi * 2^32 + lo: the low 32 bits are the next digit of r, hi carries on */
+  const int ndigits = ((nr * WORD_SIZE) + 3) / 4;
+  uint64_t carry = 0;
+  for (i = 0; i < ndigits; ++i)
+  {
+    uint64_t lo = carry & 0xffffffff;
+    uint64_t hi = carry >> 32;
+    if (i < npoints)
+    {
+      const uint32_t c0 = res[i];
+      const uint32_t c1 = _ntt_mulw(res[npoints + i] + p1 - _ntt_mulw(c0, 1, one1q, p1), inv01, inv01q, p1);
+      const uint32_t s = _ntt_mulw(c0, 1, one2q, p2) + _ntt_mulw(c1, p02, p02q, p2);
+      const uint32_t c2 = _ntt_mulw(res[(2 * (size_t)npoints) + i] + (2 * p2) - s, inv012, inv012q, p2);
+      const uint64_t t = ((uint64_t)c2 * p1) + c1;                   /* < 2^60 */
+      const uint64_t u = ((t & 0xffffffff) * p0) + c0;              /* < 2^62 */
+      lo += u & 0xffffffff;
+      hi += ((t >> 32) * p0) + (u >> 32);
+    }
+    hi += lo >> 32;
+    carry = hi;
+
+    const uint32_t d = (uint32_t)lo;
+#if (WORD_SIZE >= 4)
+    if ((i % (WORD_SIZE / 4)) == 0)
+    {
+      r[i / (WORD_SIZE / 4)] = 0;
+    }
+    r[i / (WORD_SIZE / 4)] |= (DTYPE)d << (32 * (i % (WORD_SIZE / 4)));
+#else
+    for (k = 0; (k < (4 / WORD_SIZE)) && ((i * (4 / WORD_SIZE)) + k < nr); ++k)
+    {
+      r[(i * (4 / WORD_SIZE)) + k] = (DTYPE)(d >> (8 * WORD_SIZE * k));
+    }
+#endif
+  }
+}
+
+
+static int _ntt_points(int na, int nb)
+{
+  /* Transform length for an na- by nb-limb product: the power of 2 covering its da + db - 1 digit coefficients */
+  const int da = ((na * WORD_SIZE) + 3) / 4;
+  const int db = ((nb * WORD_SIZE) + 3) / 4;
+  int npoints = 1;
+  while ((npoints < (da + db - 1)) && (npoints <= NTT_MAX_POINTS))
+  {
+    npoints *= 2;
+  }
+  return npoints;
+}
+
+
+static int _ntt_nlimbs(int na, int nb)
+{
+  /* Scratch limbs of _ntt_mul: six 32-bit words per point, plus alignment */
+  return (int)(((24 * (size_t)_ntt_points(na, nb)) + 3 + WORD_SIZE - 1) / WORD_SIZE);
+}
+
+
+static void _ntt_load(uint32_t* x, int npoints, DTYPE* a, int na, uint32_t p)
+{
+  /* x[0..npoints-1] = 32-bit digits of a[0..na-1] mod p, zero-padded */
+  const int ndigits = ((na * WORD_SIZE) + 3) / 4;
+  const uint32_t oneq = _ntt_shoup(1, p);
+  int i;
+  for (i = 0; i < ndigits; ++i)
+  {
+#if (WORD_SIZE >= 4)
+    const uint32_t d = (uint32_t)(a[i / (WORD_SIZE / 4)] >> (32 * (i % (WORD_SIZE / 4))));
+#else
+    uint32_t d = 0;
+    int k;
+    for (k = 0; (k < (4 / WORD_SIZE)) && ((i * (4 / WORD_SIZE)) + k < na); ++k)
+    {
+      d |= (uint32_t)a[(i * (4 / WORD_SIZE)) + k] << (8 * WORD_SIZE * k);
+    }
+#endif
+    x[i] = _ntt_mulw(d, 1, oneq, p);
+  }
+  for (; i < npoints; ++i)
+  {
+    x[i] = 0;
+  }
+}
+
+
+static void _ntt_twiddles(uint32_t* tw, int npoints, uint32_t p)
+{
+  /*
+    Twiddle table of a transform of npoints points mod p. The butterflies of
+    half-width m (m = 1, 2, 4, .. npoints / 2) use w^j, j < m, for w a primitive
+    2m-th root of unity; they are stored at tw[2(m + j)], each followed by its
+    Shoup quotient floor(w^j * 2^32 / p) (see _ntt_mulw). So every pass reads
+    its twiddles in order from one contiguous run. Level m holds every other
+    twiddle of level 2m and is copied down from it.
+  */
+  int m = npoints / 2;
+  int j;
+  if (m < 1)
+  {
+    return;
+  }
+
+  const uint32_t w = _ntt_pow(NTT_ROOT, (p - 1) / (2 * (uint32_t)m), p);
+  uint32_t v = 1;
+  for (j = 0; j < m; ++j)
+  {
+    tw[2 * (m + j)] = v;
+    tw[(2 * (m + j)) + 1] = _ntt_shoup(v, p);
+    v = (uint32_t)(((uint64_t)v * w) % p);
+  }
+  for (m /= 2; m >= 1; m /= 2)
+  {
+    for (j = 0; j < m; ++j)
+    {
+      tw[2 * (m + j)] = tw[2 * ((2 * m) + (2 * j))];
+      tw[(2 * (m + j)) + 1] = tw[(2 * ((2 * m) + (2 * j))) + 1];
+    }
+  }
+}
+
+
+static void _ntt_forward(uint32_t* x, int npoints, uint32_t* tw, uint32_t p)
+{
+  /*
+    In-place forward transform mod p, decimation in frequency: natural order
+    in, bit-reversed order out. _ntt_inverse takes bit-reversed order back to
+    natural, so the pointwise product never needs the permutation.
+    The passes whose butterflies span NTT_BLOCK points or more run over the
+    whole array; after them the blocks are independent, and each one is
+    finished while it is in cache.
+  */
+  const int block = (npoints < NTT_BLOCK) ? npoints : NTT_BLOCK;
+  int m, s;
+  for (m = npoints / 2; m >= block; m /= 2)
+  {
+    _ntt_dif(x, npoints, m, tw + (2 * m), p);
+  }
+  for (s = 0; s < npoints; s += block)
+  {
+    for (m = block / 2; m >= 1; m /= 2)
+    {
+      _ntt_dif(x + s, block, m, tw + (2 * m), p);
+    }
+  }
+}
+
+
+static void _ntt_inverse(uint32_t* x, int npoints, uint32_t* tw, uint32_t p)
+{
+  /* In-place inverse of _ntt_forward, up to the factor npoints: the same passes in reverse */
+  const int block = (npoints < NTT_BLOCK) ? npoints : NTT_BLOCK;
+  int m, s;
+  for (s = 0; s < npoints; s += block)
+  {
+    for (m = 1; m < block; m *= 2)
+    {
+      _ntt_dit(x + s, block, m, tw + (2 * m), p);
+    }
+  }
+  for (m = block; m < npoints; m *= 2)
+  {
+    _ntt_dit(x, npoints, m, tw + (2 * m), p);
+  }
+}
+
+
+static void _ntt_dif(uint32_t* x, int n, int m, uint32_t* w, uint32_t p)
+{
+  /*
+    One Gentleman-Sande pass over x[0..n-1]: butterflies of half-width m,
+    (u, v) -> (u + v, (u - v) * w^j) with the twiddles of level m in w.
+  */
+  int i, j;
+  for (i = 0; i < n; i += 2 * m)
+  {
+    uint32_t* x0 = x + i;
+    uint32_t* x1 = x0 + m;
+    for (j = 0; j < m; ++j)
+    {
+      const uint32_t u = x0[j];
+      const uint32_t v = x1[j];
+      const uint32_t t = u + v;
+      x0[j] = (t >= p) ? (t - p) : t;
+      x1[j] = _ntt_mulw(u + p - v, w[2 * j], w[(2 * j) + 1], p);
+    }
+  }
+}
+
+
+static void _ntt_dit(uint32_t* x, int n, int m, uint32_t* w, uint32_t p)
+{
+  /*
+    One Cooley-Tukey pass over x[0..n-1] with the inverse twiddles:
+    (u, v) -> (u + v * w^-j, u - v * w^-j). As w^m = -1, w^-j = -w^(m - j),
+    so the forward table serves here too: t = v * w^(m - j) = -(v * w^-j).
+  */
+  int i, j;
+  uint32_t t;
+  for (i = 0; i < n; i += 2 * m)
+  {
+    uint32_t* x0 = x + i;
+    uint32_t* x1 = x0 + m;
+    const uint32_t u = x0[0];
+    const uint32_t v = x1[0];
+    t = u + v;
+    x0[0] = (t >= p) ? (t - p) : t;
+    x1[0] = (u >= v) ? (u - v) : (u + p - v);
+    for (j = 1; j < m; ++j)
+    {
+      t = _ntt_mulw(x1[j], w[2 * (m - j)], w[(2 * (m - j)) + 1], p);
+      const uint32_t s = x0[j] + t;
+      x1[j] = (s >= p) ? (s - p) : s;
+      x0[j] = (x0[j] >= t) ? (x0[j] - t) : (x0[j] + p - t);
+    }
+  }
+}
+
+
+static uint32_t _ntt_mulw(uint32_t x, uint32_t w, uint32_t wq, uint32_t p)
+{
+  /*
+    x * w mod p for any 32-bit x, given wq = floor(w * 2^32 / p) (Shoup's
+    precomputed quotient): q below is x * w / p or one less, so x * w - q * p
+    is in [0, 2p) and fits 32 bits -- no division, no 64-bit remainder.
+  */
+  const uint32_t q = (uint32_t)(((uint64_t)x * wq) >> 32);
+  const uint32_t t = (x * w) - (q * p);
+  return (t >= p) ? (t - p) : t;
+}
+
+
+static uint32_t _ntt_shoup(uint32_t w, uint32_t p)
+{
+  /* Shoup quotient of a constant factor w < p, for _ntt_mulw */
+  return (uint32_t)(((uint64_t)w << 32) / p);
+}
+
+
+static uint32_t _ntt_redc(uint64_t t, uint32_t p, uint32_t pinv)
+{
+  /*
+    t * 2^-32 mod p for t < p * 2^32, given pinv = -p^-1 mod 2^32 (Montgomery
+    reduction): adding m * p clears the low 32 bits of t, the rest is below 2p.
+  */
+  const uint32_t m = (uint32_t)t * pinv;
+  const uint64_t u = (t + ((uint64_t)m * p)) >> 32;
+  return (uint32_t)((u >= p) ? (u - p) : u);
+}
+
+
+static uint32_t _ntt_pow(uint32_t x, uint32_t e, uint32_t p)
+{
+  /* x^e mod p, square and multiply */
+  uint64_t r = 1;
+  uint64_t b = x % p;
+  while (e)
+  {
+    if (e & 1)
+    {
+      r = (r * b) % p;
+    }
+    b = (b * b) % p;
+    e >>= 1;
+  }
+  return (uint32_t)r;
+}
+
+
+static void _mont_mul_words(DTYPE* r, DTYPE* a, DTYPE* b, bn_mont_ctx* ctx)
+{
+  /*
+    r = a * b * R^-1 mod n -- Montgomery multiplication, CIOS variant
+    (Koc, Acar & Kaliski, "Analyzing and Comparing Montgomery Multiplication Algorithms").
+
+    For every limb of b, add a * b[i] to the running sum t, then add the
+    multiple m * n that clears the lowest limb of t and shift t down one limb.
+    a and b must be below n; t stays below 2n, so one final subtraction suffices.
+    r may alias a or b.
+  */
+  const int nbits = (8 * WORD_SIZE);
+  const int nlimbs = ctx->nlimbs;
+  DTYPE t[BN_ARRAY_SIZE + 2];
+  DTYPE_TMP tmp, carry, m;
+  int i, j;
+
+  for (i = 0; i < nlimbs + 2; ++i)
+  {
+    t[i] = 0;
+  }
+
+  for (i = 0; i < nlimbs; ++i)
+  {
+    /* t += a * b[i] */
+    carry = 0;
+    for (j = 0; j < nlimbs; ++j)
+    {
+      tmp = (DTYPE_TMP)t[j] + ((DTYPE_TMP)a[j] * b[i]) + carry;
+      t[j] = (DTYPE)tmp;
+      carry = tmp >> nbits;
+    }
+    tmp = (DTYPE_TMP)t[nlimbs] + carry;
+    t[nlimbs] = (DTYPE)tmp;
+    t[nlimbs + 1] = (DTYPE)(tmp >> nbits);
+
+    /* t = (t + m * n) / 2^nbits, with m chosen so the low limb becomes zero */
+    m = (DTYPE)(t[0] * (DTYPE_TMP)ctx->n0inv);
+    tmp = (DTYPE_TMP)t[0] + (m * ctx->n[0]);
+    carry = tmp >> nbits;
+    for (j = 1; j < nlimbs; ++j)
+    {
+      tmp = (DTYPE_TMP)t[j] + (m * ctx->n[j]) + carry;
+      t[j - 1] = (DTYPE)tmp;
+      carry = tmp >> nbits;
+    }
+    tmp = (DTYPE_TMP)t[nlimbs] + carry;
+    t[nlimbs - 1] = (DTYPE)tmp;
+    t[nlimbs] = t[nlimbs + 1] + (DTYPE)(tmp >> nbits);
+  }
+
+  /* if (t >= n) t -= n */
+  if ((t[nlimbs] != 0) || (_cmp_words(t, ctx->n, nlimbs) != SMALLER))
+  {
+    _sub_words(t, t, ctx->n, nlimbs);
+  }
+
+  for (j = 0; j < nlimbs; ++j)
+  {
+    r[j] = t[j];
+  }
+}
+
+
+static void _barrett_reduce_words(DTYPE* x, int m, bn_barrett_ctx* ctx)
+{
+  /*
+    Reduces x[0..m-1] modulo n in place; the result is left in x[0..k-1],
+    where k is the number of limbs in n.
+    Barrett reduction (Handbook of Applied Cryptography, algorithm 14.42)
+    needs x < b^(2k), so longer inputs are folded from the top in steps of
+    k limbs, reducing the top 2k limbs each time.
+
+    With mu = floor(b^(2k) / n):
+      q3 = floor(floor(x / b^(k-1)) * mu / b^(k+1))   -- at most 2 below floor(x / n)
+      r  = (x - q3 * n) mod b^(k+1)                   -- both terms truncated to k + 1 limbs
+    and then at most two subtractions of n.
+  */
+  const int k = ctx->nlimbs;
+  DTYPE q3[BN_ARRAY_SIZE + 1];
+  DTYPE r2[BN_ARRAY_SIZE + 1];
+  DTYPE nn[BN_ARRAY_SIZE + 1];
+  DTYPE* w;
+  int i;
+
+  for (i = 0; i < k; ++i)
+  {
+    nn[i] = ctx->n[i];
+  }
+  nn[k] = 0;
+
+  while (1)
+  {
+    /* Window of (at most) 2k limbs to reduce: the top of x */
+    if (m > 2 * k)
+    {
+      w = x + (m - (2 * k));
+    }
+    else
+    {
+      for (i = m; i < 2 * k; ++i)
+      {
+        x[i] = 0;
+      }
+      w = x;
+    }
+
+    /* q3 = high limbs k+1 .. 2k+1 of q1 * mu, q1 = w[k-1 .. 2k-1] -- the low ones are not summed */
+    _mul_high_words(q3, k + 1, w + (k - 1), k + 1, ctx->mu, k + 1, k + 1);
+
+    /* r2 = (q3 * n) mod b^(k+1), a low product; r = (w mod b^(k+1)) - r2 mod b^(k+1) */
+    _mul_words(r2, k + 1, q3, k + 1, nn, k);
+    _sub_words(w, w, r2, k + 1);
+
+    while ((w[k] != 0) || (_cmp_words(w, nn, k) != SMALLER))
+    {
+      w[k] -= _sub_words(w, w, nn, k);
+    }
+
+    if (w == x)
+    {
+      break;
+    }
+
+    /* The top 2k limbs are now a k-limb remainder -> x is k limbs shorter */
+    for (i = k; i < 2 * k; ++i)
+    {
+      w[i] = 0;
+    }
+    m -= k;
+  }
+}
+
+
+static int _cmp_words(DTYPE* a, DTYPE* b, int n)
+{
+  int i;
+  for (i = n - 1; i >= 0; --i)
+  {
+    if (a[i] > b[i])
+    {
+      return LARGER;
+    }
+    else if (a[i] < b[i])
+    {
+      return SMALLER;
+    }
+  }
+  return EQUAL;
+}
+
+
+static DTYPE _sub_words(DTYPE* r, DTYPE* a, DTYPE* b, int n)
+{
+  /* r = a - b over n limbs, returning the borrow out. r may alias a or b. */
+  DTYPE_TMP tmp;
+  DTYPE borrow = 0;
+  int i;
+  for (i = 0; i < n; ++i)
+  {
+    tmp = (DTYPE_TMP)a[i] - b[i] - borrow;
+    r[i] = (DTYPE)tmp;
+    borrow = ((tmp >> (8 * WORD_SIZE)) != 0);
+  }
+  return borrow;
+}
+
+
+static void _mulmod_words(DTYPE* r, DTYPE* x, DTYPE* y, DTYPE* v, int n, int s, DTYPE* prod)
+{
+  /*
+    r = x * y mod v, for n-limb operands below the modulus.
+    v must be normalized by s bits (see _norm_shift), prod needs 2n + 1 limbs
+    followed by WS_LONGMUL_NLIMBS of scratch.
+    r may alias x or y; x == y squares.
+  */
+  int i;
+  if (n >= LONGMUL_CUTOFF)
+  {
+    _mul_equal(prod, x, y, n, prod + (2 * n) + 1);
+  }
+  else if (x == y)
+  {
+    _sqr_words(prod, 2 * n, x, n);
+  }
+  else
+  {
+    _mul_words(prod, 2 * n, x, n, y, n);
+  }
+  _divmod_norm(NULL, prod, 2 * n, v, n, s);
+  for (i = 0; i < n; ++i)
+  {
+    r[i] = prod[i];
+  }
+}
+
+
+static int _test_bit(_TPtr<_T_bn> n, int bit)
+{
+  return (n->array[bit / (8 * WORD_SIZE)] >> (bit % (8 * WORD_SIZE))) & 1;
+}
+
+
+static int _load_limbs(DTYPE* dst, _TPtr<_T_bn> src, int pad)
+{
+  /* Copy the significant limbs of src into dst, zero-padded up to pad limbs, and return their number */
+  const int n = src->used;
+  int i;
+  for (i = 0; i < n; ++i)
+  {
+    dst[i] = src->array[i];
+  }
+  for (; i < pad; ++i)
+  {
+    dst[i] = 0;
+  }
+  return n;
+}
+
+
+static void _store_limbs(_TPtr<_T_bn> dst, DTYPE* src, int n)
+{
+  /* Copy src[0..n-1] into dst and zero its remaining limbs */
+  if (dst->array == NULL)
+  {
+    bignum_init(dst);
+  }
+  const int old_used = dst->used;
+  int i;
+  for (i = 0; i < n; ++i)
+  {
+    dst->array[i] = src[i];
+  }
+  _set_top(dst, n, old_used);
+}
+
+
+static void _set_top(_TPtr<_T_bn> n, int top, int old_used)
+{
+  /*
+    Finishes a result whose limbs at and above top are zero:
+    clears the limbs old_used..top-1 still left over from the previous value
+    and sets used to the number of significant limbs below top.
+  */
+  int i;
+  for (i = top; i < old_used; ++i)
+  {
+    n->array[i] = 0;
+  }
+  while ((top > 0) && (n->array[top - 1] == 0))
+  {
+    top -= 1;
+  }
+  n->used = top;
+}
+
+
+static int _used_words(DTYPE* a, int n)
+{
+  /* Number of significant limbs in a[0..n-1] */
+  while ((n > 0) && (a[n - 1] == 0))
+  {
+    n -= 1;
+  }
+  return n;
+}
+
+
+static int _norm_shift(DTYPE* v, int n)
+{
+  /* Algorithm D, step D1: shift v[0..n-1] left until its top bit is set, returning the shift */
+  const int nbits = (8 * WORD_SIZE);
+  DTYPE_TMP tmp;
+  int i;
+  int s = 0;
+  for (tmp = v[n - 1]; (tmp & DTYPE_MSB) == 0; tmp <<= 1)
+  {
+    s += 1;
+  }
+  if (s != 0)
+  {
+    for (i = n - 1; i > 0; --i)
+    {
+      v[i] = (v[i] << s) | (v[i - 1] >> (nbits - s));
+    }
+    v[0] <<= s;
+  }
+  return s;
+}
+
+
+static void _divmod_norm(DTYPE* q, DTYPE* u, int m, DTYPE* v, int n, int s)
+{
+  /*
+    Knuth, TAOCP vol. 2, section 4.3.1, Algorithm D, steps D1 (dividend part) to D8.
+
+    Divides u[0..m-1] by the divisor v[0..n-1] that _norm_shift() has
+    already shifted left by s bits. m >= n is required.
+    The quotient is written to q[0..m-n], unless q is NULL.
+    u must have room for m + 1 limbs. On return u[0..n-1] holds the remainder
+    and u[n..m] is zero. v is left untouched, so it can be reused.
+
+    Each quotient limb is estimated from the top two limbs of the running
+    remainder and the top limb of the divisor using DTYPE_TMP, corrected
+    with the second divisor limb, and is then off by at most one.
+  */
+  const int nbits = (8 * WORD_SIZE);
+  DTYPE_TMP num, qhat, rhat, prod, carry, tmp;
+  DTYPE borrow;
+  int i, j;
+
+  /* D1: shift the dividend by the same amount as the divisor */
+  u[m] = 0;
+  if (s != 0)
+  {
+    u[m] = u[m - 1] >> (nbits - s);
+    for (i = m - 1; i > 0; --i)
+    {
+      u[i] = (u[i] << s) | (u[i - 1] >> (nbits - s));
+    }
+    u[0] <<= s;
+  }
+
+  if (n == 1)
+  {
+    /* Single-limb divisor: plain short division */
+    rhat = u[m];
+    u[m] = 0;
+    for (j = m - 1; j >= 0; --j)
+    {
+      num = (rhat << nbits) | u[j];
+      qhat = num / v[0];
+      rhat = num - (qhat * v[0]);
+      if (q != NULL)
+      {
+        q[j] = (DTYPE)qhat;
+      }
+      u[j] = 0;
+    }
+    u[0] = (DTYPE)rhat;
+  }
+  else
+  {
+    for (j = m - n; j >= 0; --j)
+    {
+      /* D3: estimate quotient limb from the top two limbs */
+      num = ((DTYPE_TMP)u[j + n] << nbits) | u[j + n - 1];
+      qhat = num / v[n - 1];
+      rhat = num - (qhat * v[n - 1]);
+      while ((qhat > MAX_VAL) || ((qhat * v[n - 2]) > ((rhat << nbits) | u[j + n - 2])))
+      {
+        qhat -= 1;
+        rhat += v[n - 1];
+        if (rhat > MAX_VAL)
+        {
+          break;
+        }
+      }
+
+      /* D4: multiply and subtract, u[j..j+n] -= qhat * v */
+      carry = 0;
+      borrow = 0;
+      for (i = 0; i < n; ++i)
+      {
+        prod = (qhat * v[i]) + carry;
+        carry = prod >> nbits;
+        tmp = (DTYPE_TMP)u[i + j] - (DTYPE)prod - borrow;
+        u[i + j] = (DTYPE)tmp;
+        borrow = ((tmp >> nbits) != 0);
+      }
+      tmp = (DTYPE_TMP)u[j + n] - carry - borrow;
+      u[j + n] = (DTYPE)tmp;
+
+      /* D5, D6: estimate was one too large -> add the divisor back */
+      if ((tmp >> nbits) != 0)
+      {
+        qhat -= 1;
+        carry = 0;
+        for (i = 0; i < n; ++i)
+        {
+          tmp = (DTYPE_TMP)u[i + j] + v[i] + carry;
+          u[i + j] = (DTYPE)tmp;
+          carry = tmp >> nbits;
+        }
+        u[j + n] += (DTYPE)carry;
+      }
+
+      if (q != NULL)
+      {
+        q[j] = (DTYPE)qhat;
+      }
+    }
+  }
+
+  /* D8: unnormalize the remainder */
+  if (s != 0)
+  {
+    for (i = 0; i < n - 1; ++i)
+    {
+      u[i] = (u[i] >> s) | (u[i + 1] << (nbits - s));
+    }
+    u[n - 1] >>= s;
+  }
+}
+
+
+static void _divmod_words(DTYPE* q, DTYPE* u, int m, DTYPE* v, int n)
+{
+  /*
+    Divides u[0..m-1] by v[0..n-1], where v[n-1] != 0 and m >= n.
+    The quotient is written to q[0..m-n], unless q is NULL.
+    u must have room for m + 1 limbs. On return u[0..n-1] holds the remainder
+    and u[n..m] is zero. v is clobbered.
+  */
+  int s = _norm_shift(v, n);
+  _divmod_norm(q, u, m, v, n, s);
+}
+
+
+static void _divmod(_TPtr<_T_bn> a, _TPtr<_T_bn> b, _TPtr<_T_bn> c, _TPtr<_T_bn> d, DTYPE* scratch)
+{
+  /*
+    c = a / b and d = a % b from a single pass of Algorithm D.
+    Either c or d may be NULL, in which case that output is skipped.
+    a and b are copied up front, so c and d may alias them.
+    scratch needs WS_DIVMOD_NLIMBS limbs.
+  */
+  DTYPE* u = scratch;                 /* dividend - one extra limb for normalization */
+  DTYPE* v = u + BN_ARRAY_SIZE + 1;   /* divisor */
+  DTYPE* q = v + BN_ARRAY_SIZE;       /* quotient */
+
+  int m = _load_limbs(u, a, 0); /* number of significant limbs in a */
+  int n = _load_limbs(v, b, 0); /* number of significant limbs in b */
+  require(n > 0, "division by zero");
+
+  /* If a has fewer limbs than b, the quotient is zero and the remainder is a */
+  int nq = 0;
+  int nr = m;
+  if ((n > 0) && (m >= n))
+  {
+    _divmod_words((c != NULL) ? q : NULL, u, m, v, n);
+    nq = m - n + 1;
+    nr = n;
+  }
+
+  if (c != NULL)
+  {
+    _store_limbs(c, q, nq);
+  }
+  if (d != NULL)
   {
-    a->array[i] = (a->array[i] >> 1) | (a->array[i + 1] << ((8 * WORD_SIZE) - 1));
+    _store_limbs(d, u, nr);
   }
-  a->array[BN_ARRAY_SIZE - 1] >>= 1;
 }
 
 
@@ -21,6 +21,8 @@ There may well be room for performance-optimizations and improvements.
 */
 
 #include <stdint.h>
+#include <stddef.h>
+#include <inttypes.h>
 #include <assert.h>
 #include <stdlib_tainted.h>
 #include <string_tainted.h>
@@ -31,24 +33,63 @@ There may well be room for performance-optimizations and improvements.
   #define WORD_SIZE 4
 #endif
 
-/* Size of big-numbers in bytes */
-#define BN_ARRAY_SIZE    (128 / WORD_SIZE)
+/* Size of big-numbers in limbs: 1024 bits by default, e.g. -DBN_ARRAY_SIZE="(512 / WORD_SIZE)" for 4096 */
+#ifndef BN_ARRAY_SIZE
+  #define BN_ARRAY_SIZE  (128 / WORD_SIZE)
+#endif
+
+/* Alignment of the single block bignum_new() allocates */
+#ifndef BN_CACHE_LINE
+  #define BN_CACHE_LINE  64
+#endif
 
 #ifdef WASM_SBX
-#define __malloc__(S) t_malloc(S)
-#define __free__(S) t_free(S)
+#define __sbx_malloc__(S) t_malloc(S)
+#define __sbx_free__(S) t_free(S)
 #elif HEAP_SBX
-#define __malloc__(S) hoard_malloc(S)
-#define __free__(S) hoard_free(S)
+#define __sbx_malloc__(S) hoard_malloc(S)
+#define __sbx_free__(S) hoard_free(S)
+#else
+#define __sbx_malloc__(S) malloc(S)
+#define __sbx_free__(S) free(S)
+#endif
+
+/* Bignum headers and limb arrays -- whatever bignum_init, bignum_new and bignum_free     */
+/* allocate or release -- go through __bn_malloc__ / __bn_free__. Sandboxed builds take   */
+/* them from per-thread free lists, see bignum_pool_malloc(); define BN_NO_POOL to go      */
+/* straight to the sandbox heap instead. Any other buffer stays with __malloc__ / __free__. */
+#if (defined(WASM_SBX) || defined(HEAP_SBX)) && !defined(BN_NO_POOL)
+#define BN_POOL
+#define __pool_malloc__(S) bignum_pool_malloc(S)
+#define __pool_free__(S) bignum_pool_free(S)
 #else
-#define __malloc__(S) malloc(S)
-#define __free__(S) free(S)
+#define __pool_malloc__(S) __sbx_malloc__(S)
+#define __pool_free__(S) __sbx_free__(S)
+#endif
+
+/* With BN_INSTRUMENT every heap call is counted, see bignum_instr_dump() */
+#ifdef BN_INSTRUMENT
+#define __malloc__(S) (bignum_instr_count(BN_INSTR_MALLOC, (S)), __sbx_malloc__(S))
+#define __free__(S) (bignum_instr_count(BN_INSTR_FREE, 0), __sbx_free__(S))
+#define __bn_malloc__(S) (bignum_instr_count(BN_INSTR_MALLOC, (S)), __pool_malloc__(S))
+#define __bn_free__(S) (bignum_instr_count(BN_INSTR_FREE, 0), __pool_free__(S))
+#else
+#define __malloc__(S) __sbx_malloc__(S)
+#define __free__(S) __sbx_free__(S)
+#define __bn_malloc__(S) __pool_malloc__(S)
+#define __bn_free__(S) __pool_free__(S)
+#endif
+
+/* Slots carved from the sandbox heap per free-list refill */
+#ifndef BN_POOL_REFILL
+  #define BN_POOL_REFILL 32
 #endif
 
 /* Here comes the compile-time specialization for how large the underlying array size should be. */
-/* The choices are 1, 2 and 4 bytes in size with uint32, uint64 for WORD_SIZE==4, as temporary. */
+/* The choices are 1, 2, 4 and 8 bytes in size with uint32, uint64 for WORD_SIZE==4 and */
+/* the GCC/Clang extension unsigned __int128 for WORD_SIZE==8, as temporary. */
 #ifndef WORD_SIZE
-  #error Must define WORD_SIZE to be 1, 2, 4
+  #error Must define WORD_SIZE to be 1, 2, 4 or 8
 #elif (WORD_SIZE == 1)
   /* Data type of array in structure */
   #define DTYPE                    uint8_t
@@ -75,6 +116,13 @@ There may well be room for performance-optimizations and improvements.
   #define SPRINTF_FORMAT_STR       "%.08x"
   #define SSCANF_FORMAT_STR        "%8x"
   #define MAX_VAL                  ((DTYPE_TMP)0xFFFFFFFF)
+#elif (WORD_SIZE == 8)
+  #define DTYPE                    uint64_t
+  #define DTYPE_TMP                unsigned __int128
+  #define DTYPE_MSB                ((DTYPE_TMP)(0x8000000000000000))
+  #define SPRINTF_FORMAT_STR       "%.016" PRIx64
+  #define SSCANF_FORMAT_STR        "%16" SCNx64
+  #define MAX_VAL                  ((DTYPE_TMP)0xFFFFFFFFFFFFFFFF)
 #endif
 #ifndef DTYPE
   #error DTYPE must be defined to uint8_t, uint16_t uint32_t or whatever
@@ -86,14 +134,154 @@ There may well be room for performance-optimizations and improvements.
 
 _TLIB void w2c_bignum_to_string(void*, unsigned int, unsigned int, int);
 
+
+/* Optional instrumentation (BN_INSTRUMENT: heap calls and tainted-memory operations),   */
+/* profiling (BN_PROFILE: cycles) and tracing (BN_TRACE: calls with their operands), all  */
+/* broken down per public function. They are compiled out unless their flag is given.     */
+#if defined(BN_INSTRUMENT) || defined(BN_PROFILE) || defined(BN_TRACE)
+#include <stdio.h>
+#endif
+
+/* Public functions the counters are broken down by -- new entry points go at the end, */
+/* trace files store these numbers                                                     */
+#define BN_FUNCTIONS(X) \
+  X(init) X(normalize) X(new) X(free) X(from_int) X(to_int) X(from_string) X(to_string) \
+  X(dec) X(inc) X(add) X(sub) X(mul) X(mul_ws) X(div) X(div_ws) X(mod) X(mod_ws)       \
+  X(divmod) X(divmod_ws) X(lshift) X(rshift) X(and) X(or) X(xor) X(cmp) X(is_zero)      \
+  X(pow) X(pow_ws) X(powmod) X(powmod_ws) X(isqrt) X(isqrt_ws) X(assign) X(ws_size)     \
+  X(mont_init) X(to_mont) X(from_mont) X(mont_mul)                                      \
+  X(barrett_init) X(barrett_reduce) X(barrett_mulmod) X(mul_limbs) X(mul_limbs_ws_size) \
+  X(sqr) X(sqr_ws) X(mul_full) X(mul_full_ws) X(mul_low) X(mul_low_ws) X(mul_high) X(mul_high_ws)
+
+/* Rows of a snapshot or profile: BN_FN_OUTSIDE, then one per function, e.g. BN_FN_powmod */
+enum
+{
+  BN_FN_OUTSIDE,           /* the application's own calls, outside any bignum_ function */
+#define BN_FN_ENUM(name) BN_FN_##name,
+  BN_FUNCTIONS(BN_FN_ENUM)
+#undef BN_FN_ENUM
+  BN_FN_COUNT
+};
+
+#ifdef BN_INSTRUMENT
+/* Columns of a snapshot */
+enum
+{
+  BN_INSTR_MALLOC,         /* __malloc__ calls */
+  BN_INSTR_FREE,           /* __free__ calls */
+  BN_INSTR_BYTES,          /* bytes requested from __malloc__ */
+  BN_INSTR_MEMSET,         /* t_memset calls */
+  BN_INSTR_SPRINTF,        /* t_sprintf calls */
+  BN_INSTR_W2C,            /* w2c_* calls into the WASM sandbox */
+  BN_INSTR_NCOUNTERS
+};
+
+/* Counters of one thread. Work is charged to the outermost bignum_ function */
+/* running, i.e. the call the application made; calls counts nested ones too. */
+typedef struct bn_instr_snapshot
+{
+  unsigned long calls[BN_FN_COUNT];
+  unsigned long count[BN_FN_COUNT][BN_INSTR_NCOUNTERS];
+} bn_instr_snapshot;
+
+#define t_memset(P, C, N) (bignum_instr_count(BN_INSTR_MEMSET, 0), t_memset(P, C, N))
+#define t_sprintf(...) (bignum_instr_count(BN_INSTR_SPRINTF, 0), t_sprintf(__VA_ARGS__))
+#define w2c_bignum_to_string(...) (bignum_instr_count(BN_INSTR_W2C, 0), w2c_bignum_to_string(__VA_ARGS__))
+#endif /* BN_INSTRUMENT */
+
+#ifdef BN_PROFILE
+/* Latency histogram: bucket i counts calls that took [2^i, 2^(i+1)) cycles */
+#define BN_PROF_NBUCKETS 40
+
+typedef struct bn_prof_entry
+{
+  unsigned long long calls;
+  unsigned long long cycles;        /* inclusive: time spent in the function and everything it called */
+  unsigned long long self_cycles;   /* exclusive: minus the time spent in nested bignum_ functions */
+  unsigned long long hist[BN_PROF_NBUCKETS];
+} bn_prof_entry;
+
+/* One thread's profile, or several merged */
+typedef struct bn_prof_table
+{
+  bn_prof_entry fn[BN_FN_COUNT];
+} bn_prof_table;
+#endif /* BN_PROFILE */
+
+/*
+  Trace file: BN_TRACE_MAGIC, one byte WORD_SIZE of the build that recorded it, then
+  the records oldest first. All fields little endian:
+
+    u16 size       bytes in the record, these included
+    u8  fn         BN_FN_add etc.
+    u8  noperands
+    i32 arg        shift count of lshift / rshift, 0 otherwise
+    noperands times: u16 nbytes, then the number's nbytes bytes, least significant first
+
+  Operands are the inputs in argument order; calls with a Montgomery or Barrett context
+  record its modulus first. bench/replay.c runs a trace against the current build.
+*/
+#define BN_TRACE_MAGIC   "BNTRACE1"
+#define BN_TRACE_RECORD  8     /* bytes before the first operand */
+
+/* Bytes of each thread's ring buffer -- when it is full the oldest records are dropped */
+#if defined(BN_TRACE) && !defined(BN_TRACE_SIZE)
+  #define BN_TRACE_SIZE (1 << 20)
+#endif
+
 /* Data-holding structure: array of DTYPEs */
+/* Limbs at index used and above are always zero; code that writes array[] */
+/* directly must call bignum_normalize() before passing the number on.     */
+/* bignum_new() puts header and limbs in one block, array then points into it. */
 _Tainted typedef Tstruct bn
 {
   _TPtr<DTYPE> array;
+  int used;            /* number of significant limbs */
+  _TPtr<char> block;   /* allocation holding header and limbs, NULL unless made by bignum_new() */
 }_T_bn;
 //gotta malloc this --> [BN_ARRAY_SIZE]
 
 
+/* Montgomery context for repeated arithmetic modulo the same odd number n */
+typedef struct bn_mont
+{
+  DTYPE n[BN_ARRAY_SIZE];  /* modulus */
+  DTYPE rr[BN_ARRAY_SIZE]; /* R^2 mod n, where R = 2^(8 * WORD_SIZE * nlimbs) */
+  DTYPE n0inv;             /* -n^-1 mod 2^(8 * WORD_SIZE) */
+  int nlimbs;              /* number of significant limbs in n */
+} bn_mont_ctx;
+
+
+/* Barrett context for reducing modulo n without division */
+typedef struct bn_barrett
+{
+  DTYPE n[BN_ARRAY_SIZE];      /* modulus */
+  DTYPE mu[BN_ARRAY_SIZE + 1]; /* floor(b^(2 * nlimbs) / n), where b = 2^(8 * WORD_SIZE) */
+  int nlimbs;                  /* number of significant limbs in n */
+} bn_barrett_ctx;
+
+
+/* Caller-supplied scratch memory for the _ws functions, so they never allocate */
+typedef struct bn_ws
+{
+  DTYPE* limbs; /* at least bignum_ws_size() bytes */
+  size_t size;  /* size of limbs in bytes */
+} bn_ws;
+
+
+/* Per-thread counters of the bignum pool, see bignum_pool_stats(). A slot freed on another */
+/* thread than the one that allocated it counts against the freeing thread, so in_use and   */
+/* high_water only add up when each thread frees its own numbers.                          */
+typedef struct bn_pool_stats
+{
+  unsigned long hits;       /* allocations served straight from a free list */
+  unsigned long refills;    /* bulk allocations of BN_POOL_REFILL slots from the sandbox heap */
+  unsigned long large;      /* requests too big for any slot, passed on to the sandbox heap */
+  long in_use;              /* slots handed out minus slots freed, on this thread */
+  long high_water;          /* largest in_use seen */
+} bn_pool_stats;
+
+
 /* Tokens returned by bignum_cmp() for value comparison */
 enum { SMALLER = -1, EQUAL = 0, LARGER = 1 };
 
@@ -101,19 +289,57 @@ enum { SMALLER = -1, EQUAL = 0, LARGER = 1 };
 
 /* Initialization functions: */
 void bignum_init(_TPtr<_T_bn> n);
+_TPtr<_T_bn> bignum_new(void);         /* Zero-valued bignum, header and limbs in one cache-line aligned allocation */
+void bignum_free(_TPtr<_T_bn> n);      /* Release a bignum_new() number, or a __bn_malloc__'ed header with its limbs */
+
+/* Pool behind __bn_malloc__ / __bn_free__ when BN_POOL is defined: */
+_TPtr<void> bignum_pool_malloc(size_t size);    /* Slot from the calling thread's free list, refilled in bulk */
+void bignum_pool_free(_TPtr<void> p);           /* Push p, from bignum_pool_malloc(), onto the calling thread's free list */
+void bignum_pool_stats(bn_pool_stats* stats);   /* Counters of the calling thread */
+
+#ifdef BN_INSTRUMENT
+/* Instrumentation, all per calling thread: */
+void bignum_instr_count(int counter, size_t bytes);     /* Count one event, bytes go to BN_INSTR_BYTES */
+void bignum_instr_snapshot(bn_instr_snapshot* snap);    /* Copy of the counters so far */
+void bignum_instr_reset(void);                          /* Zero all counters */
+const char* bignum_instr_name(int fn);                  /* "bignum_powmod" for BN_FN_powmod etc. */
+void bignum_instr_dump(FILE* out);                      /* Counters as JSON, functions with no activity left out */
+#endif
+
+#ifdef BN_PROFILE
+/* Profiling -- every thread records into its own table, merged on demand: */
+void bignum_prof_merge(bn_prof_table* out);                 /* Sum of the tables of all threads so far */
+void bignum_prof_reset(void);                               /* Zero all tables -- while other threads are idle */
+void bignum_prof_dump(FILE* out, const bn_prof_table* t);   /* Report sorted by self cycles */
+#endif
+
+#ifdef BN_TRACE
+/* Tracing of the calls the application makes, per calling thread: */
+void bignum_trace_reset(void);                  /* Empty the ring buffer */
+unsigned long bignum_trace_count(void);         /* Records in the ring buffer */
+unsigned long bignum_trace_dropped(void);       /* Records overwritten since the last reset */
+unsigned long bignum_trace_dump(FILE* out);     /* Write the ring buffer as a trace file, returns the records written */
+#endif
 void bignum_from_int(_TPtr<_T_bn> n, DTYPE_TMP i);
 int  bignum_to_int(_TPtr<_T_bn> n);
 void bignum_from_string(_TPtr<_T_bn> n, char* str, int nbytes);
+void bignum_normalize(_TPtr<_T_bn> n); /* Recompute n->used after writing n->array directly */
 _Tainted void bignum_to_string(_TPtr<_T_bn> n, _TPtr<char> str, int maxsize);
 
 /* Basic arithmetic operations: */
 void bignum_add(_TPtr<_T_bn> a, _TPtr<_T_bn> b, _TPtr<_T_bn> c); /* c = a + b */
 void bignum_sub(_TPtr<_T_bn> a, _TPtr<_T_bn> b, _TPtr<_T_bn> c); /* c = a - b */
 void bignum_mul(_TPtr<_T_bn> a, _TPtr<_T_bn> b, _TPtr<_T_bn> c); /* c = a * b */
+void bignum_sqr(_TPtr<_T_bn> a, _TPtr<_T_bn> b);                 /* b = a * a, cheaper than bignum_mul(a, a, b) */
 void bignum_div(_TPtr<_T_bn> a, _TPtr<_T_bn> b, _TPtr<_T_bn> c); /* c = a / b */
 void bignum_mod(_TPtr<_T_bn> a, _TPtr<_T_bn> b, _TPtr<_T_bn> c); /* c = a % b */
 void bignum_divmod(_TPtr<_T_bn> a, _TPtr<_T_bn> b, _TPtr<_T_bn> c, _TPtr<_T_bn> d); /* c = a/b, d = a%b */
 
+/* Parts of the double-width product, B = 2^(8 * WORD_SIZE) -- bignum_mul keeps the low BN_ARRAY_SIZE limbs: */
+void bignum_mul_full(_TPtr<_T_bn> a, _TPtr<_T_bn> b, _TPtr<_T_bn> lo, _TPtr<_T_bn> hi); /* (hi:lo) = a * b, nothing dropped */
+void bignum_mul_low(_TPtr<_T_bn> a, _TPtr<_T_bn> b, _TPtr<_T_bn> c, int nlimbs);        /* c = a * b mod B^nlimbs */
+void bignum_mul_high(_TPtr<_T_bn> a, _TPtr<_T_bn> b, _TPtr<_T_bn> c, int nlimbs);       /* c = a * b / B^nlimbs */
+
 /* Bitwise operations: */
 void bignum_and(_TPtr<_T_bn> a, _TPtr<_T_bn> b, _TPtr<_T_bn> c); /* c = a & b */
 void bignum_or(_TPtr<_T_bn> a, _TPtr<_T_bn> b, _TPtr<_T_bn> c);  /* c = a | b */
@@ -127,9 +353,39 @@ int  bignum_is_zero(_TPtr<_T_bn> n);                         /* For comparison w
 void bignum_inc(_TPtr<_T_bn> n);                             /* Increment: add one to n */
 void bignum_dec(_TPtr<_T_bn> n);                             /* Decrement: subtract one from n */
 void bignum_pow(_TPtr<_T_bn> a, _TPtr<_T_bn> b, _TPtr<_T_bn> c); /* Calculate a^b -- e.g. 2^10 => 1024 */
+void bignum_powmod(_TPtr<_T_bn> a, _TPtr<_T_bn> b, _TPtr<_T_bn> n, _TPtr<_T_bn> c); /* Calculate a^b mod n -- e.g. 4^13 mod 497 => 445 */
 void bignum_isqrt(_TPtr<_T_bn> a, _TPtr<_T_bn> b);             /* Integer square root -- e.g. isqrt(5) => 2*/
 void bignum_assign(_TPtr<_T_bn> dst, _TPtr<_T_bn> src);        /* Copy src into dst -- dst := src */
 
+/* Montgomery arithmetic -- modulus must be odd, operands of mont_mul must be below n: */
+void bignum_mont_init(bn_mont_ctx* ctx, _TPtr<_T_bn> n);                          /* Precompute context for modulus n */
+void bignum_to_mont(bn_mont_ctx* ctx, _TPtr<_T_bn> a, _TPtr<_T_bn> b);            /* b = a * R mod n */
+void bignum_from_mont(bn_mont_ctx* ctx, _TPtr<_T_bn> a, _TPtr<_T_bn> b);          /* b = a / R mod n */
+void bignum_mont_mul(bn_mont_ctx* ctx, _TPtr<_T_bn> a, _TPtr<_T_bn> b, _TPtr<_T_bn> c); /* c = a * b / R mod n */
+
+/* Barrett reduction -- any non-zero modulus: */
+void bignum_barrett_init(bn_barrett_ctx* ctx, _TPtr<_T_bn> n);                             /* Precompute context for modulus n */
+void bignum_barrett_reduce(bn_barrett_ctx* ctx, _TPtr<_T_bn> lo, _TPtr<_T_bn> hi, _TPtr<_T_bn> r); /* r = (hi:lo) mod n, hi may be NULL */
+void bignum_barrett_mulmod(bn_barrett_ctx* ctx, _TPtr<_T_bn> a, _TPtr<_T_bn> b, _TPtr<_T_bn> c);   /* c = a * b mod n */
+
+/* Workspace variants -- same results, all scratch taken from ws (the plain versions use the stack): */
+size_t bignum_ws_size(void);                                                        /* Bytes of scratch ws->limbs needs */
+void bignum_mul_ws(_TPtr<_T_bn> a, _TPtr<_T_bn> b, _TPtr<_T_bn> c, bn_ws* ws);                  /* c = a * b */
+void bignum_sqr_ws(_TPtr<_T_bn> a, _TPtr<_T_bn> b, bn_ws* ws);                                  /* b = a * a */
+void bignum_mul_full_ws(_TPtr<_T_bn> a, _TPtr<_T_bn> b, _TPtr<_T_bn> lo, _TPtr<_T_bn> hi, bn_ws* ws); /* (hi:lo) = a * b */
+void bignum_mul_low_ws(_TPtr<_T_bn> a, _TPtr<_T_bn> b, _TPtr<_T_bn> c, int nlimbs, bn_ws* ws);  /* c = a * b mod B^nlimbs */
+void bignum_mul_high_ws(_TPtr<_T_bn> a, _TPtr<_T_bn> b, _TPtr<_T_bn> c, int nlimbs, bn_ws* ws); /* c = a * b / B^nlimbs */
+void bignum_div_ws(_TPtr<_T_bn> a, _TPtr<_T_bn> b, _TPtr<_T_bn> c, bn_ws* ws);                  /* c = a / b */
+void bignum_mod_ws(_TPtr<_T_bn> a, _TPtr<_T_bn> b, _TPtr<_T_bn> c, bn_ws* ws);                  /* c = a % b */
+void bignum_divmod_ws(_TPtr<_T_bn> a, _TPtr<_T_bn> b, _TPtr<_T_bn> c, _TPtr<_T_bn> d, bn_ws* ws); /* c = a/b, d = a%b */
+void bignum_pow_ws(_TPtr<_T_bn> a, _TPtr<_T_bn> b, _TPtr<_T_bn> c, bn_ws* ws);                  /* c = a^b */
+void bignum_powmod_ws(_TPtr<_T_bn> a, _TPtr<_T_bn> b, _TPtr<_T_bn> n, _TPtr<_T_bn> c, bn_ws* ws); /* c = a^b mod n */
+void bignum_isqrt_ws(_TPtr<_T_bn> a, _TPtr<_T_bn> b, bn_ws* ws);                                /* b = isqrt(a) */
+
+/* Variable-length view -- a and b are plain limb arrays of any length, least significant limb first: */
+size_t bignum_mul_limbs_ws_size(int na, int nb);                                   /* Bytes of scratch bignum_mul_limbs needs */
+void bignum_mul_limbs(DTYPE* r, DTYPE* a, int na, DTYPE* b, int nb, bn_ws* ws);    /* r[0..na+nb-1] = a * b */
+
 
 #endif /* #ifndef __BIGNUM_H__ */
 
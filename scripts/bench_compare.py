@@ -0,0 +1,67 @@
+"""
+
+Puts the JSON results of several bench_ops runs side by side.
+
+  python scripts/bench_compare.py baseline.json other.json [...]
+
+The first file is the baseline: for every operation and operand size the
+other runs are shown as ns/op and as a ratio to it, and the last line has the
+geometric mean of the ratios per run. Results marked unstable by the harness
+are flagged with a '*'.
+
+"""
+
+from __future__ import print_function
+
+import json
+import math
+import sys
+
+
+def load(path):
+  with open(path) as f:
+    run = json.load(f)
+  label = run["sandbox"]
+  if label == "none":
+    label = "malloc"
+  results = dict(((r["op"], r["bits"]), r) for r in run["results"])
+  order = [(r["op"], r["bits"]) for r in run["results"]]
+  return label, results, order
+
+
+def fmt_ns(r):
+  return "%.1f%s" % (r["ns_per_op"], "" if r["stable"] else "*")
+
+
+if __name__ == "__main__":
+  if len(sys.argv) < 3:
+    print("usage: %s baseline.json other.json [...]" % sys.argv[0])
+    sys.exit(1)
+
+  runs = [load(path) for path in sys.argv[1:]]
+  base_label, base, order = runs[0]
+
+  header = "  %-16s %5s %12s" % ("operation", "bits", base_label)
+  for label, _, _ in runs[1:]:
+    header += " %12s %8s" % (label, "x")
+  print()
+  print(header)
+
+  logs = [[] for _ in runs[1:]]
+  for key in order:
+    line = "  %-16s %5d %12s" % (key[0], key[1], fmt_ns(base[key]))
+    for i, (label, results, _) in enumerate(runs[1:]):
+      if key in results:
+        ratio = results[key]["ns_per_op"] / base[key]["ns_per_op"]
+        logs[i].append(math.log(ratio))
+        line += " %12s %7.2fx" % (fmt_ns(results[key]), ratio)
+      else:
+        line += " %12s %8s" % ("-", "")
+    print(line)
+
+  line = "  %-16s %5s %12s" % ("geometric mean", "", "")
+  for i in range(len(runs) - 1):
+    if logs[i]:
+      line += " %12s %7.2fx" % ("", math.exp(sum(logs[i]) / len(logs[i])))
+  print(line)
+  print()
@@ -0,0 +1,104 @@
+"""
+
+Performance regression gate for `make perfcheck`.
+
+  python scripts/perfcheck.py baseline.json current.json [tolerance] [op=tolerance ...]
+
+Compares the median ns/op of every operation and operand size in current.json
+(written by bench_ops) with the checked-in baseline. An operation regresses
+when it is slower than the baseline by more than its tolerance, in percent:
+the default one, or the one given for it as op=tolerance. Differences below
+NOISE_NS are ignored, the cheapest operations take only a few ns. Exits with 1
+and a table of the regressions if there are any.
+
+`make perfcheck-baseline` refreshes the baseline from a new run.
+
+"""
+
+from __future__ import print_function
+
+import json
+import os
+import sys
+
+
+NOISE_NS = 1.0
+
+
+def load(path):
+  with open(path) as f:
+    return json.load(f)
+
+
+def median(r):
+  # Results from before the harness recorded medians
+  return r.get("median_ns", r["ns_per_op"])
+
+
+if __name__ == "__main__":
+  if len(sys.argv) < 3:
+    print("usage: %s baseline.json current.json [tolerance] [op=tolerance ...]" % sys.argv[0])
+    sys.exit(2)
+
+  baseline_path = sys.argv[1]
+  if not os.path.exists(baseline_path):
+    print("\nNo baseline at %s -- run `make perfcheck-baseline` on the reference machine and check it in.\n" % baseline_path)
+    sys.exit(1)
+
+  baseline = load(baseline_path)
+  current = load(sys.argv[2])
+
+  tolerance = 10.0
+  per_op = {}
+  for arg in sys.argv[3:]:
+    if "=" in arg:
+      op, value = arg.split("=", 1)
+      per_op[op] = float(value)
+    else:
+      tolerance = float(arg)
+
+  for key in ("word_size", "bn_array_size", "sandbox"):
+    if baseline[key] != current[key]:
+      print("\nBaseline was made with %s = %s, this run has %s -- refresh it with `make perfcheck-baseline`.\n"
+            % (key, baseline[key], current[key]))
+      sys.exit(1)
+
+  reference = dict(((r["op"], r["bits"]), r) for r in baseline["results"])
+
+  regressions = []
+  improvements = []
+  missing = []
+  for r in current["results"]:
+    key = (r["op"], r["bits"])
+    if key not in reference:
+      missing.append(key)
+      continue
+    before = median(reference[key])
+    after = median(r)
+    change = 100.0 * (after - before) / before
+    limit = per_op.get(r["op"], tolerance)
+    row = (r["op"], r["bits"], before, after, change, limit, r["stable"])
+    if abs(after - before) < NOISE_NS:
+      continue
+    if change > limit:
+      regressions.append(row)
+    elif change < -limit:
+      improvements.append(key)
+
+  def table(title, rows):
+    print("\n%s\n" % title)
+    print("  %-16s %5s %14s %14s %9s %9s" % ("operation", "bits", "baseline ns", "now ns", "change", "allowed"))
+    for op, bits, before, after, change, limit, stable in rows:
+      print("  %-16s %5d %14.1f %14.1f %+8.1f%% %8.0f%%%s"
+            % (op, bits, before, after, change, limit, "" if stable else "  (not stable)"))
+
+  if improvements:
+    print("\nFaster than the baseline, consider `make perfcheck-baseline`: %s" % ", ".join("%s/%d" % key for key in improvements))
+  if missing:
+    print("\nNot in the baseline: %s" % ", ".join("%s/%d" % key for key in missing))
+  if regressions:
+    table("REGRESSIONS:", regressions)
+    print("\n%d of %d measurements slower than allowed.\n" % (len(regressions), len(current["results"])))
+    sys.exit(1)
+
+  print("\nperfcheck: %d measurements within tolerance of %s.\n" % (len(current["results"]), baseline_path))
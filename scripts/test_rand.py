@@ -9,26 +9,26 @@
 #
 # In effect, this verifies the C implementation against Python's
 #
+# All cases are piped through a single test_random process in batch mode,
+# failing ones are reported as they come back and logged to error_log.txt.
+#
 #
 
+from __future__ import print_function
 
-from random import Random, choice
+from random import Random
 import subprocess
+import threading
 import sys
 import os
 import math
+import time
 
 
 TEST_BINARY = "./build/test_random"
 
-
-def run_shell(runthis):
-    """ Helper, runs a command string as if given to the shell """
-    #print("trying to run '%s'" % runthis)
-    osstdout = subprocess.Popen(runthis, shell=True, stdin=subprocess.PIPE, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, close_fds=True)
-    theInfo = osstdout.communicate()[0].strip()
-    #return (theInfo, osstdout.returncode)
-    return osstdout.returncode
+# Cases written to the pipe per write
+CHUNK = 10000
 
 
 # Check for command-line arguments - default to 100 tests
@@ -55,22 +55,22 @@ NUM_OPERATIONS = 12 # this variable should be 1 larger than the last supported o
 # Instantiate object of Random-class for choosing an operand and two operators
 rand = Random()
 
-# List of command-strings leading to failures - expected to be empty if no bugs are triggered
-failures = list()
 
-print("\nRunning %d random tests (parsed using from_string):\n" % NTESTS)
+def hex16(x):
+  """ Hex string zero-padded to a multiple of 16 characters, as bignum_from_string wants for every WORD_SIZE """
+  s = "%x" % x
+  return "0" * (-len(s) % 16) + s
 
-# Iterate NTESTS times
-i = 0
-while i < NTESTS:
-  i += 1
+
+def make_case():
+  """ One 'oper operand1 operand2 expected' line """
   # Choose random operand
   while 1:
-    operation = choice(range(NUM_OPERATIONS))
+    operation = rand.randrange(NUM_OPERATIONS)
     if operation != POW:
       break
 
-  expected = 0      
+  expected = 0
 
   # Generate two large operators
   if operation in [LSHIFT, RSHIFT]:
@@ -87,21 +87,17 @@ while i < NTESTS:
     # bignum only supports unsigned, so if B > A
     # we swap operands to avoid the underflow / wrap-around
     if oper2 > oper1:
-      tmp = oper1
-      oper1 = oper2
-      oper2 = tmp
+      oper1, oper2 = oper2, oper1
     expected = oper1 - oper2
   elif operation == MUL:
     expected = oper1 * oper2
   elif operation == DIV:
     if oper2 > oper1:
-      tmp = oper1
-      oper1 = oper2
-      oper2 = tmp
+      oper1, oper2 = oper2, oper1
     # avoid dividing by 0
     if oper2 == 0:
       oper2 += 1
-    expected = oper1 / oper2
+    expected = oper1 // oper2
   elif operation == AND:
     expected = oper1 & oper2
   elif operation == OR:
@@ -120,57 +116,62 @@ while i < NTESTS:
   elif operation == RSHIFT:
     expected = oper1 >> oper2
   elif operation == ISQRT:
-		expected = int(math.sqrt(oper1));
-
-
-  # Convert to string to pass to C program
-  # NOTE: bignum_from_string requires hex format and even no. of chars in str
-  oper1 = "%.0x" % oper1
-  oper2 = "%.0x" % oper2
-  expected = "%.0x" % expected
-
-  # bignum_from_string requires string-length to be an even number
-  # so we zero-pad the number if the length is an odd number of bytes
-  while (len(oper1) & 15) != 0:
-    oper1 = "0" + oper1
-  while (len(oper2) & 15) != 0:
-    oper2 = "0" + oper2
-  while (len(expected) & 15) != 0:
-    expected = "0" + expected
-
-  # Create the command-string to run in shell
-  cmd_string = "%s %s %s %s %s" % (TEST_BINARY, operation, oper1, oper2, expected)
-  if len([e for e in cmd_string.split(" ") if e]) < 5:
-    # something has gone wrong with making the command-string - abort and retry
-    i -= 1
-    continue 
-  
-
-  # Expect return code to be ZERO for successful comparison
-  success = (0 == run_shell(cmd_string))
-
-  # Add command-string to list in case of failure
-  # this allowis the user to re-create the failure
-  if not success:
-    failures.append(cmd_string)
-    sys.stdout.write("x")
-    try:
-      f = open("error_log.txt", "a+")
-      f.write(cmd_string + os.linesep)
-      f.close()
-    except:
-      import traceback
-      print("\n\nEXCEPTION:\n\n" + traceback.format_exc())
-  else:
-   sys.stdout.write(".")
-   sys.stdout.flush()
-    
+    expected = int(math.sqrt(oper1))
+
+  return "%d %s %s %s" % (operation, hex16(oper1), hex16(oper2), hex16(expected))
+
+
+# List of command-strings leading to failures - expected to be empty if no bugs are triggered
+failures = list()
+summary = list()
 
-sys.stdout.write("\n")
+
+def read_results(stream):
+  """ Collects failing cases and the summary line from test_random's output """
+  for line in stream:
+    if line.startswith("FAIL line "):
+      # "FAIL line N: oper a b expected" -> command line that re-runs the case
+      cmd_string = "%s %s" % (TEST_BINARY, line.split(":", 1)[1].strip())
+      failures.append(cmd_string)
+      sys.stdout.write("x")
+      sys.stdout.flush()
+    elif "cases passed" in line:
+      summary.append(line.strip())
+
+
+print("\nRunning %d random tests (parsed using from_string):\n" % NTESTS)
+
+start = time.time()
+proc = subprocess.Popen([TEST_BINARY, "-"], stdin=subprocess.PIPE, stdout=subprocess.PIPE, universal_newlines=True)
+reader = threading.Thread(target=read_results, args=(proc.stdout,))
+reader.start()
+
+i = 0
+while i < NTESTS:
+  n = min(CHUNK, NTESTS - i)
+  proc.stdin.write("\n".join(make_case() for _ in range(n)) + "\n")
+  i += n
+proc.stdin.close()
+proc.wait()
+reader.join()
+elapsed = time.time() - start
+
+if failures:
+  sys.stdout.write("\n")
+  try:
+    f = open("error_log.txt", "a+")
+    f.write(os.linesep.join(failures) + os.linesep)
+    f.close()
+  except:
+    import traceback
+    print("\n\nEXCEPTION:\n\n" + traceback.format_exc())
 
 # After running the tests, give user feedback
-print("")
-print("%d/%d random tests passed." % (NTESTS - len(failures), NTESTS))
+print("%d/%d random tests passed, %.0f cases/s overall." % (NTESTS - len(failures), NTESTS, NTESTS / max(elapsed, 1e-9)))
+if summary:
+  print("test_random: %s" % summary[0])
+if proc.returncode != 0 and not failures:
+  print("test_random exited with %d" % proc.returncode)
 print("")
 
 
@@ -179,7 +180,3 @@ if len(failures) > 0:
   print("")
   print("\n".join(failures))
   print("")
-
-
-
-
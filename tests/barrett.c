@@ -0,0 +1,202 @@
+/*
+
+    Testing Barrett reduction (bignum_barrett_init, bignum_barrett_reduce,
+    bignum_barrett_mulmod)
+
+    - single-width values (hi == NULL) of any length are compared against bignum_mod
+    - moduli of up to half the bignum width: bignum_barrett_mulmod is compared
+      against bignum_mul + bignum_mod
+    - full-width odd moduli: bignum_barrett_mulmod is compared against the
+      Montgomery product
+    - double-width values hi:lo with moduli of up to half the width are compared
+      against ((hi mod n) * (2^width mod n) + lo) mod n
+
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "bn.h"
+#include "test_util.h"
+
+
+#define NRANDOM 500
+
+
+static void random_modulus(_TPtr<_T_bn> n, int nwords)
+{
+  do
+  {
+    random_bignum(n, nwords);
+  }
+  while (bignum_is_zero(n));
+}
+
+
+static void test_reduce_single_width(void)
+{
+  _TPtr<_T_bn> a = bignum_new();
+  _TPtr<_T_bn> n = bignum_new();
+  _TPtr<_T_bn> r = bignum_new();
+  _TPtr<_T_bn> r_ref = bignum_new();
+  bn_barrett_ctx ctx;
+  int nok = 0;
+  int i;
+
+  for (i = 0; i < NRANDOM; ++i)
+  {
+    random_modulus(n, 1 + rand() % BN_ARRAY_SIZE);
+    random_bignum(a, 1 + rand() % BN_ARRAY_SIZE);
+
+    bignum_barrett_init(&ctx, n);
+    bignum_barrett_reduce(&ctx, a, NULL, r);
+    bignum_mod(a, n, r_ref);
+
+    nok += (bignum_cmp(r, r_ref) == EQUAL);
+  }
+  report(nok, NRANDOM, "single-width reductions agree with bignum_mod");
+
+  bignum_free(a); bignum_free(n);
+  bignum_free(r); bignum_free(r_ref);
+}
+
+
+static void test_mulmod_half_width(void)
+{
+  _TPtr<_T_bn> a = bignum_new();
+  _TPtr<_T_bn> b = bignum_new();
+  _TPtr<_T_bn> n = bignum_new();
+  _TPtr<_T_bn> c = bignum_new();
+  _TPtr<_T_bn> c_ref = bignum_new();
+  bn_barrett_ctx ctx;
+  int nok = 0;
+  int i;
+
+  for (i = 0; i < NRANDOM; ++i)
+  {
+    random_modulus(n, 1 + rand() % (BN_ARRAY_SIZE / 2));
+    random_bignum(a, 1 + rand() % (BN_ARRAY_SIZE / 2));
+    random_bignum(b, 1 + rand() % (BN_ARRAY_SIZE / 2));
+
+    bignum_barrett_init(&ctx, n);
+    bignum_barrett_mulmod(&ctx, a, b, c);
+
+    bignum_mul(a, b, c_ref);
+    bignum_mod(c_ref, n, c_ref);
+
+    nok += (bignum_cmp(c, c_ref) == EQUAL);
+  }
+  report(nok, NRANDOM, "products agree with bignum_mul + bignum_mod");
+
+  bignum_free(a); bignum_free(b); bignum_free(n);
+  bignum_free(c); bignum_free(c_ref);
+}
+
+
+static void test_mulmod_full_width(void)
+{
+  _TPtr<_T_bn> a = bignum_new();
+  _TPtr<_T_bn> b = bignum_new();
+  _TPtr<_T_bn> n = bignum_new();
+  _TPtr<_T_bn> c = bignum_new();
+  _TPtr<_T_bn> am = bignum_new();
+  _TPtr<_T_bn> bm = bignum_new();
+  _TPtr<_T_bn> c_ref = bignum_new();
+  bn_barrett_ctx bctx;
+  bn_mont_ctx mctx;
+  int nok = 0;
+  int ncases = 50;
+  int i;
+
+  for (i = 0; i < ncases; ++i)
+  {
+    random_modulus(n, BN_ARRAY_SIZE);
+    n->array[0] |= 1;
+    bignum_normalize(n);
+    random_bignum(a, BN_ARRAY_SIZE);
+    random_bignum(b, BN_ARRAY_SIZE);
+    bignum_mod(a, n, a);
+    bignum_mod(b, n, b);
+
+    bignum_barrett_init(&bctx, n);
+    bignum_barrett_mulmod(&bctx, a, b, c);
+
+    bignum_mont_init(&mctx, n);
+    bignum_to_mont(&mctx, a, am);
+    bignum_to_mont(&mctx, b, bm);
+    bignum_mont_mul(&mctx, am, bm, c_ref);
+    bignum_from_mont(&mctx, c_ref, c_ref);
+
+    nok += (bignum_cmp(c, c_ref) == EQUAL);
+  }
+  report(nok, ncases, "full-width products agree with Montgomery multiplication");
+
+  bignum_free(a); bignum_free(b); bignum_free(n); bignum_free(c);
+  bignum_free(am); bignum_free(bm); bignum_free(c_ref);
+}
+
+
+static void test_reduce_double_width(void)
+{
+  _TPtr<_T_bn> lo = bignum_new();
+  _TPtr<_T_bn> hi = bignum_new();
+  _TPtr<_T_bn> n = bignum_new();
+  _TPtr<_T_bn> r = bignum_new();
+  _TPtr<_T_bn> r_ref = bignum_new();
+  _TPtr<_T_bn> two = bignum_new();
+  _TPtr<_T_bn> width = bignum_new();
+  _TPtr<_T_bn> shift = bignum_new();
+  _TPtr<_T_bn> tmp = bignum_new();
+  bn_barrett_ctx ctx;
+  int nok = 0;
+  int i;
+
+  bignum_from_int(two, 2);
+  bignum_from_int(width, BN_ARRAY_SIZE * 8 * WORD_SIZE);
+
+  for (i = 0; i < NRANDOM; ++i)
+  {
+    random_modulus(n, 1 + rand() % (BN_ARRAY_SIZE / 2));
+    random_bignum(lo, BN_ARRAY_SIZE);
+    random_bignum(hi, 1 + rand() % BN_ARRAY_SIZE);
+
+    bignum_barrett_init(&ctx, n);
+    bignum_barrett_reduce(&ctx, lo, hi, r);
+
+    /* r_ref = ((hi mod n) * (2^width mod n) + (lo mod n)) mod n */
+    bignum_powmod(two, width, n, shift);
+    bignum_mod(hi, n, tmp);
+    bignum_mul(tmp, shift, r_ref);
+    bignum_mod(r_ref, n, r_ref);
+    bignum_mod(lo, n, tmp);
+    bignum_add(r_ref, tmp, r_ref);
+    bignum_mod(r_ref, n, r_ref);
+
+    nok += (bignum_cmp(r, r_ref) == EQUAL);
+  }
+  report(nok, NRANDOM, "double-width reductions agree with the reference");
+
+  bignum_free(lo); bignum_free(hi); bignum_free(n);
+  bignum_free(r); bignum_free(r_ref);
+  bignum_free(two); bignum_free(width); bignum_free(shift); bignum_free(tmp);
+}
+
+
+int main()
+{
+  printf("\nTesting Barrett reduction:\n\n");
+
+  srand(time(NULL));
+
+  test_reduce_single_width();
+  test_mulmod_half_width();
+  test_mulmod_full_width();
+  test_reduce_double_width();
+
+  printf("\n%d/%d tests successful.\n", npassed, ntests);
+  printf("\n");
+
+  return (ntests - npassed); /* 0 if all tests passed */
+}
+
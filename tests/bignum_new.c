@@ -0,0 +1,129 @@
+/*
+
+    Testing bignum_new / bignum_free
+
+    - header is cache-line aligned and the limbs follow it in the same block
+    - a new number is zero in every limb, even when recycled memory is dirty
+    - results computed into bignum_new() numbers agree with the two-allocation
+      layout (__bn_malloc__ header + bignum_init), and bignum_free releases both
+
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include "bn.h"
+#include "test_util.h"
+
+
+#define NRANDOM 500
+
+
+/* The layout every caller used before bignum_new: two allocations */
+static _TPtr<_T_bn> new_two_block(void)
+{
+  _TPtr<_T_bn> n = (_TPtr<_T_bn>)__bn_malloc__(sizeof(_T_bn));
+  t_memset(n, 0, sizeof(_T_bn));
+  bignum_init(n);
+  return n;
+}
+
+
+static void test_layout(void)
+{
+  int nok = 0;
+  int ncases = 100;
+  int i, j;
+
+  for (i = 0; i < ncases; ++i)
+  {
+    _TPtr<_T_bn> n = bignum_new();
+    const uintptr_t header = (uintptr_t)n;
+    const uintptr_t limbs = (uintptr_t)n->array;
+
+    int ok = ((header % BN_CACHE_LINE) == 0);
+    ok = ok && (limbs >= header + sizeof(_T_bn)) && (limbs < header + sizeof(_T_bn) + sizeof(DTYPE));
+    ok = ok && ((limbs % sizeof(DTYPE)) == 0);
+    ok = ok && (n->used == 0) && bignum_is_zero(n);
+    for (j = 0; j < BN_ARRAY_SIZE; ++j)
+    {
+      ok = ok && (n->array[j] == 0);
+    }
+    nok += ok;
+
+    /* Dirty the block before handing it back, so the next one may get garbage */
+    for (j = 0; j < BN_ARRAY_SIZE; ++j)
+    {
+      n->array[j] = (DTYPE)MAX_VAL;
+    }
+    bignum_free(n);
+  }
+
+  ntests += 1;
+  npassed += (nok == ncases);
+  printf("  %s %d/%d numbers aligned, contiguous and zeroed\n", ((nok == ncases) ? "[ OK ]" : "[FAIL]"), nok, ncases);
+}
+
+
+static void test_against_two_block(void)
+{
+  _TPtr<_T_bn> a = bignum_new();
+  _TPtr<_T_bn> b = bignum_new();
+  _TPtr<_T_bn> c = bignum_new();
+  _TPtr<_T_bn> a2 = new_two_block();
+  _TPtr<_T_bn> b2 = new_two_block();
+  _TPtr<_T_bn> c2 = new_two_block();
+  int nok = 0;
+  int i;
+
+  for (i = 0; i < NRANDOM; ++i)
+  {
+    random_bignum(a, rand() % (BN_ARRAY_SIZE + 1));
+    do
+    {
+      random_bignum(b, 1 + rand() % BN_ARRAY_SIZE);
+    }
+    while (bignum_is_zero(b));
+    bignum_assign(a2, a);
+    bignum_assign(b2, b);
+
+    int ok = 1;
+    bignum_add(a, b, c);
+    bignum_add(a2, b2, c2);
+    ok = ok && (bignum_cmp(c, c2) == EQUAL);
+    bignum_mul(a, b, c);
+    bignum_mul(a2, b2, c2);
+    ok = ok && (bignum_cmp(c, c2) == EQUAL);
+    bignum_divmod(a, b, c, a);
+    bignum_divmod(a2, b2, c2, a2);
+    ok = ok && (bignum_cmp(c, c2) == EQUAL) && (bignum_cmp(a, a2) == EQUAL);
+
+    nok += ok;
+  }
+
+  ntests += 1;
+  npassed += (nok == NRANDOM);
+  printf("  %s %d/%d results agree with header + bignum_init numbers\n", ((nok == NRANDOM) ? "[ OK ]" : "[FAIL]"), nok, NRANDOM);
+
+  bignum_free(a); bignum_free(b); bignum_free(c);
+  bignum_free(a2); bignum_free(b2); bignum_free(c2);
+}
+
+
+int main()
+{
+  printf("\nTesting bignum_new / bignum_free:\n\n");
+
+  srand(time(NULL));
+
+  test_layout();
+  test_against_two_block();
+
+  printf("\n%d/%d tests successful.\n", npassed, ntests);
+  printf("\n");
+
+  return (ntests - npassed); /* 0 if all tests passed */
+}
+
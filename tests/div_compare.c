@@ -0,0 +1,162 @@
+/*
+
+    Randomized comparison of bignum_div / bignum_mod / bignum_divmod against
+    the bit-serial shift-and-subtract division the library used before
+    Algorithm D.
+
+    Operands are built from a mix of random limbs and "nasty" limb values
+    (0, 1, MSB, MAX...) with random lengths, so that the quotient estimate
+    correction and the add-back step of Algorithm D are exercised often.
+
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "bn.h"
+
+
+#define NTESTS 2000
+
+
+static DTYPE random_limb(void)
+{
+  switch (rand() % 8)
+  {
+    case 0:  return 0;
+    case 1:  return 1;
+    case 2:  return (DTYPE)MAX_VAL;
+    case 3:  return (DTYPE)(MAX_VAL - 1);
+    case 4:  return (DTYPE)DTYPE_MSB;
+    case 5:  return (DTYPE)(DTYPE_MSB - 1);
+    default: return (DTYPE)(((DTYPE_TMP)rand() << 16) ^ (DTYPE_TMP)rand());
+  }
+}
+
+
+static void random_bignum(_TPtr<_T_bn> n)
+{
+  int nwords = 1 + (rand() % BN_ARRAY_SIZE);
+  int i;
+  bignum_init(n);
+  for (i = 0; i < nwords; ++i)
+  {
+    n->array[i] = random_limb();
+  }
+  bignum_normalize(n);
+}
+
+
+/* The previous bignum_div: one quotient bit per iteration. */
+static void div_bitwise(_TPtr<_T_bn> a, _TPtr<_T_bn> b, _TPtr<_T_bn> c)
+{
+  _TPtr<_T_bn> current = bignum_new();
+  _TPtr<_T_bn> denom = bignum_new();
+  _TPtr<_T_bn> tmp = bignum_new();
+
+  bignum_from_int(current, 1);
+  bignum_assign(denom, b);
+  bignum_assign(tmp, a);
+
+  const DTYPE_TMP half_max = 1 + (DTYPE_TMP)(MAX_VAL / 2);
+  int overflow = 0;
+  while (bignum_cmp(denom, a) != LARGER)
+  {
+    if (denom->array[BN_ARRAY_SIZE - 1] >= half_max)
+    {
+      overflow = 1;
+      break;
+    }
+    bignum_lshift(current, current, 1);
+    bignum_lshift(denom, denom, 1);
+  }
+  if (!overflow)
+  {
+    bignum_rshift(denom, denom, 1);
+    bignum_rshift(current, current, 1);
+  }
+  bignum_init(c);
+
+  while (!bignum_is_zero(current))
+  {
+    if (bignum_cmp(tmp, denom) != SMALLER)
+    {
+      bignum_sub(tmp, denom, tmp);
+      bignum_or(c, current, c);
+    }
+    bignum_rshift(current, current, 1);
+    bignum_rshift(denom, denom, 1);
+  }
+
+  bignum_free(current);
+  bignum_free(denom);
+  bignum_free(tmp);
+}
+
+
+int main()
+{
+  _TPtr<_T_bn> a = bignum_new();
+  _TPtr<_T_bn> b = bignum_new();
+  _TPtr<_T_bn> q_ref = bignum_new();
+  _TPtr<_T_bn> r_ref = bignum_new();
+  _TPtr<_T_bn> q = bignum_new();
+  _TPtr<_T_bn> r = bignum_new();
+  _TPtr<_T_bn> dq = bignum_new();
+  _TPtr<_T_bn> dr = bignum_new();
+  _TPtr<_T_bn> tmp = bignum_new();
+
+  int npassed = 0;
+  int i;
+
+  srand(time(NULL));
+
+  printf("\nComparing bignum_div, bignum_mod and bignum_divmod against bit-serial division (%d random cases):\n", NTESTS);
+
+  for (i = 0; i < NTESTS; ++i)
+  {
+    random_bignum(a);
+    do
+    {
+      random_bignum(b);
+    }
+    while (bignum_is_zero(b));
+
+    /* Dividend smaller than the divisor now and then */
+    if ((i % 7) == 0)
+    {
+      bignum_rshift(a, a, rand() % (BN_ARRAY_SIZE * 8 * WORD_SIZE));
+    }
+
+    div_bitwise(a, b, q_ref);
+    bignum_mul(q_ref, b, tmp);
+    bignum_sub(a, tmp, r_ref);
+
+    bignum_div(a, b, q);
+    bignum_mod(a, b, r);
+    bignum_divmod(a, b, dq, dr);
+
+    if (   (bignum_cmp(q, q_ref) == EQUAL) && (bignum_cmp(r, r_ref) == EQUAL)
+        && (bignum_cmp(dq, q_ref) == EQUAL) && (bignum_cmp(dr, r_ref) == EQUAL))
+    {
+      npassed += 1;
+    }
+  }
+
+  printf("\n%d/%d tests successful.\n", npassed, NTESTS);
+  printf("\n");
+
+  bignum_free(a);
+  bignum_free(b);
+  bignum_free(q_ref);
+  bignum_free(r_ref);
+  bignum_free(q);
+  bignum_free(r);
+  bignum_free(dq);
+  bignum_free(dr);
+  bignum_free(tmp);
+
+  return (NTESTS - npassed); /* 0 if all tests passed */
+}
+
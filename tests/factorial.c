@@ -41,8 +41,9 @@ void factorial(_TPtr<_T_bn> n, _TPtr<_T_bn> res)
   tmp = (_TPtr<_T_bn>)__malloc__(sizeof(_T_bn));
   t_memset(tmp, 0, sizeof(_T_bn));
 #else
-  _T_bn _c_tmp;
-  _T_bn _c_tmp_array[BN_ARRAY_SIZE];
+  /* tmp goes straight to bignum_assign, which needs a valid used: zero-initialize */
+  _T_bn _c_tmp = { 0 };
+  _T_bn _c_tmp_array[BN_ARRAY_SIZE] = { 0 };
 #pragma TAINTED_SCOPE push
 #pragma TAINTED_SCOPE on
     tmp = (_TPtr<_T_bn>)&_c_tmp;
@@ -86,10 +87,11 @@ int main()
   result = (_TPtr<_T_bn>)__malloc__(sizeof(_T_bn));
   t_memset(result, 0, sizeof(_T_bn));
 #else
+  /* num is set up by bignum_from_int's bignum_init, result is written by bignum_mul first */
   _T_bn _c_num;
-  _T_bn _c_result;
+  _T_bn _c_result = { 0 };
   _T_bn _c_num_array[BN_ARRAY_SIZE];
-  _T_bn _c_result_array[BN_ARRAY_SIZE];
+  _T_bn _c_result_array[BN_ARRAY_SIZE] = { 0 };
 #pragma TAINTED_SCOPE push
 #pragma TAINTED_SCOPE on
     num = (_TPtr<_T_bn>)&_c_num;
@@ -112,6 +114,22 @@ int main()
   }
   end = clock();
   t_printf("10x factorial(100) using bignum = %s\n: Experiment took time %f", _T_buf, ((double) (end - start)) / CLOCKS_PER_SEC);
+#ifdef BN_PROFILE
+  /* Where that time went, per bignum_ function */
+  bn_prof_table prof;
+  bignum_prof_merge(&prof);
+  printf("\n\n");
+  bignum_prof_dump(stdout, &prof);
+#endif
+#ifdef BN_TRACE
+  /* The calls made, for bench/replay.c */
+  FILE* trace = fopen("./build/factorial.trace", "wb");
+  if (trace != NULL)
+  {
+    printf("\n\n%lu calls traced to ./build/factorial.trace\n", bignum_trace_dump(trace));
+    fclose(trace);
+  }
+#endif
 #ifndef NOOP_SBX
   __free__(num);
   __free__(result);
@@ -281,10 +281,10 @@ int main()
 
 
   printf("\n");
-__free__(sa->array);
-__free__(sb->array);
-__free__(sc->array);
-__free__(sd->array);
+__bn_free__(sa->array);
+__bn_free__(sb->array);
+__bn_free__(sc->array);
+__bn_free__(sd->array);
   __free__(sa);
     __free__(sb);
     __free__(sc);
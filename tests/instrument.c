@@ -0,0 +1,171 @@
+/*
+
+    Testing the BN_INSTRUMENT counters (build with -DBN_INSTRUMENT)
+
+    - a bignum_powmod loop on preallocated numbers makes no heap calls
+    - bignum_new / bignum_free are charged one __bn_malloc__ / __bn_free__ each, and
+      the nested bignum_init is counted as a call but charged nothing
+    - the application's own __bn_malloc__ / t_memset land in the "(outside)" row,
+      the limbs bignum_init allocates for it are charged to bignum_init
+    - bignum_to_string counts its t_sprintf calls (a single w2c call under WASM_SBX)
+    - reset zeroes everything, and the JSON dump lists the active functions
+
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bn.h"
+#include "test_util.h"
+
+
+#define NLOOPS 10
+
+
+static void test_powmod_loop(void)
+{
+  _TPtr<_T_bn> a = bignum_new();
+  _TPtr<_T_bn> e = bignum_new();
+  _TPtr<_T_bn> n = bignum_new();
+  _TPtr<_T_bn> c = bignum_new();
+  bn_instr_snapshot snap;
+  int i;
+
+  bignum_from_int(a, 0x1234567);
+  bignum_from_int(e, 65537);
+  bignum_from_int(n, 0x7fffffff);
+
+  bignum_instr_reset();
+  for (i = 0; i < NLOOPS; ++i)
+  {
+    bignum_powmod(a, e, n, c);
+  }
+  bignum_instr_snapshot(&snap);
+
+  int ok = (snap.calls[BN_FN_powmod] == NLOOPS) && (snap.calls[BN_FN_powmod_ws] == NLOOPS);
+  ok = ok && (snap.count[BN_FN_powmod][BN_INSTR_MALLOC] == 0) && (snap.count[BN_FN_powmod][BN_INSTR_FREE] == 0);
+  ok = ok && (snap.count[BN_FN_powmod_ws][BN_INSTR_MALLOC] == 0);
+  report_one(ok, "bignum_powmod loop makes no heap calls");
+
+  bignum_free(a); bignum_free(e); bignum_free(n); bignum_free(c);
+}
+
+
+static void test_new_free(void)
+{
+  bn_instr_snapshot snap;
+
+  bignum_instr_reset();
+  _TPtr<_T_bn> a = bignum_new();
+  bignum_free(a);
+  bignum_instr_snapshot(&snap);
+
+  int ok = (snap.calls[BN_FN_new] == 1) && (snap.calls[BN_FN_free] == 1) && (snap.calls[BN_FN_init] == 1);
+  ok = ok && (snap.count[BN_FN_new][BN_INSTR_MALLOC] == 1) && (snap.count[BN_FN_free][BN_INSTR_FREE] == 1);
+  ok = ok && (snap.count[BN_FN_new][BN_INSTR_BYTES] >= sizeof(_T_bn) + (BN_ARRAY_SIZE * sizeof(DTYPE)));
+  ok = ok && (snap.count[BN_FN_init][BN_INSTR_MALLOC] == 0);
+  report_one(ok, "bignum_new / bignum_free: one heap call each, nested bignum_init charged nothing");
+}
+
+
+static void test_outside(void)
+{
+  bn_instr_snapshot snap;
+
+  bignum_instr_reset();
+  _TPtr<_T_bn> a = (_TPtr<_T_bn>)__bn_malloc__(sizeof(_T_bn));
+  t_memset(a, 0, sizeof(_T_bn));
+  bignum_init(a);
+  bignum_free(a);
+  bignum_instr_snapshot(&snap);
+
+  int ok = (snap.count[BN_FN_OUTSIDE][BN_INSTR_MALLOC] == 1) && (snap.count[BN_FN_OUTSIDE][BN_INSTR_MEMSET] == 1);
+  ok = ok && (snap.count[BN_FN_OUTSIDE][BN_INSTR_BYTES] == sizeof(_T_bn));
+  ok = ok && (snap.count[BN_FN_init][BN_INSTR_MALLOC] == 1);
+  ok = ok && (snap.count[BN_FN_init][BN_INSTR_BYTES] == BN_ARRAY_SIZE * sizeof(DTYPE));
+  ok = ok && (snap.count[BN_FN_free][BN_INSTR_FREE] == 2);
+  report_one(ok, "application calls counted as (outside), bignum_init charged for its limbs");
+}
+
+
+static void test_to_string(void)
+{
+  char buf[8192];
+  _TPtr<char> _T_buf = StaticUncheckedToTStrAdaptor(buf, sizeof(buf));
+  _TPtr<_T_bn> a = bignum_new();
+  bn_instr_snapshot snap;
+
+  bignum_from_int(a, 12345);
+  bignum_instr_reset();
+  bignum_to_string(a, _T_buf, sizeof(buf));
+  bignum_instr_snapshot(&snap);
+
+#ifdef WASM_SBX
+  int ok = (snap.count[BN_FN_to_string][BN_INSTR_W2C] == 1);
+#else
+  int ok = (snap.count[BN_FN_to_string][BN_INSTR_SPRINTF] == BN_ARRAY_SIZE);
+#endif
+  report_one(ok, "bignum_to_string counts its sandbox string operations");
+
+  bignum_free(a);
+  __free__(_T_buf);
+}
+
+
+static void test_reset_and_dump(void)
+{
+  bn_instr_snapshot snap;
+  char text[4096];
+  int i, j;
+
+  _TPtr<_T_bn> a = bignum_new();
+  bignum_inc(a);
+  bignum_instr_reset();
+  bignum_instr_snapshot(&snap);
+
+  int ok = 1;
+  for (i = 0; i < BN_FN_COUNT; ++i)
+  {
+    ok = ok && (snap.calls[i] == 0);
+    for (j = 0; j < BN_INSTR_NCOUNTERS; ++j)
+    {
+      ok = ok && (snap.count[i][j] == 0);
+    }
+  }
+
+  bignum_inc(a);
+  bignum_free(a);
+
+  FILE* f = tmpfile();
+  bignum_instr_dump(f);
+  rewind(f);
+  size_t len = fread(text, 1, sizeof(text) - 1, f);
+  text[len] = 0;
+  fclose(f);
+
+  ok = ok && (text[0] == '{') && (strstr(text, "\"word_size\"") != NULL);
+  ok = ok && (strstr(text, "{ \"name\": \"bignum_inc\", \"calls\": 1, \"malloc\": 0") != NULL);
+  ok = ok && (strstr(text, "{ \"name\": \"bignum_free\", \"calls\": 1, \"malloc\": 0, \"free\": 1") != NULL);
+  ok = ok && (strstr(text, "bignum_powmod") == NULL);
+  ok = ok && (strcmp(bignum_instr_name(BN_FN_powmod), "bignum_powmod") == 0);
+  report_one(ok, "reset zeroes the counters, JSON dump lists only active functions");
+}
+
+
+int main()
+{
+  printf("\nTesting instrumentation counters:\n\n");
+
+  test_powmod_loop();
+  test_new_free();
+  test_outside();
+  test_to_string();
+  test_reset_and_dump();
+
+  printf("\n%d/%d tests successful.\n", npassed, ntests);
+  printf("\n");
+
+  return (ntests - npassed); /* 0 if all tests passed */
+}
+
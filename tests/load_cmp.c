@@ -50,10 +50,10 @@ int main()
 
   printf("\nLoading numbers from strings and from int.\n");
   
-  bignum_from_string(sa, "000000FF", 8);
-  bignum_from_string(sb, "0000FF00", 8);
-  bignum_from_string(sc, "00FF0000", 8);
-  bignum_from_string(sd, "FF000000", 8);
+  bignum_from_string(sa, "00000000000000FF", 16);
+  bignum_from_string(sb, "000000000000FF00", 16);
+  bignum_from_string(sc, "0000000000FF0000", 16);
+  bignum_from_string(sd, "00000000FF000000", 16);
  
   bignum_from_int(ia, 0x000000FF);
   bignum_from_int(ib, 0x0000FF00);
@@ -133,12 +133,12 @@ int main()
   bignum_init(sc);
   bignum_init(sd);
 
-  char hex_1000[]    = "000003E8";
-  char hex_1000000[] = "000F4240";
+  char hex_1000[]    = "00000000000003E8";
+  char hex_1000000[] = "00000000000F4240";
 
   /* Load 0x0308 into A and B from string */
-  bignum_from_string(sa, hex_1000, 8);
-  bignum_from_string(sb, hex_1000, 8);
+  bignum_from_string(sa, hex_1000, 16);
+  bignum_from_string(sb, hex_1000, 16);
 
   /* Load 0x0308 into C from integer */
   bignum_from_int(sc, 0x3e8);
@@ -148,7 +148,7 @@ int main()
   assert(bignum_cmp(sb, sc) == EQUAL);
 
   /* Load comparison value: */
-  bignum_from_string(sd, hex_1000000, 8);
+  bignum_from_string(sd, hex_1000000, 16);
   bignum_from_int(se, 0xf4240);
 
   /* Perform calculation:  C = A * B => C = 0x308 * 0x308 */
@@ -168,6 +168,13 @@ int main()
   end = clock();
   cpu_time_used = ((double) (end - start)) / CLOCKS_PER_SEC;
   printf("\nTests successful. With total time taken --> %f\n\n", cpu_time_used);
+#ifdef BN_PROFILE
+  /* Where that time went, per bignum_ function */
+  bn_prof_table prof;
+  bignum_prof_merge(&prof);
+  bignum_prof_dump(stdout, &prof);
+  printf("\n");
+#endif
 
   __free__(sa);
     __free__(sb);
@@ -0,0 +1,137 @@
+/*
+
+    Testing Montgomery arithmetic (bignum_mont_init, bignum_to_mont,
+    bignum_from_mont, bignum_mont_mul)
+
+    - odd moduli of up to half the bignum width: from_mont(mont_mul(to_mont(a), to_mont(b)))
+      is compared against bignum_mul + bignum_mod
+    - full-width odd moduli: a chain of Montgomery squarings and multiplications
+      computing a^e mod n is compared against bignum_powmod
+
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "bn.h"
+#include "test_util.h"
+
+
+#define NRANDOM 500
+
+
+static void random_modulus(_TPtr<_T_bn> n, int nwords)
+{
+  random_bignum(n, nwords);
+  n->array[0] |= 1;
+  bignum_normalize(n);
+}
+
+
+static void test_mul_half_width(void)
+{
+  _TPtr<_T_bn> a = bignum_new();
+  _TPtr<_T_bn> b = bignum_new();
+  _TPtr<_T_bn> n = bignum_new();
+  _TPtr<_T_bn> am = bignum_new();
+  _TPtr<_T_bn> bm = bignum_new();
+  _TPtr<_T_bn> c = bignum_new();
+  _TPtr<_T_bn> c_ref = bignum_new();
+  bn_mont_ctx ctx;
+  int nok = 0;
+  int i;
+
+  for (i = 0; i < NRANDOM; ++i)
+  {
+    random_modulus(n, 1 + rand() % (BN_ARRAY_SIZE / 2));
+    random_bignum(a, 1 + rand() % (BN_ARRAY_SIZE / 2));
+    random_bignum(b, 1 + rand() % (BN_ARRAY_SIZE / 2));
+    bignum_mod(a, n, a);
+    bignum_mod(b, n, b);
+
+    bignum_mont_init(&ctx, n);
+    bignum_to_mont(&ctx, a, am);
+    bignum_to_mont(&ctx, b, bm);
+    bignum_mont_mul(&ctx, am, bm, c);
+    bignum_from_mont(&ctx, c, c);
+
+    bignum_mul(a, b, c_ref);
+    bignum_mod(c_ref, n, c_ref);
+
+    nok += (bignum_cmp(c, c_ref) == EQUAL);
+  }
+
+  ntests += 1;
+  npassed += (nok == NRANDOM);
+  printf("  %s %d/%d products agree with bignum_mul + bignum_mod\n", ((nok == NRANDOM) ? "[ OK ]" : "[FAIL]"), nok, NRANDOM);
+
+  bignum_free(a); bignum_free(b); bignum_free(n);
+  bignum_free(am); bignum_free(bm);
+  bignum_free(c); bignum_free(c_ref);
+}
+
+
+static void test_pow_full_width(void)
+{
+  _TPtr<_T_bn> a = bignum_new();
+  _TPtr<_T_bn> e = bignum_new();
+  _TPtr<_T_bn> n = bignum_new();
+  _TPtr<_T_bn> am = bignum_new();
+  _TPtr<_T_bn> r = bignum_new();
+  _TPtr<_T_bn> r_ref = bignum_new();
+  bn_mont_ctx ctx;
+  int nok = 0;
+  int ncases = 20;
+  int i, bit;
+
+  for (i = 0; i < ncases; ++i)
+  {
+    random_modulus(n, BN_ARRAY_SIZE);
+    random_bignum(a, BN_ARRAY_SIZE);
+    random_bignum(e, 2);
+
+    bignum_mont_init(&ctx, n);
+    bignum_to_mont(&ctx, a, am);
+
+    /* r = 1 in Montgomery form, then square-and-multiply from the top bit */
+    bignum_from_int(r, 1);
+    bignum_to_mont(&ctx, r, r);
+    for (bit = (2 * 8 * WORD_SIZE) - 1; bit >= 0; --bit)
+    {
+      bignum_mont_mul(&ctx, r, r, r);
+      if ((e->array[bit / (8 * WORD_SIZE)] >> (bit % (8 * WORD_SIZE))) & 1)
+      {
+        bignum_mont_mul(&ctx, r, am, r);
+      }
+    }
+    bignum_from_mont(&ctx, r, r);
+
+    bignum_powmod(a, e, n, r_ref);
+    nok += (bignum_cmp(r, r_ref) == EQUAL);
+  }
+
+  ntests += 1;
+  npassed += (nok == ncases);
+  printf("  %s %d/%d full-width exponentiations agree with bignum_powmod\n", ((nok == ncases) ? "[ OK ]" : "[FAIL]"), nok, ncases);
+
+  bignum_free(a); bignum_free(e); bignum_free(n);
+  bignum_free(am); bignum_free(r); bignum_free(r_ref);
+}
+
+
+int main()
+{
+  printf("\nTesting Montgomery arithmetic:\n\n");
+
+  srand(time(NULL));
+
+  test_mul_half_width();
+  test_pow_full_width();
+
+  printf("\n%d/%d tests successful.\n", npassed, ntests);
+  printf("\n");
+
+  return (ntests - npassed); /* 0 if all tests passed */
+}
+
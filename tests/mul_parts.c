@@ -0,0 +1,275 @@
+/*
+
+    Testing the parts of a product: bignum_mul_full, bignum_mul_low and
+    bignum_mul_high (build with -DBN_ARRAY_SIZE="(512 / WORD_SIZE)")
+
+    mul_full keeps all 2 * BN_ARRAY_SIZE limbs of a product, mul_low and
+    mul_high sum only the columns below or (with a few guard columns) above
+    the limb asked for. This test is built for 4096-bit bignums, once with the
+    default cutoffs, once with -DSHORTMUL_CUTOFF=1000000 so that short products
+    of every length stay with the column kernels, and once more with
+    -DMULHIGH_GUARD=1 as well, so that mul_high can never trust its guard
+    limbs and always takes the path that sums every column.
+    Every result is compared limb for limb with the schoolbook
+    multiplication of tests/test_util.h.
+
+    - full products of random and of all-ones operands, up to full width
+    - low and high parts at random and at edge limb counts
+    - squares (a and b the same bignum) and results written over an operand
+    - (hi:lo) of mul_full reduced by bignum_barrett_reduce
+
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "bn.h"
+#include "test_util.h"
+
+
+#define NRANDOM 100
+
+
+/* 1 if n holds r[lo .. lo+BN_ARRAY_SIZE-1], limbs past 2 * BN_ARRAY_SIZE being zero */
+static int limbs_match(_TPtr<_T_bn> n, DTYPE* r, int lo)
+{
+  int i;
+  int ok = 1;
+  for (i = 0; i < BN_ARRAY_SIZE; ++i)
+  {
+    const DTYPE expect = ((lo + i) < (2 * BN_ARRAY_SIZE)) ? r[lo + i] : 0;
+    ok = ok && (n->array[i] == expect);
+  }
+  return ok;
+}
+
+
+static int full_matches(_TPtr<_T_bn> a, _TPtr<_T_bn> b, _TPtr<_T_bn> lo, _TPtr<_T_bn> hi)
+{
+  static DTYPE r[2 * BN_ARRAY_SIZE];
+  schoolbook_bignum(r, a, b);
+  bignum_mul_full(a, b, lo, hi);
+  return limbs_match(lo, r, 0) && limbs_match(hi, r, BN_ARRAY_SIZE);
+}
+
+
+static int low_matches(_TPtr<_T_bn> a, _TPtr<_T_bn> b, _TPtr<_T_bn> c, int nlimbs)
+{
+  static DTYPE r[2 * BN_ARRAY_SIZE];
+  int i;
+  schoolbook_bignum(r, a, b);
+  for (i = nlimbs; i < (2 * BN_ARRAY_SIZE); ++i)
+  {
+    r[i] = 0;
+  }
+  bignum_mul_low(a, b, c, nlimbs);
+  return limbs_match(c, r, 0);
+}
+
+
+static int high_matches(_TPtr<_T_bn> a, _TPtr<_T_bn> b, _TPtr<_T_bn> c, int nlimbs)
+{
+  static DTYPE r[2 * BN_ARRAY_SIZE];
+  schoolbook_bignum(r, a, b);
+  bignum_mul_high(a, b, c, nlimbs);
+  return limbs_match(c, r, nlimbs);
+}
+
+
+static void test_full(void)
+{
+  _TPtr<_T_bn> a = bignum_new();
+  _TPtr<_T_bn> b = bignum_new();
+  _TPtr<_T_bn> lo = bignum_new();
+  _TPtr<_T_bn> hi = bignum_new();
+  int nok, ncases;
+  int n;
+
+  nok = ncases = 0;
+  for (n = 0; n < NRANDOM; ++n)
+  {
+    random_bignum(a, rand() % (BN_ARRAY_SIZE + 1));
+    random_bignum(b, rand() % (BN_ARRAY_SIZE + 1));
+    nok += full_matches(a, b, lo, hi);
+    ncases += 1;
+  }
+  report(nok, ncases, "mul_full, random lengths up to full width");
+
+  nok = ncases = 0;
+  for (n = 1; n <= BN_ARRAY_SIZE; n += 1 + (n / 8))
+  {
+    ones_bignum(a, n);
+    ones_bignum(b, BN_ARRAY_SIZE - n + 1);
+    nok += full_matches(a, b, lo, hi);
+    nok += full_matches(a, a, lo, hi);
+    ncases += 2;
+  }
+  report(nok, ncases, "mul_full, all limbs set, squares too");
+
+  /* Results over the operands: lo over a, hi over b */
+  nok = ncases = 0;
+  for (n = 0; n < (NRANDOM / 10); ++n)
+  {
+    static DTYPE r[2 * BN_ARRAY_SIZE];
+    random_bignum(a, 1 + rand() % BN_ARRAY_SIZE);
+    random_bignum(b, 1 + rand() % BN_ARRAY_SIZE);
+    schoolbook_bignum(r, a, b);
+    bignum_mul_full(a, b, a, b);
+    nok += limbs_match(a, r, 0) && limbs_match(b, r, BN_ARRAY_SIZE);
+    ncases += 1;
+  }
+  report(nok, ncases, "mul_full in place");
+
+  bignum_free(a);
+  bignum_free(b);
+  bignum_free(lo);
+  bignum_free(hi);
+}
+
+
+static void test_parts(void)
+{
+  static const int edges[] = { 0, 1, 2, 3, 4, 5, BN_ARRAY_SIZE / 2, BN_ARRAY_SIZE - 1, BN_ARRAY_SIZE };
+  const int nedges = sizeof(edges) / sizeof(edges[0]);
+  _TPtr<_T_bn> a = bignum_new();
+  _TPtr<_T_bn> b = bignum_new();
+  _TPtr<_T_bn> c = bignum_new();
+  int nok, ncases;
+  int i, n;
+
+  nok = ncases = 0;
+  for (n = 0; n < NRANDOM; ++n)
+  {
+    random_bignum(a, rand() % (BN_ARRAY_SIZE + 1));
+    random_bignum(b, rand() % (BN_ARRAY_SIZE + 1));
+    nok += low_matches(a, b, c, rand() % (BN_ARRAY_SIZE + 1));
+    ncases += 1;
+    for (i = 0; i < nedges; ++i)
+    {
+      nok += low_matches(a, b, c, edges[i]);
+      ncases += 1;
+    }
+  }
+  report(nok, ncases, "mul_low, random and edge limb counts");
+
+  nok = ncases = 0;
+  for (n = 0; n < NRANDOM; ++n)
+  {
+    random_bignum(a, rand() % (BN_ARRAY_SIZE + 1));
+    random_bignum(b, rand() % (BN_ARRAY_SIZE + 1));
+    nok += high_matches(a, b, c, rand() % ((2 * BN_ARRAY_SIZE) + 1));
+    ncases += 1;
+    for (i = 0; i < nedges; ++i)
+    {
+      nok += high_matches(a, b, c, edges[i]);
+      nok += high_matches(a, b, c, (2 * BN_ARRAY_SIZE) - edges[i]);
+      ncases += 2;
+    }
+  }
+  report(nok, ncases, "mul_high, random and edge limb counts");
+
+  /* All limbs set: long columns, and every guard limb of mul_high near its maximum */
+  nok = ncases = 0;
+  for (n = 1; n <= BN_ARRAY_SIZE; n += 1 + (n / 8))
+  {
+    ones_bignum(a, n);
+    ones_bignum(b, BN_ARRAY_SIZE);
+    nok += low_matches(a, b, c, BN_ARRAY_SIZE);
+    nok += high_matches(a, b, c, n);
+    nok += high_matches(a, b, c, BN_ARRAY_SIZE);
+    nok += high_matches(b, b, c, n);
+    ncases += 4;
+  }
+  report(nok, ncases, "all limbs set");
+
+  nok = ncases = 0;
+  for (n = 0; n < NRANDOM; ++n)
+  {
+    const int nlimbs = rand() % (BN_ARRAY_SIZE + 1);
+    random_bignum(a, 1 + rand() % BN_ARRAY_SIZE);
+    nok += low_matches(a, a, c, nlimbs);
+    nok += high_matches(a, a, c, nlimbs);
+    ncases += 2;
+  }
+  report(nok, ncases, "squares");
+
+  nok = ncases = 0;
+  for (n = 0; n < (NRANDOM / 10); ++n)
+  {
+    static DTYPE r[2 * BN_ARRAY_SIZE];
+    const int nlimbs = rand() % (BN_ARRAY_SIZE + 1);
+    random_bignum(a, 1 + rand() % BN_ARRAY_SIZE);
+    random_bignum(b, 1 + rand() % BN_ARRAY_SIZE);
+    schoolbook_bignum(r, a, b);
+    bignum_mul_high(a, b, a, nlimbs);
+    nok += limbs_match(a, r, nlimbs);
+    ncases += 1;
+  }
+  report(nok, ncases, "mul_high in place");
+
+  bignum_free(a);
+  bignum_free(b);
+  bignum_free(c);
+}
+
+
+static void test_reduce(void)
+{
+  /* a * b mod n from (hi:lo), against the product of a mod n and b mod n, which fits */
+  _TPtr<_T_bn> a = bignum_new();
+  _TPtr<_T_bn> b = bignum_new();
+  _TPtr<_T_bn> n = bignum_new();
+  _TPtr<_T_bn> lo = bignum_new();
+  _TPtr<_T_bn> hi = bignum_new();
+  _TPtr<_T_bn> c = bignum_new();
+  _TPtr<_T_bn> ref = bignum_new();
+  bn_barrett_ctx ctx;
+  int nok = 0;
+  int i;
+
+  for (i = 0; i < (NRANDOM / 5); ++i)
+  {
+    do
+    {
+      random_bignum(n, 1 + rand() % (BN_ARRAY_SIZE / 2));
+    }
+    while (bignum_is_zero(n));
+    random_bignum(a, 1 + rand() % BN_ARRAY_SIZE);
+    random_bignum(b, 1 + rand() % BN_ARRAY_SIZE);
+
+    bignum_barrett_init(&ctx, n);
+    bignum_mul_full(a, b, lo, hi);
+    bignum_barrett_reduce(&ctx, lo, hi, c);
+
+    bignum_mod(a, n, a);
+    bignum_mod(b, n, b);
+    bignum_mul(a, b, ref);
+    bignum_mod(ref, n, ref);
+    nok += (bignum_cmp(c, ref) == EQUAL);
+  }
+  report(nok, NRANDOM / 5, "barrett_reduce of (hi:lo) from mul_full");
+
+  bignum_free(a);
+  bignum_free(b);
+  bignum_free(n);
+  bignum_free(lo);
+  bignum_free(hi);
+  bignum_free(c);
+  bignum_free(ref);
+}
+
+
+int main()
+{
+  printf("\nTesting full, low and high products, %d-bit bignums:\n\n", BN_ARRAY_SIZE * 8 * WORD_SIZE);
+
+  srand(31415);
+  test_full();
+  test_parts();
+  test_reduce();
+
+  printf("\n%d/%d tests successful.\n", npassed, ntests);
+  printf("\n");
+
+  return (ntests - npassed); /* 0 if all tests passed */
+}
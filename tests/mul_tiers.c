@@ -0,0 +1,150 @@
+/*
+
+    Testing Karatsuba, Toom-3 and NTT multiplication (build with -DBN_ARRAY_SIZE="(512 / WORD_SIZE)")
+
+    bignum_mul switches to Karatsuba for operands of KARATSUBA_CUTOFF limbs,
+    to Toom-3 from TOOM3_CUTOFF limbs and to the NTT from NTT_CUTOFF limbs,
+    which 1024-bit bignums hardly or never reach: this test is built for
+    4096-bit bignums, once with the default cutoffs, once with tiny ones
+    (-DKARATSUBA_CUTOFF=4 -DTOOM3_CUTOFF=9) so that every tier and the
+    recursion between them run at every WORD_SIZE, and once with
+    -DNTT_CUTOFF=16 so that nearly every product goes through the NTT.
+    Every product is compared limb for limb with the schoolbook
+    multiplication of tests/test_util.h.
+
+    - equal lengths, both sides of each cutoff and odd lengths
+    - random unequal lengths, including products truncated to the bignum width
+    - all limbs set, so every addition in the recursion carries
+    - bignum_powmod (whose products go through the same tiers) against
+      repeated bignum_mul + bignum_mod
+
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "bn.h"
+#include "test_util.h"
+
+
+#define NRANDOM 300
+
+
+static int mul_matches(_TPtr<_T_bn> a, _TPtr<_T_bn> b, _TPtr<_T_bn> c, _TPtr<_T_bn> ref)
+{
+  bignum_mul(a, b, c);
+  schoolbook_mul(a, b, ref);
+  return (bignum_cmp(c, ref) == EQUAL);
+}
+
+
+static void test_mul(void)
+{
+  _TPtr<_T_bn> a = bignum_new();
+  _TPtr<_T_bn> b = bignum_new();
+  _TPtr<_T_bn> c = bignum_new();
+  _TPtr<_T_bn> ref = bignum_new();
+  int nok, ncases;
+  int n;
+
+  nok = ncases = 0;
+  for (n = 1; n <= (BN_ARRAY_SIZE / 2); ++n)
+  {
+    random_bignum(a, n);
+    random_bignum(b, n);
+    nok += mul_matches(a, b, c, ref);
+    ncases += 1;
+  }
+  report(nok, ncases, "equal lengths, 1 to half the width");
+
+  nok = ncases = 0;
+  for (n = 0; n < NRANDOM; ++n)
+  {
+    random_bignum(a, 1 + rand() % BN_ARRAY_SIZE);
+    random_bignum(b, 1 + rand() % BN_ARRAY_SIZE);
+    nok += mul_matches(a, b, c, ref);
+    ncases += 1;
+  }
+  report(nok, ncases, "random lengths, truncated past the width");
+
+  nok = ncases = 0;
+  for (n = 1; n <= BN_ARRAY_SIZE; ++n)
+  {
+    ones_bignum(a, n);
+    ones_bignum(b, (n <= (BN_ARRAY_SIZE / 2)) ? n : (BN_ARRAY_SIZE - n + 1));
+    nok += mul_matches(a, b, c, ref);
+    ncases += 1;
+  }
+  report(nok, ncases, "all limbs set");
+
+  /* Aliasing: c = a * a in place */
+  random_bignum(a, BN_ARRAY_SIZE / 2);
+  schoolbook_mul(a, a, ref);
+  bignum_mul(a, a, a);
+  report((bignum_cmp(a, ref) == EQUAL), 1, "in place square");
+
+  bignum_free(a);
+  bignum_free(b);
+  bignum_free(c);
+  bignum_free(ref);
+}
+
+
+static void test_powmod(void)
+{
+  _TPtr<_T_bn> a = bignum_new();
+  _TPtr<_T_bn> e = bignum_new();
+  _TPtr<_T_bn> n = bignum_new();
+  _TPtr<_T_bn> c = bignum_new();
+  _TPtr<_T_bn> ref = bignum_new();
+  _TPtr<_T_bn> tmp = bignum_new();
+  int nok = 0;
+  int i, k;
+
+  for (i = 0; i < (NRANDOM / 10); ++i)
+  {
+    const int nwords = (BN_ARRAY_SIZE / 4) + rand() % (BN_ARRAY_SIZE / 4);
+    do
+    {
+      random_bignum(n, nwords);
+    }
+    while (bignum_is_zero(n));
+    random_bignum(a, nwords);
+    const int exp = 2 + rand() % 30;
+    bignum_from_int(e, exp);
+
+    bignum_powmod(a, e, n, c);
+
+    bignum_mod(a, n, ref);
+    bignum_assign(tmp, ref);
+    for (k = 1; k < exp; ++k)
+    {
+      bignum_mul(ref, tmp, ref);
+      bignum_mod(ref, n, ref);
+    }
+    nok += (bignum_cmp(c, ref) == EQUAL);
+  }
+  report(nok, NRANDOM / 10, "powmod against repeated mul and mod");
+
+  bignum_free(a);
+  bignum_free(e);
+  bignum_free(n);
+  bignum_free(c);
+  bignum_free(ref);
+  bignum_free(tmp);
+}
+
+
+int main()
+{
+  printf("\nTesting Karatsuba, Toom-3 and NTT multiplication, %d-bit bignums:\n\n", BN_ARRAY_SIZE * 8 * WORD_SIZE);
+
+  srand(12345);
+  test_mul();
+  test_powmod();
+
+  printf("\n%d/%d tests successful.\n", npassed, ntests);
+  printf("\n");
+
+  return (ntests - npassed); /* 0 if all tests passed */
+}
@@ -0,0 +1,215 @@
+/*
+
+    Testing NTT multiplication on the variable-length view, bignum_mul_limbs
+    (build with -DNTT_CUTOFF=256, passed to bn.c and here alike)
+
+    bignum_mul_limbs multiplies plain limb arrays of any length, and from
+    NTT_CUTOFF limbs on it does so by number-theoretic transforms modulo three
+    primes. Products are compared limb for limb with the schoolbook
+    multiplication of tests/test_util.h, or with a closed form where that
+    would be slow.
+
+    - equal lengths on both sides of NTT_CUTOFF
+    - unbalanced lengths, the shorter operand at or above the cutoff
+    - all limbs set: the largest coefficients the CRT has to rebuild
+    - squares (a and b the same array), which take one transform per prime
+    - (2^k - 1)^2 = 2^2k - 2^(k+1) + 1 for k = 2^20 bits
+    - operands too short for a workspace, ws NULL
+
+    The bignum_mul and bignum_powmod side of the NTT is covered by
+    tests/mul_tiers.c, built with a tiny NTT_CUTOFF.
+
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "bn.h"
+#include "test_util.h"
+
+
+#ifndef NTT_CUTOFF
+  #error build with the same -DNTT_CUTOFF as bn.c
+#endif
+
+#define NRANDOM 20
+#define BIG_BITS (1 << 20)
+
+
+static DTYPE* new_limbs(int n)
+{
+  DTYPE* p = (DTYPE*)calloc((n > 0) ? n : 1, sizeof(DTYPE));
+  if (p == NULL)
+  {
+    printf("out of memory\n");
+    exit(1);
+  }
+  return p;
+}
+
+
+/* bignum_mul_limbs with a workspace of exactly the size it asks for */
+static void mul_limbs(DTYPE* r, DTYPE* a, int na, DTYPE* b, int nb)
+{
+  const size_t size = bignum_mul_limbs_ws_size(na, nb);
+  bn_ws ws = { (size > 0) ? new_limbs((int)(size / sizeof(DTYPE))) : NULL, size };
+  bignum_mul_limbs(r, a, na, b, nb, (size > 0) ? &ws : NULL);
+  free(ws.limbs);
+}
+
+
+/* Multiply a and b (b == a for a square) both ways, 1 if the products agree */
+static int mul_matches(DTYPE* a, int na, DTYPE* b, int nb)
+{
+  DTYPE* r = new_limbs(na + nb);
+  DTYPE* ref = new_limbs(na + nb);
+  int i;
+  int ok = 1;
+
+  mul_limbs(r, a, na, b, nb);
+  schoolbook(ref, a, na, b, nb);
+  for (i = 0; i < (na + nb); ++i)
+  {
+    ok = ok && (r[i] == ref[i]);
+  }
+  free(r);
+  free(ref);
+  return ok;
+}
+
+
+/* Two random operands of na and nb limbs */
+static int random_matches(int na, int nb)
+{
+  DTYPE* a = new_limbs(na);
+  DTYPE* b = new_limbs(nb);
+  random_limbs(a, na);
+  random_limbs(b, nb);
+  int ok = mul_matches(a, na, b, nb);
+  free(a);
+  free(b);
+  return ok;
+}
+
+
+static void test_lengths(void)
+{
+  static const int deltas[] = { -1, 0, 1, 7 };
+  int nok, ncases;
+  int i;
+
+  nok = ncases = 0;
+  for (i = 0; i < (int)(sizeof(deltas) / sizeof(deltas[0])); ++i)
+  {
+    nok += random_matches(NTT_CUTOFF + deltas[i], NTT_CUTOFF + deltas[i]);
+    ncases += 1;
+  }
+  report(nok, ncases, "equal lengths around NTT_CUTOFF");
+
+  nok = ncases = 0;
+  for (i = 0; i < NRANDOM; ++i)
+  {
+    const int nb = NTT_CUTOFF + rand() % NTT_CUTOFF;
+    nok += random_matches(nb + rand() % (3 * NTT_CUTOFF), nb);
+    ncases += 1;
+  }
+  report(nok, ncases, "random unbalanced lengths at or above the cutoff");
+
+  nok = ncases = 0;
+  for (i = 1; i <= 3; ++i)
+  {
+    DTYPE* a = new_limbs(i * NTT_CUTOFF);
+    DTYPE* b = new_limbs(NTT_CUTOFF + i);
+    ones_limbs(a, i * NTT_CUTOFF);
+    ones_limbs(b, NTT_CUTOFF + i);
+    nok += mul_matches(a, i * NTT_CUTOFF, b, NTT_CUTOFF + i);
+    ncases += 1;
+    free(a);
+    free(b);
+  }
+  report(nok, ncases, "all limbs set");
+
+  nok = ncases = 0;
+  for (i = 0; i < 3; ++i)
+  {
+    const int n = NTT_CUTOFF + rand() % (2 * NTT_CUTOFF);
+    DTYPE* a = new_limbs(n);
+    random_limbs(a, n);
+    nok += mul_matches(a, n, a, n);
+    ncases += 1;
+    free(a);
+  }
+  report(nok, ncases, "squares, one operand array");
+
+  nok = ncases = 0;
+  for (i = 0; i < NRANDOM; ++i)
+  {
+    const int na = rand() % 40;
+    const int nb = rand() % 40;
+    DTYPE* a = new_limbs(na);
+    DTYPE* b = new_limbs(nb);
+    random_limbs(a, na);
+    random_limbs(b, nb);
+    DTYPE* r = new_limbs(na + nb);
+    DTYPE* ref = new_limbs(na + nb);
+    int k, ok = 1;
+    if (bignum_mul_limbs_ws_size(na, nb) == 0)
+    {
+      bignum_mul_limbs(r, a, na, b, nb, NULL);
+    }
+    else
+    {
+      mul_limbs(r, a, na, b, nb);
+    }
+    schoolbook(ref, a, na, b, nb);
+    for (k = 0; k < (na + nb); ++k)
+    {
+      ok = ok && (r[k] == ref[k]);
+    }
+    nok += ok;
+    ncases += 1;
+    free(a);
+    free(b);
+    free(r);
+    free(ref);
+  }
+  report(nok, ncases, "short operands, including empty ones");
+}
+
+
+static void test_big_square(void)
+{
+  /* (2^k - 1)^2: bit 0 and bits k+1 .. 2k-1 set */
+  const int n = BIG_BITS / (8 * WORD_SIZE);
+  DTYPE* a = new_limbs(n);
+  DTYPE* r = new_limbs(2 * n);
+  int i;
+  int ok = 1;
+
+  ones_limbs(a, n);
+  mul_limbs(r, a, n, a, n);
+  for (i = 0; i < (2 * BIG_BITS); ++i)
+  {
+    const int bit = (r[i / (8 * WORD_SIZE)] >> (i % (8 * WORD_SIZE))) & 1;
+    ok = ok && (bit == ((i == 0) || (i > BIG_BITS)));
+  }
+  report(ok, 1, "(2^k - 1)^2 for k = 2^20 bits");
+
+  free(a);
+  free(r);
+}
+
+
+int main()
+{
+  printf("\nTesting NTT multiplication of limb arrays, NTT_CUTOFF %d limbs:\n\n", NTT_CUTOFF);
+
+  srand(4321);
+  test_lengths();
+  test_big_square();
+
+  printf("\n%d/%d tests successful.\n", npassed, ntests);
+  printf("\n");
+
+  return (ntests - npassed); /* 0 if all tests passed */
+}
@@ -0,0 +1,235 @@
+/*
+
+    Testing the bignum pool behind __bn_malloc__ / __bn_free__ (BN_POOL)
+
+    - a freed slot is handed out again by the next request of its size class,
+      and the counters record hits, refills and the high-water mark
+    - 3 * BN_POOL_REFILL live numbers cost about three bulk refills, and
+      allocating them again after freeing them is all hits
+    - requests larger than any slot pass through to the sandbox heap, and
+      other buffers' __malloc__ / __free__ never touch the pool
+    - numbers built from recycled, dirty slots compute the same as fresh ones
+    - slots a thread leaves on its free lists when it exits are handed out
+      again on another thread
+
+    Nothing is tested when the pool is compiled out (NOOP_SBX or BN_NO_POOL).
+
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "bn.h"
+#include "test_util.h"
+
+
+#define NLIVE (3 * BN_POOL_REFILL)
+
+
+#ifdef BN_POOL
+
+static void test_reuse(void)
+{
+  bn_pool_stats before, after;
+
+  /* Warm the class up so the next request is a hit */
+  bignum_free(bignum_new());
+
+  bignum_pool_stats(&before);
+  _TPtr<_T_bn> a = bignum_new();
+  _TPtr<char> block = a->block;
+  bignum_free(a);
+  _TPtr<_T_bn> b = bignum_new();
+  int ok = (b->block == block);
+  bignum_free(b);
+  bignum_pool_stats(&after);
+
+  ok = ok && (after.hits == before.hits + 2) && (after.refills == before.refills);
+  ok = ok && (after.in_use == before.in_use);
+  report_one(ok, "freed slot is reused by the next bignum_new, counted as hits");
+}
+
+
+static void test_refill_and_high_water(void)
+{
+  _TPtr<_T_bn> live[NLIVE];
+  bn_pool_stats before, after;
+  int i;
+
+  bignum_pool_stats(&before);
+  for (i = 0; i < NLIVE; ++i)
+  {
+    live[i] = bignum_new();
+  }
+  bignum_pool_stats(&after);
+
+  /* The free list may already hold a few slots from earlier tests */
+  const long refills = (long)(after.refills - before.refills);
+  int ok = (refills >= (NLIVE / BN_POOL_REFILL) - 1) && (refills <= (NLIVE / BN_POOL_REFILL));
+  ok = ok && ((long)(after.hits - before.hits) + (refills * BN_POOL_REFILL) >= NLIVE);
+  ok = ok && (after.in_use == before.in_use + NLIVE);
+  ok = ok && (after.high_water >= after.in_use);
+
+  for (i = 0; i < NLIVE; ++i)
+  {
+    bignum_free(live[i]);
+  }
+  bignum_pool_stats(&before);
+  ok = ok && (before.in_use == after.in_use - NLIVE) && (before.high_water == after.high_water);
+
+  /* Same count again: everything comes back off the free list */
+  for (i = 0; i < NLIVE; ++i)
+  {
+    live[i] = bignum_new();
+  }
+  bignum_pool_stats(&after);
+  ok = ok && (after.refills == before.refills) && (after.hits == before.hits + NLIVE);
+  for (i = 0; i < NLIVE; ++i)
+  {
+    bignum_free(live[i]);
+  }
+
+  report_one(ok, "live numbers refill in bulk, second round is all hits, high-water kept");
+}
+
+
+static void test_large(void)
+{
+  bn_pool_stats before, after;
+
+  bignum_pool_stats(&before);
+  _TPtr<char> p = (_TPtr<char>)__bn_malloc__(64 * BN_ARRAY_SIZE * sizeof(DTYPE));
+  t_memset(p, 0xa5, 64 * BN_ARRAY_SIZE * sizeof(DTYPE));
+  __bn_free__(p);
+  bignum_pool_stats(&after);
+
+  int ok = (after.large == before.large + 1) && (after.in_use == before.in_use);
+
+  /* A buffer of limb size that is not a bignum, like the strings from StaticUncheckedToTStrAdaptor */
+  _TPtr<char> q = (_TPtr<char>)__malloc__(BN_ARRAY_SIZE * sizeof(DTYPE));
+  t_memset(q, 0, BN_ARRAY_SIZE * sizeof(DTYPE));
+  __free__(q);
+  bignum_pool_stats(&before);
+  ok = ok && (before.in_use == after.in_use) && (before.hits == after.hits);
+
+  report_one(ok, "oversized requests and other buffers go to the sandbox heap");
+}
+
+
+static void test_dirty_slots(void)
+{
+  _TPtr<_T_bn> live[NLIVE];
+  int nok = 0;
+  int i, j;
+
+  /* Fill every limb, then free, so the next round gets dirty slots */
+  for (i = 0; i < NLIVE; ++i)
+  {
+    live[i] = bignum_new();
+    for (j = 0; j < BN_ARRAY_SIZE; ++j)
+    {
+      live[i]->array[j] = (DTYPE)MAX_VAL;
+    }
+    bignum_normalize(live[i]);
+  }
+  for (i = 0; i < NLIVE; ++i)
+  {
+    bignum_free(live[i]);
+  }
+
+  /* Two-allocation numbers (header + bignum_init) come from the pool as well */
+  for (i = 0; i < NLIVE; ++i)
+  {
+    _TPtr<_T_bn> a = bignum_new();
+    _TPtr<_T_bn> b = (_TPtr<_T_bn>)__bn_malloc__(sizeof(_T_bn));
+    _TPtr<_T_bn> c = bignum_new();
+    t_memset(b, 0, sizeof(_T_bn));
+    bignum_init(b);
+
+    bignum_from_int(a, i + 1);
+    bignum_from_int(b, 1000);
+    bignum_mul(a, b, c);
+    nok += (bignum_to_int(c) == (i + 1) * 1000);
+
+    bignum_free(a);
+    bignum_free(b);
+    bignum_free(c);
+  }
+
+  report_one(nok == NLIVE, "numbers from recycled slots start at zero and compute correctly");
+}
+
+
+static _TPtr<char> _worker_blocks[BN_POOL_REFILL];
+
+static void* worker(void* arg)
+{
+  _TPtr<_T_bn> live[BN_POOL_REFILL];
+  int i;
+  (void)arg;
+
+  for (i = 0; i < BN_POOL_REFILL; ++i)
+  {
+    live[i] = bignum_new();
+    _worker_blocks[i] = live[i]->block;
+  }
+  for (i = 0; i < BN_POOL_REFILL; ++i)
+  {
+    bignum_free(live[i]);
+  }
+  return NULL;
+}
+
+
+static void test_thread_exit(void)
+{
+  /* Allocate on this thread until its own free list runs dry and the worker's parked slots come up */
+  const int nmax = 4 * NLIVE;
+  _TPtr<_T_bn> live[4 * NLIVE];
+  pthread_t thread;
+  int found = 0;
+  int i, j, n;
+
+  pthread_create(&thread, NULL, worker, NULL);
+  pthread_join(thread, NULL);
+
+  for (n = 0; (n < nmax) && !found; ++n)
+  {
+    live[n] = bignum_new();
+    for (j = 0; j < BN_POOL_REFILL; ++j)
+    {
+      found = found || (live[n]->block == _worker_blocks[j]);
+    }
+  }
+  for (i = 0; i < n; ++i)
+  {
+    bignum_free(live[i]);
+  }
+
+  report_one(found, "slots of an exited thread are reused by another");
+}
+
+#endif /* BN_POOL */
+
+
+int main()
+{
+  printf("\nTesting the bignum pool:\n\n");
+
+#ifdef BN_POOL
+  test_reuse();
+  test_refill_and_high_water();
+  test_large();
+  test_dirty_slots();
+  test_thread_exit();
+#else
+  printf("  pool compiled out, nothing to test\n");
+#endif
+
+  printf("\n%d/%d tests successful.\n", npassed, ntests);
+  printf("\n");
+
+  return (ntests - npassed); /* 0 if all tests passed */
+}
+
@@ -0,0 +1,172 @@
+/*
+
+    Testing bignum_powmod
+
+    - RSA examples with small factors (see tests/rsa.c), with known cipher texts
+    - 1024-bit RSA round trip: (m^e)^d mod n == m
+    - random moduli of up to half the bignum width, compared against plain
+      square-and-multiply with bignum_mul + bignum_mod (products still fit)
+
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "bn.h"
+#include "test_util.h"
+
+
+#define NRANDOM 200
+
+
+/* Reference: right-to-left square-and-multiply, valid while n^2 fits in a bignum */
+static void pow_mod_reference(_TPtr<_T_bn> a, _TPtr<_T_bn> b, _TPtr<_T_bn> n, _TPtr<_T_bn> res)
+{
+  _TPtr<_T_bn> tmpa = bignum_new();
+  _TPtr<_T_bn> tmpb = bignum_new();
+  _TPtr<_T_bn> tmp = bignum_new();
+
+  bignum_from_int(res, 1);
+  bignum_mod(res, n, res);
+  bignum_mod(a, n, tmpa);
+  bignum_assign(tmpb, b);
+
+  while (!bignum_is_zero(tmpb))
+  {
+    if (tmpb->array[0] & 1)
+    {
+      bignum_mul(res, tmpa, tmp);
+      bignum_mod(tmp, n, res);
+    }
+    bignum_rshift(tmpb, tmpb, 1);
+    bignum_mul(tmpa, tmpa, tmp);
+    bignum_mod(tmp, n, tmpa);
+  }
+
+  bignum_free(tmpa);
+  bignum_free(tmpb);
+  bignum_free(tmp);
+}
+
+
+static void test_small_rsa(int n, int e, int d, int m, int c)
+{
+  ntests += 1;
+
+  _TPtr<_T_bn> N = bignum_new();
+  _TPtr<_T_bn> E = bignum_new();
+  _TPtr<_T_bn> D = bignum_new();
+  _TPtr<_T_bn> M = bignum_new();
+  _TPtr<_T_bn> C = bignum_new();
+  _TPtr<_T_bn> expected = bignum_new();
+
+  bignum_from_int(N, n);
+  bignum_from_int(E, e);
+  bignum_from_int(D, d);
+  bignum_from_int(M, m);
+
+  bignum_powmod(M, E, N, C);
+  bignum_from_int(expected, c);
+  int ok = (bignum_cmp(C, expected) == EQUAL);
+
+  bignum_powmod(C, D, N, M);
+  bignum_from_int(expected, m);
+  ok = ok && (bignum_cmp(M, expected) == EQUAL);
+
+  printf("  %s %d ^ %d mod %d = %d, %d ^ %d mod %d = %d\n", (ok ? "[ OK ]" : "[FAIL]"), m, e, n, c, c, d, n, m);
+  npassed += ok;
+
+  bignum_free(N); bignum_free(E); bignum_free(D);
+  bignum_free(M); bignum_free(C); bignum_free(expected);
+}
+
+
+static void test_rsa1024(void)
+{
+  char n_hex[] = "a15f36fc7f8d188057fc51751962a5977118fa2ad4ced249c039ce36c8d1bd275273f1edd821892fa75680b1ae38749fff9268bf06b3c2af02bbdb52a0d05c2ae2384aa1002391c4b16b87caea8296cfd43757bb51373412e8fe5df2e56370505b692cf8d966e3f16bc62629874a0464a9710e4a0718637a68442e0eb1648ec5";
+  char d_hex[] = "3f5cc8956a6bf773e598604faf71097e265d5d55560c038c0bdb66ba222e20ac80f69fc6f93769cb795440e2037b8d67898d6e6d9b6f180169fc6348d5761ac9e81f6b8879529bc07c28dc92609eb8a4d15ac4ba3168a331403c689b1e82f62518c38601d58fd628fcb7009f139fb98e61ef7a23bee4e3d50af709638c24133d";
+  char c_hex[] = "761196d33bc0c05b0ef197e145f5799bb72c8b5c2c13920de018808b7108ee5f95482bcf8cf51239d4652e608faa77b61e0398ed865ab43b54c950abc8a93edbf53e42c9cfe2ef696cd1c405e442540cc730c38a96474a5c288c0e872f95c304fe5243586dff35184a040813bb01115f20cbd640920737fd7afc725bc8d63d04";
+
+  ntests += 1;
+
+  _TPtr<_T_bn> n = bignum_new();
+  _TPtr<_T_bn> d = bignum_new();
+  _TPtr<_T_bn> e = bignum_new();
+  _TPtr<_T_bn> m = bignum_new();
+  _TPtr<_T_bn> c = bignum_new();
+  _TPtr<_T_bn> expected = bignum_new();
+
+  bignum_from_string(n, n_hex, 256);
+  bignum_from_string(d, d_hex, 256);
+  bignum_from_string(expected, c_hex, 256);
+  bignum_from_int(e, 65537);
+  bignum_from_int(m, 54321);
+
+  bignum_powmod(m, e, n, c);
+  int ok = (bignum_cmp(c, expected) == EQUAL);
+
+  bignum_powmod(c, d, n, m);
+  bignum_from_int(expected, 54321);
+  ok = ok && (bignum_cmp(m, expected) == EQUAL);
+
+  printf("  %s RSA-1024 encrypt / decrypt of 54321\n", (ok ? "[ OK ]" : "[FAIL]"));
+  npassed += ok;
+
+  bignum_free(n); bignum_free(d); bignum_free(e);
+  bignum_free(m); bignum_free(c); bignum_free(expected);
+}
+
+
+static void test_random(void)
+{
+  _TPtr<_T_bn> a = bignum_new();
+  _TPtr<_T_bn> b = bignum_new();
+  _TPtr<_T_bn> n = bignum_new();
+  _TPtr<_T_bn> c = bignum_new();
+  _TPtr<_T_bn> c_ref = bignum_new();
+  int nok = 0;
+  int i;
+
+  for (i = 0; i < NRANDOM; ++i)
+  {
+    random_bignum(a, 1 + rand() % BN_ARRAY_SIZE);
+    random_bignum(b, 1 + rand() % (BN_ARRAY_SIZE / 2));
+    do
+    {
+      random_bignum(n, 1 + rand() % (BN_ARRAY_SIZE / 2));
+    }
+    while (bignum_is_zero(n));
+
+    bignum_powmod(a, b, n, c);
+    pow_mod_reference(a, b, n, c_ref);
+    nok += (bignum_cmp(c, c_ref) == EQUAL);
+  }
+
+  ntests += 1;
+  npassed += (nok == NRANDOM);
+  printf("  %s %d/%d random cases agree with square-and-multiply\n", ((nok == NRANDOM) ? "[ OK ]" : "[FAIL]"), nok, NRANDOM);
+
+  bignum_free(a); bignum_free(b); bignum_free(n);
+  bignum_free(c); bignum_free(c_ref);
+}
+
+
+int main()
+{
+  printf("\nTesting bignum_powmod:\n\n");
+
+  srand(time(NULL));
+
+  test_small_rsa(11 * 13, 7, 103, 9, 48);
+  test_small_rsa(61 * 53, 17, 2753, 123, 855);
+  test_small_rsa(2053 * 8209, 17, 8916785, 123, 14837949);
+  test_rsa1024();
+  test_random();
+
+  printf("\n%d/%d tests successful.\n", npassed, ntests);
+  printf("\n");
+
+  return (ntests - npassed); /* 0 if all tests passed */
+}
+
@@ -0,0 +1,125 @@
+/*
+
+    Testing the BN_PROFILE hooks (build with -DBN_PROFILE)
+
+    - every call is counted once and lands in exactly one histogram bucket
+    - nested calls: bignum_mul's inclusive cycles cover bignum_mul_ws, its
+      self cycles do not
+    - tables of several threads merge into one, also after the threads exit,
+      and bignum_prof_reset clears them all
+
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "bn.h"
+#include "test_util.h"
+
+
+#define NCALLS   1000
+#define NTHREADS 4
+
+
+static unsigned long long hist_sum(const bn_prof_entry* e)
+{
+  unsigned long long sum = 0;
+  int i;
+  for (i = 0; i < BN_PROF_NBUCKETS; ++i)
+  {
+    sum += e->hist[i];
+  }
+  return sum;
+}
+
+
+/* NCALLS multiplications and additions on numbers of its own */
+static void* worker(void* arg)
+{
+  _TPtr<_T_bn> a = bignum_new();
+  _TPtr<_T_bn> b = bignum_new();
+  _TPtr<_T_bn> c = bignum_new();
+  int i;
+
+  (void)arg;
+  bignum_from_int(a, 0x12345678);
+  bignum_from_int(b, 0x9abcdef);
+  for (i = 0; i < NCALLS; ++i)
+  {
+    bignum_mul(a, b, c);
+    bignum_add(a, c, c);
+  }
+
+  bignum_free(a);
+  bignum_free(b);
+  bignum_free(c);
+  return NULL;
+}
+
+
+static void test_single_thread(void)
+{
+  bn_prof_table prof;
+
+  bignum_prof_reset();
+  worker(NULL);
+  bignum_prof_merge(&prof);
+
+  const bn_prof_entry* mul = &prof.fn[BN_FN_mul];
+  const bn_prof_entry* mul_ws = &prof.fn[BN_FN_mul_ws];
+
+  int ok = (mul->calls == NCALLS) && (mul_ws->calls == NCALLS) && (prof.fn[BN_FN_add].calls == NCALLS);
+  ok = ok && (hist_sum(mul) == NCALLS) && (hist_sum(&prof.fn[BN_FN_add]) == NCALLS);
+  ok = ok && (mul->cycles >= mul_ws->cycles) && (mul->self_cycles + mul_ws->cycles <= mul->cycles);
+  ok = ok && (mul->self_cycles <= mul->cycles) && (prof.fn[BN_FN_new].calls == 3);
+  report_one(ok, "calls and histograms add up, nested bignum_mul_ws excluded from bignum_mul self cycles");
+}
+
+
+static void test_threads(void)
+{
+  pthread_t threads[NTHREADS];
+  bn_prof_table prof;
+  int i;
+
+  bignum_prof_reset();
+  for (i = 0; i < NTHREADS; ++i)
+  {
+    pthread_create(&threads[i], NULL, worker, NULL);
+  }
+  for (i = 0; i < NTHREADS; ++i)
+  {
+    pthread_join(threads[i], NULL);
+  }
+  bignum_prof_merge(&prof);
+
+  int ok = (prof.fn[BN_FN_mul].calls == NTHREADS * NCALLS) && (hist_sum(&prof.fn[BN_FN_mul]) == NTHREADS * NCALLS);
+  ok = ok && (prof.fn[BN_FN_free].calls == NTHREADS * 3);
+
+  bignum_prof_reset();
+  bignum_prof_merge(&prof);
+  ok = ok && (prof.fn[BN_FN_mul].calls == 0) && (prof.fn[BN_FN_mul].cycles == 0) && (hist_sum(&prof.fn[BN_FN_mul]) == 0);
+  report_one(ok, "tables of exited threads merge, reset clears them");
+
+  /* Something to look at */
+  worker(NULL);
+  bignum_prof_merge(&prof);
+  printf("\n");
+  bignum_prof_dump(stdout, &prof);
+}
+
+
+int main()
+{
+  printf("\nTesting profiling hooks:\n\n");
+
+  test_single_thread();
+  test_threads();
+
+  printf("\n%d/%d tests successful.\n", npassed, ntests);
+  printf("\n");
+
+  return (ntests - npassed); /* 0 if all tests passed */
+}
+
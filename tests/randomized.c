@@ -1,52 +1,47 @@
+/*
+
+    Checks one operation against an expected result, see scripts/test_rand.py
+
+      test_random [oper] [operand1] [operand2] [result]     one case
+      test_random -                                         cases from stdin
+      test_random [file]                                    cases from a file
+
+    In batch mode every line is "oper operand1 operand2 result", optionally
+    preceded by the program name so error_log.txt can be replayed as is.
+    Failing cases are printed as they are found, followed by a summary with
+    the number of cases per second.
+
+*/
+
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
 #include <string.h>
+#include <ctype.h>
+#include <time.h>
 #include "bn.h"
 
 enum { ADD, SUB, MUL, DIV, AND, OR, XOR, POW, MOD, RSHFT, LSHFT, ISQRT };
 
-int main(int argc, char** argv)
-{
 
-  if (argc < 5)
-  {
-    printf("ERROR\n\nUsage:\n    %s [oper] [operand1] [operand2] [result]\n\nWhere oper means:\n    0 = add, 1 = sub, 2 = mul, 3 = div\n\n", argv[0]);
+/* Longest line in batch mode: operator and three 1024-bit numbers in hex with room to spare */
+#define LINE_SIZE 8192
 
-    return -1;
-  }  
 
-  int oper = atoi(argv[1]);
+static _TPtr<_T_bn> a, b, c, res, a_before, b_before;
 
-/*
-  printf("program  = %s \n", argv[0]);
-  printf("operator = %s [%d]\n", argv[1], oper);
-  printf("operand1 = %s \n", argv[2]);
-  printf("operand2 = %s \n", argv[3]);
-  printf("expected = %s \n", argv[4]);
-*/
 
-  _TPtr<_T_bn> a = NULL, b = NULL, c = NULL, res = NULL;
-  a = (_TPtr<_T_bn>)__malloc__(sizeof(_T_bn));
-  b = (_TPtr<_T_bn>)__malloc__(sizeof(_T_bn));
-  c = (_TPtr<_T_bn>)__malloc__(sizeof(_T_bn));
-  res = (_TPtr<_T_bn>)__malloc__(sizeof(_T_bn));
-
-  bignum_init(a);
-  bignum_init(b);
-  bignum_init(c);
-  bignum_init(res);
-  bignum_from_string(a, argv[2], strlen(argv[2]));
-  bignum_from_string(b, argv[3], strlen(argv[3]));
-  bignum_from_string(c, argv[4], strlen(argv[4]));
-
-  _TPtr<_T_bn> a_before = NULL, b_before = NULL;
-  a_before = (_TPtr<_T_bn>)__malloc__(sizeof(_T_bn));
-  b_before = (_TPtr<_T_bn>)__malloc__(sizeof(_T_bn));
+/* 1 if oper applied to the hex strings sa and sb gives sc, prints the result otherwise */
+static int run_case(int oper, char* sa, char* sb, char* sc)
+{
+  bignum_from_string(a, sa, strlen(sa));
+  bignum_from_string(b, sb, strlen(sb));
+  bignum_from_string(c, sc, strlen(sc));
+
   bignum_assign(a_before, a);
   bignum_assign(b_before, b);
 
-
   switch (oper)
   {
     case ADD:   bignum_add(a, b, res);   break;
@@ -63,15 +58,15 @@ int main(int argc, char** argv)
     {
       bignum_rshift(a, res, bignum_to_int(b));
     } break;
-    case LSHFT: 
+    case LSHFT:
     {
       bignum_lshift(a, res, bignum_to_int(b));
     } break;
-    
+
 
     default:
       printf("default switch-case hit: unknown operator '%d' \n", oper);
-      assert(0); 
+      assert(0);
   }
 
   int cmp_result = (bignum_cmp(res, c) == EQUAL);
@@ -87,20 +82,116 @@ int main(int argc, char** argv)
     printf("res = %d \n", bignum_to_int(res));
     printf("\n");
     __free__(_T_buf);
-    return 1;
+    return 0;
   }
 
   assert(bignum_cmp(a_before, a) == EQUAL);
   assert(bignum_cmp(b_before, b) == EQUAL);
 
-    __free__(a);
-    __free__(b);
-    __free__(c);
-    __free__(res);
-    __free__(a_before);
-    __free__(b_before);
+  return 1;
+}
+
+
+/* Runs every case in f, returns the number of failures */
+static long run_batch(FILE* f)
+{
+  static char line[LINE_SIZE];
+  long ncases = 0;
+  long nfailed = 0;
+  long lineno = 0;
+  struct timespec t0, t1;
+
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  while (fgets(line, sizeof(line), f) != NULL)
+  {
+    char* tok[5];
+    int ntok = 0;
+    char* s;
+
+    lineno += 1;
+    for (s = strtok(line, " \t\r\n"); (s != NULL) && (ntok < 5); s = strtok(NULL, " \t\r\n"))
+    {
+      tok[ntok++] = s;
+    }
+    /* Skip the program name of error_log.txt lines */
+    if ((ntok == 5) && !isdigit((unsigned char)tok[0][0]))
+    {
+      memmove(&tok[0], &tok[1], 4 * sizeof(*tok));
+      ntok = 4;
+    }
+    if (ntok == 0)
+    {
+      continue;
+    }
+    if (ntok != 4)
+    {
+      printf("line %ld: expected 'oper operand1 operand2 result'\n", lineno);
+      nfailed += 1;
+      continue;
+    }
+
+    ncases += 1;
+    if (!run_case(atoi(tok[0]), tok[1], tok[2], tok[3]))
+    {
+      printf("FAIL line %ld: %s %s %s %s\n", lineno, tok[0], tok[1], tok[2], tok[3]);
+      fflush(stdout);
+      nfailed += 1;
+    }
+  }
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+
+  double seconds = (t1.tv_sec - t0.tv_sec) + ((t1.tv_nsec - t0.tv_nsec) * 1e-9);
+  printf("%ld/%ld cases passed, %.0f cases/s\n", ncases - nfailed, ncases, (seconds > 0.0) ? (ncases / seconds) : 0.0);
+
+  return nfailed;
+}
+
+
+int main(int argc, char** argv)
+{
+
+  if ((argc != 2) && (argc < 5))
+  {
+    printf("ERROR\n\nUsage:\n    %s [oper] [operand1] [operand2] [result]\n    %s [file | -]\n\nWhere oper means:\n    0 = add, 1 = sub, 2 = mul, 3 = div\n\n", argv[0], argv[0]);
+
+    return -1;
+  }
+
+  a = bignum_new();
+  b = bignum_new();
+  c = bignum_new();
+  res = bignum_new();
+  a_before = bignum_new();
+  b_before = bignum_new();
+
+  int result;
+  if (argc == 2)
+  {
+    FILE* f = (strcmp(argv[1], "-") == 0) ? stdin : fopen(argv[1], "r");
+    if (f == NULL)
+    {
+      perror(argv[1]);
+      return -1;
+    }
+    result = (run_batch(f) != 0);
+    if (f != stdin)
+    {
+      fclose(f);
+    }
+  }
+  else
+  {
+    result = !run_case(atoi(argv[1]), argv[2], argv[3], argv[4]);
+  }
+
+  bignum_free(a);
+  bignum_free(b);
+  bignum_free(c);
+  bignum_free(res);
+  bignum_free(a_before);
+  bignum_free(b_before);
 
-  return 0;
+  return result;
 }
 
 
@@ -64,7 +64,7 @@ void pow_mod_faster(struct bn* a, struct bn* b, struct bn* n, struct bn* res)
     if (bignum_is_zero(&tmpb))
       break;
 
-    bignum_mul(&tmpa, &tmpa, &tmp);
+    bignum_sqr(&tmpa, &tmp);
     bignum_mod(&tmp, n, &tmpa);
   }
 }
@@ -405,7 +405,7 @@ void pow_mod_naive(struct bn* b, struct bn* e, struct bn* m, struct bn* res)
       }                                  //
       bignum_div(e, &two, &tmp);         //     }
       bignum_assign(e, &tmp);            //     e /= 2
-      bignum_mul(b, b, &tmp);            //
+      bignum_sqr(b, &tmp);               //
       bignum_assign(b, &tmp);            //     b *= b
     }                                    //   }
                                          //   return result
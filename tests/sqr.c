@@ -0,0 +1,260 @@
+/*
+
+    Testing squaring (build with -DBN_ARRAY_SIZE="(512 / WORD_SIZE)")
+
+    bignum_sqr forms each cross product a[i] * a[j] once and doubles it, and
+    Karatsuba, Toom-3 and the NTT each have a squaring path of their own.
+    bignum_mul(a, a, c) and the squarings inside pow, powmod, isqrt and
+    barrett_mulmod take the same paths. Like tests/mul_tiers.c this test is
+    built for 4096-bit bignums, once with the default cutoffs, once with tiny
+    ones (-DKARATSUBA_CUTOFF=4 -DTOOM3_CUTOFF=9) and once with -DNTT_CUTOFF=16,
+    so that every tier squares at every WORD_SIZE. Squares are compared limb
+    for limb with the schoolbook multiplication of tests/test_util.h.
+
+    - every length from 1 limb to half the width, and truncated past it
+    - all limbs set, so every doubling and every addition carries
+    - in place, b = a * a with b == a, and bignum_mul(a, a, c)
+    - pow, powmod, isqrt and barrett_mulmod against results built from bignum_mul
+    - bignum_mul_limbs(r, a, n, a, n) on arrays longer than a bignum
+
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "bn.h"
+#include "test_util.h"
+
+
+#define NRANDOM 100
+
+
+static int sqr_matches(_TPtr<_T_bn> a, _TPtr<_T_bn> b, _TPtr<_T_bn> ref)
+{
+  bignum_sqr(a, b);
+  schoolbook_mul(a, a, ref);
+  return (bignum_cmp(b, ref) == EQUAL);
+}
+
+
+static void test_sqr(void)
+{
+  _TPtr<_T_bn> a = bignum_new();
+  _TPtr<_T_bn> b = bignum_new();
+  _TPtr<_T_bn> ref = bignum_new();
+  int nok, ncases;
+  int n;
+
+  nok = ncases = 0;
+  for (n = 0; n <= (BN_ARRAY_SIZE / 2); ++n)
+  {
+    random_bignum(a, n);
+    nok += sqr_matches(a, b, ref);
+    ncases += 1;
+  }
+  report(nok, ncases, "lengths 0 to half the width");
+
+  nok = ncases = 0;
+  for (n = 0; n < NRANDOM; ++n)
+  {
+    random_bignum(a, 1 + rand() % BN_ARRAY_SIZE);
+    nok += sqr_matches(a, b, ref);
+    ncases += 1;
+  }
+  report(nok, ncases, "random lengths, truncated past the width");
+
+  nok = ncases = 0;
+  for (n = 1; n <= BN_ARRAY_SIZE; ++n)
+  {
+    ones_bignum(a, n);
+    nok += sqr_matches(a, b, ref);
+    ncases += 1;
+  }
+  report(nok, ncases, "all limbs set");
+
+  nok = ncases = 0;
+  for (n = 1; n <= (BN_ARRAY_SIZE / 2); ++n)
+  {
+    random_bignum(a, n);
+    schoolbook_mul(a, a, ref);
+    bignum_sqr(a, a);
+    nok += (bignum_cmp(a, ref) == EQUAL);
+    ncases += 1;
+  }
+  report(nok, ncases, "in place, bignum_sqr(a, a)");
+
+  nok = ncases = 0;
+  for (n = 1; n <= (BN_ARRAY_SIZE / 2); ++n)
+  {
+    random_bignum(a, n);
+    schoolbook_mul(a, a, ref);
+    bignum_mul(a, a, b);
+    nok += (bignum_cmp(b, ref) == EQUAL);
+    ncases += 1;
+  }
+  report(nok, ncases, "bignum_mul(a, a, c)");
+
+  bignum_free(a);
+  bignum_free(b);
+  bignum_free(ref);
+}
+
+
+static void test_callers(void)
+{
+  _TPtr<_T_bn> a = bignum_new();
+  _TPtr<_T_bn> e = bignum_new();
+  _TPtr<_T_bn> n = bignum_new();
+  _TPtr<_T_bn> c = bignum_new();
+  _TPtr<_T_bn> ref = bignum_new();
+  _TPtr<_T_bn> tmp = bignum_new();
+  bn_barrett_ctx barrett;
+  int nok, i, k;
+
+  /* pow squares and multiplies, bignum_mul with distinct operands only multiplies */
+  nok = 0;
+  for (i = 0; i < (NRANDOM / 10); ++i)
+  {
+    const int exp = 2 + rand() % 14;
+    random_bignum(a, 1 + rand() % (BN_ARRAY_SIZE / exp));
+    bignum_from_int(e, exp);
+    bignum_pow(a, e, c);
+    bignum_assign(ref, a);
+    for (k = 1; k < exp; ++k)
+    {
+      bignum_mul(ref, a, tmp);
+      bignum_assign(ref, tmp);
+    }
+    nok += (bignum_cmp(c, ref) == EQUAL);
+  }
+  report(nok, NRANDOM / 10, "pow against repeated mul");
+
+  nok = 0;
+  for (i = 0; i < (NRANDOM / 10); ++i)
+  {
+    const int nwords = (BN_ARRAY_SIZE / 4) + rand() % (BN_ARRAY_SIZE / 4);
+    do
+    {
+      random_bignum(n, nwords);
+    }
+    while (bignum_is_zero(n));
+    random_bignum(a, nwords);
+    const int exp = 2 + rand() % 30;
+    bignum_from_int(e, exp);
+    bignum_powmod(a, e, n, c);
+
+    bignum_mod(a, n, ref);
+    bignum_assign(tmp, ref);
+    for (k = 1; k < exp; ++k)
+    {
+      bignum_mul(ref, tmp, ref);
+      bignum_mod(ref, n, ref);
+    }
+    nok += (bignum_cmp(c, ref) == EQUAL);
+  }
+  report(nok, NRANDOM / 10, "powmod against repeated mul and mod");
+
+  /* isqrt(a^2) = isqrt(a^2 + 2a) = a */
+  nok = 0;
+  for (i = 0; i < (NRANDOM / 10); ++i)
+  {
+    random_bignum(a, 1 + rand() % ((BN_ARRAY_SIZE / 2) - 1));
+    schoolbook_mul(a, a, ref);
+    bignum_isqrt(ref, c);
+    k = (bignum_cmp(c, a) == EQUAL);
+    bignum_add(ref, a, ref);
+    bignum_add(ref, a, ref);
+    bignum_isqrt(ref, c);
+    nok += k && (bignum_cmp(c, a) == EQUAL);
+  }
+  report(nok, NRANDOM / 10, "isqrt of squares");
+
+  nok = 0;
+  for (i = 0; i < (NRANDOM / 10); ++i)
+  {
+    do
+    {
+      random_bignum(n, 1 + rand() % (BN_ARRAY_SIZE / 2));
+    }
+    while (bignum_is_zero(n));
+    random_bignum(a, BN_ARRAY_SIZE / 2);
+    bignum_mod(a, n, a);
+    bignum_barrett_init(&barrett, n);
+    bignum_barrett_mulmod(&barrett, a, a, c);
+    bignum_assign(tmp, a);
+    bignum_mul(a, tmp, ref);
+    bignum_mod(ref, n, ref);
+    nok += (bignum_cmp(c, ref) == EQUAL);
+  }
+  report(nok, NRANDOM / 10, "barrett_mulmod(a, a) against mul and mod");
+
+  bignum_free(a);
+  bignum_free(e);
+  bignum_free(n);
+  bignum_free(c);
+  bignum_free(ref);
+  bignum_free(tmp);
+}
+
+
+static void test_limbs(void)
+{
+  /* Up to eight bignums' worth of limbs, past every cutoff the build has */
+  const int maxlimbs = 8 * BN_ARRAY_SIZE;
+  DTYPE* a = (DTYPE*)malloc(maxlimbs * sizeof(DTYPE));
+  DTYPE* r = (DTYPE*)malloc(2 * maxlimbs * sizeof(DTYPE));
+  DTYPE* ref = (DTYPE*)malloc(2 * maxlimbs * sizeof(DTYPE));
+  bn_ws ws = { NULL, bignum_mul_limbs_ws_size(maxlimbs, maxlimbs) };
+  int nok = 0;
+  int i, k;
+
+  ws.limbs = (DTYPE*)malloc(ws.size + 1);
+  if ((a == NULL) || (r == NULL) || (ref == NULL) || (ws.limbs == NULL))
+  {
+    printf("out of memory\n");
+    exit(1);
+  }
+
+  for (i = 0; i < (NRANDOM / 5); ++i)
+  {
+    const int n = 1 + rand() % maxlimbs;
+    int ok = 1;
+    random_limbs(a, n);
+    if (i == 0)
+    {
+      for (k = 0; k < n; ++k)
+      {
+        a[k] = (DTYPE)MAX_VAL;
+      }
+    }
+    bignum_mul_limbs(r, a, n, a, n, &ws);
+    schoolbook(ref, a, n, a, n);
+    for (k = 0; k < (2 * n); ++k)
+    {
+      ok = ok && (r[k] == ref[k]);
+    }
+    nok += ok;
+  }
+  report(nok, NRANDOM / 5, "bignum_mul_limbs(r, a, n, a, n)");
+
+  free(a);
+  free(r);
+  free(ref);
+  free(ws.limbs);
+}
+
+
+int main()
+{
+  printf("\nTesting squaring, %d-bit bignums:\n\n", BN_ARRAY_SIZE * 8 * WORD_SIZE);
+
+  srand(2718);
+  test_sqr();
+  test_callers();
+  test_limbs();
+
+  printf("\n%d/%d tests successful.\n", npassed, ntests);
+  printf("\n");
+
+  return (ntests - npassed); /* 0 if all tests passed */
+}
@@ -0,0 +1,151 @@
+/*
+
+    Shared by the tests: the pass/fail counters and their report lines,
+    random or all-ones operands, as bignums or as plain limb arrays, and the
+    schoolbook multiplication every product is checked against.
+    Each test includes this once, after bn.h.
+
+*/
+
+#ifndef __TEST_UTIL_H__
+#define __TEST_UTIL_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "bn.h"
+
+
+static int npassed = 0;
+static int ntests = 0;
+
+
+/* One line for a group of ncases checks, nok of which passed */
+static inline void report(int nok, int ncases, const char* what)
+{
+  ntests += 1;
+  npassed += (nok == ncases);
+  printf("  %s %d/%d %s\n", ((nok == ncases) ? "[ OK ]" : "[FAIL]"), nok, ncases, what);
+}
+
+
+/* One line for a single check */
+static inline void report_one(int ok, const char* what)
+{
+  ntests += 1;
+  npassed += ok;
+  printf("  %s %s\n", (ok ? "[ OK ]" : "[FAIL]"), what);
+}
+
+
+/* One limb with every bit random: rand() gives at least 15 bits a call, so shift in as many calls as the limb needs */
+static inline DTYPE random_limb(void)
+{
+  DTYPE x = 0;
+  int nbits;
+  for (nbits = 0; nbits < (8 * WORD_SIZE); nbits += 15)
+  {
+    x = (DTYPE)((x << 15) ^ (DTYPE)rand());
+  }
+  return x;
+}
+
+
+static inline void random_limbs(DTYPE* a, int n)
+{
+  int i;
+  for (i = 0; i < n; ++i)
+  {
+    a[i] = random_limb();
+  }
+}
+
+
+static inline void ones_limbs(DTYPE* a, int n)
+{
+  int i;
+  for (i = 0; i < n; ++i)
+  {
+    a[i] = (DTYPE)MAX_VAL;
+  }
+}
+
+
+/* n = nwords random limbs, the rest zero */
+static inline void random_bignum(_TPtr<_T_bn> n, int nwords)
+{
+  int i;
+  bignum_init(n);
+  for (i = 0; i < nwords; ++i)
+  {
+    n->array[i] = random_limb();
+  }
+  bignum_normalize(n);
+}
+
+
+/* n = B^nwords - 1: nwords limbs with every bit set */
+static inline void ones_bignum(_TPtr<_T_bn> n, int nwords)
+{
+  int i;
+  bignum_init(n);
+  for (i = 0; i < nwords; ++i)
+  {
+    n->array[i] = (DTYPE)MAX_VAL;
+  }
+  bignum_normalize(n);
+}
+
+
+/* r[0..na+nb-1] = a[0..na-1] * b[0..nb-1], one row at a time -- the reference for every product */
+static inline void schoolbook(DTYPE* r, DTYPE* a, int na, DTYPE* b, int nb)
+{
+  int i, j;
+  for (i = 0; i < (na + nb); ++i)
+  {
+    r[i] = 0;
+  }
+  for (i = 0; i < na; ++i)
+  {
+    DTYPE carry = 0;
+    for (j = 0; j < nb; ++j)
+    {
+      DTYPE_TMP t = ((DTYPE_TMP)a[i] * b[j]) + r[i + j] + carry;
+      r[i + j] = (DTYPE)t;
+      carry = (DTYPE)(t >> (8 * WORD_SIZE));
+    }
+    r[i + nb] = carry;
+  }
+}
+
+
+/* r[0..2*BN_ARRAY_SIZE-1] = a * b with nothing dropped, by schoolbook() on copies of the limbs */
+static inline void schoolbook_bignum(DTYPE* r, _TPtr<_T_bn> a, _TPtr<_T_bn> b)
+{
+  DTYPE x[BN_ARRAY_SIZE];
+  DTYPE y[BN_ARRAY_SIZE];
+  int i;
+  for (i = 0; i < BN_ARRAY_SIZE; ++i)
+  {
+    x[i] = a->array[i];
+    y[i] = b->array[i];
+  }
+  schoolbook(r, x, BN_ARRAY_SIZE, y, BN_ARRAY_SIZE);
+}
+
+
+/* c = a * b truncated to the bignum width, what bignum_mul should give */
+static inline void schoolbook_mul(_TPtr<_T_bn> a, _TPtr<_T_bn> b, _TPtr<_T_bn> c)
+{
+  DTYPE r[2 * BN_ARRAY_SIZE];
+  int i;
+  schoolbook_bignum(r, a, b);
+  bignum_init(c);
+  for (i = 0; i < BN_ARRAY_SIZE; ++i)
+  {
+    c->array[i] = r[i];
+  }
+  bignum_normalize(c);
+}
+
+
+#endif /* #ifndef __TEST_UTIL_H__ */
@@ -0,0 +1,169 @@
+/*
+
+    Testing the BN_TRACE ring buffer (build with -DBN_TRACE -DBN_TRACE_SIZE=4096)
+
+    - each call the application makes is one record with its opcode, inputs
+      and shift count; calls made inside the library are not recorded
+    - Montgomery calls record the context's modulus first
+    - when the buffer is full the oldest records are dropped: the dump then
+      holds an unbroken run of the newest calls, in order
+    - reset empties the buffer
+
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bn.h"
+#include "test_util.h"
+
+
+#define NCALLS 10000
+
+
+/* Dump into buf, returns its size */
+static long dump(unsigned char* buf, long size)
+{
+  FILE* f = tmpfile();
+  bignum_trace_dump(f);
+  rewind(f);
+  long len = (long)fread(buf, 1, size, f);
+  fclose(f);
+  return len;
+}
+
+
+static unsigned u16(const unsigned char* p)
+{
+  return p[0] | (p[1] << 8);
+}
+
+
+/* Value of the operand at p, for operands of up to 8 bytes */
+static unsigned long long operand(const unsigned char* p)
+{
+  unsigned long long v = 0;
+  int i;
+  for (i = (int)u16(p) - 1; i >= 0; --i)
+  {
+    v = (v << 8) | p[2 + i];
+  }
+  return v;
+}
+
+
+static void test_records(void)
+{
+  static unsigned char buf[BN_TRACE_SIZE + 64];
+  _TPtr<_T_bn> a = bignum_new();
+  _TPtr<_T_bn> b = bignum_new();
+  _TPtr<_T_bn> n = bignum_new();
+  _TPtr<_T_bn> c = bignum_new();
+  bn_mont_ctx mont;
+
+  bignum_from_int(a, 0x1234);
+  bignum_from_int(b, 0x56789a);
+  bignum_from_int(n, 0x7fffffff);
+  bignum_mont_init(&mont, n);
+
+  bignum_trace_reset();
+  bignum_add(a, b, c);
+  bignum_mul(a, b, c);
+  bignum_lshift(a, c, 13);
+  bignum_powmod(a, b, n, c);
+  bignum_mont_mul(&mont, a, b, c);
+
+  long len = dump(buf, sizeof(buf));
+  int ok = (bignum_trace_count() == 5) && (len > 9) && (memcmp(buf, BN_TRACE_MAGIC, 8) == 0) && (buf[8] == WORD_SIZE);
+
+  static const int fns[5] = { BN_FN_add, BN_FN_mul, BN_FN_lshift, BN_FN_powmod, BN_FN_mont_mul };
+  static const int nops[5] = { 2, 2, 1, 3, 3 };
+  long pos = 9;
+  int i;
+  for (i = 0; ok && (i < 5); ++i)
+  {
+    const unsigned char* rec = &buf[pos];
+    const unsigned char* op = rec + BN_TRACE_RECORD;
+    ok = ok && (rec[2] == fns[i]) && (rec[3] == nops[i]);
+    if (fns[i] == BN_FN_mont_mul)
+    {
+      /* Modulus first */
+      ok = ok && (operand(op) == 0x7fffffff);
+      op += 2 + u16(op);
+    }
+    ok = ok && (operand(op) == 0x1234);
+    if (fns[i] == BN_FN_lshift)
+    {
+      ok = ok && (rec[4] == 13);
+    }
+    else
+    {
+      op += 2 + u16(op);
+      ok = ok && (operand(op) == 0x56789a);
+    }
+    pos += u16(rec);
+  }
+  ok = ok && (pos == len);
+  report_one(ok, "one record per application call, nested calls left out, modulus of the context first");
+
+  bignum_trace_reset();
+  ok = (bignum_trace_count() == 0) && (bignum_trace_dropped() == 0) && (dump(buf, sizeof(buf)) == 9);
+  report_one(ok, "reset empties the buffer");
+
+  bignum_free(a);
+  bignum_free(b);
+  bignum_free(n);
+  bignum_free(c);
+}
+
+
+static void test_wrap(void)
+{
+  static unsigned char buf[BN_TRACE_SIZE + 64];
+  _TPtr<_T_bn> a = bignum_new();
+  _TPtr<_T_bn> c = bignum_new();
+  int i;
+
+  /* Growing operands, so records differ in size */
+  bignum_trace_reset();
+  for (i = 0; i < NCALLS; ++i)
+  {
+    bignum_from_int(a, (DTYPE_TMP)i * i);
+    bignum_rshift(a, c, i % 7);
+  }
+
+  const unsigned long count = bignum_trace_count();
+  int ok = (bignum_trace_dropped() + count == NCALLS) && (count > 0) && (count < NCALLS);
+
+  long len = dump(buf, sizeof(buf));
+  ok = ok && (len <= BN_TRACE_SIZE + 9);
+
+  /* The newest count calls, oldest first */
+  unsigned long long expect = NCALLS - count;
+  long pos;
+  for (pos = 9; ok && (pos < len); pos += u16(&buf[pos]), ++expect)
+  {
+    ok = ok && (buf[pos + 2] == BN_FN_rshift) && (buf[pos + 4] == (expect % 7));
+    ok = ok && (operand(&buf[pos + BN_TRACE_RECORD]) == expect * expect);
+  }
+  ok = ok && (pos == len) && (expect == NCALLS);
+  report_one(ok, "full buffer drops the oldest records, the newest remain in order");
+
+  bignum_free(a);
+  bignum_free(c);
+}
+
+
+int main()
+{
+  printf("\nTesting the trace ring buffer:\n\n");
+
+  test_records();
+  test_wrap();
+
+  printf("\n%d/%d tests successful.\n", npassed, ntests);
+  printf("\n");
+
+  return (ntests - npassed); /* 0 if all tests passed */
+}
@@ -0,0 +1,184 @@
+/*
+
+    Testing the used-limb count kept in every bignum
+
+    Random operands of random length (including 0 and all-ones values) are
+    run through every public operation, aliased and not. After each call the
+    result must have no non-zero limb at or above used, and used must equal
+    what bignum_normalize() recomputes from the limbs.
+
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "bn.h"
+
+
+#define NROUNDS 2000
+
+
+int npassed = 0;
+int ntests = 0;
+
+
+static void random_bignum(_TPtr<_T_bn> n)
+{
+  int nwords = rand() % (BN_ARRAY_SIZE + 1);
+  int all_ones = ((rand() % 8) == 0);
+  int i;
+  bignum_init(n);
+  for (i = 0; i < nwords; ++i)
+  {
+    n->array[i] = all_ones ? (DTYPE)MAX_VAL : (DTYPE)(((DTYPE_TMP)rand() << 16) ^ (DTYPE_TMP)rand());
+  }
+  bignum_normalize(n);
+}
+
+
+/* 1 if used is consistent with the limbs of n */
+static int used_ok(_TPtr<_T_bn> n)
+{
+  const int used = n->used;
+  bignum_normalize(n);
+  return (n->used == used);
+}
+
+
+static void check(const char* name, int* nok, int* nfail, _TPtr<_T_bn> n)
+{
+  if (used_ok(n))
+  {
+    *nok += 1;
+  }
+  else
+  {
+    *nfail += 1;
+    printf("  used out of date after %s\n", name);
+  }
+}
+
+
+int main()
+{
+  _TPtr<_T_bn> a = bignum_new();
+  _TPtr<_T_bn> b = bignum_new();
+  _TPtr<_T_bn> c = bignum_new();
+  _TPtr<_T_bn> d = bignum_new();
+  _TPtr<_T_bn> e = bignum_new();
+  bn_mont_ctx mont;
+  bn_barrett_ctx barrett;
+  char hex[(2 * BN_ARRAY_SIZE * WORD_SIZE) + 1];
+  int nok = 0;
+  int nfail = 0;
+  int i, j;
+
+  printf("\nTesting the used-limb count:\n\n");
+
+  srand(time(NULL));
+
+  for (i = 0; i < NROUNDS; ++i)
+  {
+    random_bignum(a);
+    random_bignum(b);
+    random_bignum(c);
+
+    bignum_add(a, b, c);           check("add", &nok, &nfail, c);
+    bignum_sub(a, b, c);           check("sub", &nok, &nfail, c);
+    bignum_sub(b, a, c);           check("sub", &nok, &nfail, c);
+    bignum_mul(a, b, c);           check("mul", &nok, &nfail, c);
+    bignum_and(a, b, c);           check("and", &nok, &nfail, c);
+    bignum_or(a, b, c);            check("or", &nok, &nfail, c);
+    bignum_xor(a, b, c);           check("xor", &nok, &nfail, c);
+    bignum_xor(a, a, c);           check("xor", &nok, &nfail, c);
+    bignum_lshift(a, c, rand() % (BN_ARRAY_SIZE * 8 * WORD_SIZE + 8));
+    check("lshift", &nok, &nfail, c);
+    bignum_rshift(a, c, rand() % (BN_ARRAY_SIZE * 8 * WORD_SIZE + 8));
+    check("rshift", &nok, &nfail, c);
+    bignum_assign(c, a);           check("assign", &nok, &nfail, c);
+    bignum_inc(c);                 check("inc", &nok, &nfail, c);
+    bignum_dec(c);                 check("dec", &nok, &nfail, c);
+    bignum_dec(c);                 check("dec", &nok, &nfail, c);
+    bignum_isqrt(a, c);            check("isqrt", &nok, &nfail, c);
+
+    /* Results written over one of the operands */
+    bignum_assign(d, a);
+    bignum_add(d, b, d);           check("add (aliased)", &nok, &nfail, d);
+    bignum_sub(d, b, d);           check("sub (aliased)", &nok, &nfail, d);
+    bignum_and(d, b, d);           check("and (aliased)", &nok, &nfail, d);
+    bignum_or(d, a, d);            check("or (aliased)", &nok, &nfail, d);
+    bignum_lshift(d, d, rand() % 100);
+    check("lshift (aliased)", &nok, &nfail, d);
+    bignum_rshift(d, d, rand() % 100);
+    check("rshift (aliased)", &nok, &nfail, d);
+
+    if (!bignum_is_zero(b))
+    {
+      bignum_div(a, b, c);         check("div", &nok, &nfail, c);
+      bignum_mod(a, b, c);         check("mod", &nok, &nfail, c);
+      bignum_divmod(a, b, c, d);   check("divmod", &nok, &nfail, c); check("divmod", &nok, &nfail, d);
+      bignum_powmod(a, c, b, d);   check("powmod", &nok, &nfail, d);
+
+      bignum_barrett_init(&barrett, b);
+      bignum_barrett_mulmod(&barrett, a, c, d);
+      check("barrett_mulmod", &nok, &nfail, d);
+      bignum_barrett_reduce(&barrett, a, c, d);
+      check("barrett_reduce", &nok, &nfail, d);
+
+      if (b->array[0] & 1)
+      {
+        bignum_mont_init(&mont, b);
+        bignum_to_mont(&mont, a, d);   check("to_mont", &nok, &nfail, d);
+        bignum_mont_mul(&mont, d, d, e); check("mont_mul", &nok, &nfail, e);
+        bignum_from_mont(&mont, e, e); check("from_mont", &nok, &nfail, e);
+      }
+    }
+
+    bignum_from_int(d, rand() % 4);
+    bignum_pow(a, d, c);           check("pow", &nok, &nfail, c);
+    bignum_from_int(c, (DTYPE_TMP)rand() * rand());
+    check("from_int", &nok, &nfail, c);
+
+    /* hex string of a random number of limbs, possibly with leading zero limbs */
+    int nwords = 1 + (rand() % BN_ARRAY_SIZE);
+    for (j = 0; j < 2 * WORD_SIZE * nwords; ++j)
+    {
+      hex[j] = ((rand() % 4) == 0) ? '0' : "0123456789abcdef"[rand() % 16];
+    }
+    hex[j] = 0;
+    bignum_from_string(c, hex, j);
+    check("from_string", &nok, &nfail, c);
+  }
+
+  ntests += 1;
+  npassed += (nfail == 0);
+  printf("  %s %d/%d results have an up-to-date used count\n", ((nfail == 0) ? "[ OK ]" : "[FAIL]"), nok, nok + nfail);
+
+  /* Wrap-around at the edges of the range */
+  bignum_init(a);
+  bignum_dec(a);
+  bignum_init(b);
+  bignum_normalize(a);
+  int ok = (a->used == BN_ARRAY_SIZE);
+  bignum_inc(a);
+  ok = ok && (a->used == 0) && bignum_is_zero(a);
+  bignum_from_int(b, 1);
+  bignum_sub(a, b, c);
+  ok = ok && (c->used == BN_ARRAY_SIZE);
+  bignum_add(c, b, c);
+  ok = ok && (c->used == 0) && bignum_is_zero(c);
+
+  ntests += 1;
+  npassed += ok;
+  printf("  %s 0 - 1 wraps to all ones and back\n", (ok ? "[ OK ]" : "[FAIL]"));
+
+  printf("\n%d/%d tests successful.\n", npassed, ntests);
+  printf("\n");
+
+  bignum_free(a); bignum_free(b); bignum_free(c);
+  bignum_free(d); bignum_free(e);
+
+  return (ntests - npassed); /* 0 if all tests passed */
+}
+
@@ -0,0 +1,154 @@
+/*
+
+    Testing the workspace (_ws) variants
+
+    - one workspace of bignum_ws_size() bytes is reused for every call:
+      mul/div/mod/divmod/pow/powmod/isqrt _ws results must equal the plain
+      versions, including mul with the result aliasing an operand
+    - bignum_isqrt_ws on full-width operands (where squaring the candidate
+      root in a single bignum would overflow): r^2 <= a < (r + 1)^2
+
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "bn.h"
+#include "test_util.h"
+
+
+#define NRANDOM 500
+
+
+static void test_against_plain(bn_ws* ws)
+{
+  _TPtr<_T_bn> a = bignum_new();
+  _TPtr<_T_bn> b = bignum_new();
+  _TPtr<_T_bn> n = bignum_new();
+  _TPtr<_T_bn> c = bignum_new();
+  _TPtr<_T_bn> d = bignum_new();
+  _TPtr<_T_bn> c_ref = bignum_new();
+  _TPtr<_T_bn> d_ref = bignum_new();
+  int nok = 0;
+  int i;
+
+  for (i = 0; i < NRANDOM; ++i)
+  {
+    int ok = 1;
+
+    random_bignum(a, rand() % (BN_ARRAY_SIZE + 1));
+    random_bignum(b, 1 + rand() % BN_ARRAY_SIZE);
+    do
+    {
+      random_bignum(n, 1 + rand() % BN_ARRAY_SIZE);
+    }
+    while (bignum_is_zero(n));
+
+    bignum_mul(a, b, c_ref);
+    bignum_mul_ws(a, b, c, ws);
+    ok = ok && (bignum_cmp(c, c_ref) == EQUAL);
+
+    /* c = c * b, in place */
+    bignum_mul(c_ref, b, d_ref);
+    bignum_mul_ws(c, b, c, ws);
+    ok = ok && (bignum_cmp(c, d_ref) == EQUAL);
+
+    bignum_div(a, n, c_ref);
+    bignum_div_ws(a, n, c, ws);
+    ok = ok && (bignum_cmp(c, c_ref) == EQUAL);
+
+    bignum_mod(a, n, c_ref);
+    bignum_mod_ws(a, n, c, ws);
+    ok = ok && (bignum_cmp(c, c_ref) == EQUAL);
+
+    bignum_divmod(a, n, c_ref, d_ref);
+    bignum_divmod_ws(a, n, c, d, ws);
+    ok = ok && (bignum_cmp(c, c_ref) == EQUAL) && (bignum_cmp(d, d_ref) == EQUAL);
+
+    bignum_powmod(a, b, n, c_ref);
+    bignum_powmod_ws(a, b, n, c, ws);
+    ok = ok && (bignum_cmp(c, c_ref) == EQUAL);
+
+    bignum_isqrt(a, c_ref);
+    bignum_isqrt_ws(a, c, ws);
+    ok = ok && (bignum_cmp(c, c_ref) == EQUAL);
+
+    /* Small exponent, so pow does more than truncate to zero */
+    random_bignum(b, 1);
+    b->array[0] &= 0x1f;
+    bignum_normalize(b);
+    bignum_pow(a, b, c_ref);
+    bignum_pow_ws(a, b, c, ws);
+    ok = ok && (bignum_cmp(c, c_ref) == EQUAL);
+
+    nok += ok;
+  }
+
+  ntests += 1;
+  npassed += (nok == NRANDOM);
+  printf("  %s %d/%d rounds of _ws results agree with the plain functions\n", ((nok == NRANDOM) ? "[ OK ]" : "[FAIL]"), nok, NRANDOM);
+
+  bignum_free(a); bignum_free(b); bignum_free(n);
+  bignum_free(c); bignum_free(d);
+  bignum_free(c_ref); bignum_free(d_ref);
+}
+
+
+static void test_isqrt_full_width(bn_ws* ws)
+{
+  _TPtr<_T_bn> a = bignum_new();
+  _TPtr<_T_bn> r = bignum_new();
+  _TPtr<_T_bn> sq = bignum_new();
+  int nok = 0;
+  int ncases = 100;
+  int i;
+
+  for (i = 0; i < ncases; ++i)
+  {
+    random_bignum(a, BN_ARRAY_SIZE);
+    a->array[BN_ARRAY_SIZE - 1] |= (DTYPE)DTYPE_MSB;
+    bignum_normalize(a);
+
+    bignum_isqrt_ws(a, r, ws);
+
+    /* r has at most half the bits of a, so r^2 and (r + 1)^2 fit unless r + 1 == 2^(bits/2) */
+    bignum_mul_ws(r, r, sq, ws);
+    int ok = (bignum_cmp(sq, a) != LARGER);
+
+    bignum_inc(r);
+    bignum_mul_ws(r, r, sq, ws);
+    ok = ok && (bignum_is_zero(sq) || (bignum_cmp(sq, a) == LARGER));
+
+    nok += ok;
+  }
+
+  ntests += 1;
+  npassed += (nok == ncases);
+  printf("  %s %d/%d full-width square roots satisfy r^2 <= a < (r + 1)^2\n", ((nok == ncases) ? "[ OK ]" : "[FAIL]"), nok, ncases);
+
+  bignum_free(a); bignum_free(r); bignum_free(sq);
+}
+
+
+int main()
+{
+  printf("\nTesting workspace variants:\n\n");
+
+  srand(time(NULL));
+
+  bn_ws ws;
+  ws.size = bignum_ws_size();
+  ws.limbs = (DTYPE*)malloc(ws.size);
+
+  test_against_plain(&ws);
+  test_isqrt_full_width(&ws);
+
+  free(ws.limbs);
+
+  printf("\n%d/%d tests successful.\n", npassed, ntests);
+  printf("\n");
+
+  return (ntests - npassed); /* 0 if all tests passed */
+}
+